@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_HASH_H_
+#define NS_HASH_H_
+
+#include "ns_types.h"
+#include "ns_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file
+ * \ingroup ns_list
+ * \brief Hash table support library.
+ *
+ * The ns_hash.h file provides an intrusive chained hash table. Entries are
+ * linked to the table through a caller-provided link member, as with ns_list,
+ * so insertion does not allocate memory. Only the bucket array is allocated,
+ * using allocator callbacks given when the table is initialised, typically
+ * backed by a nsdynmemLIB memory book (see NS_HASH_MEM_BOOK_ALLOCATOR()).
+ *
+ * The caller computes the hash value of an entry, for example with
+ * ns_hash_bytes(), and provides a match function for lookups. Entries with
+ * equal keys are allowed; ns_hash_find() then returns one of them.
+ *
+ * When the table grows, the bucket array is doubled and the entries are moved
+ * to the new array incrementally, a few buckets on each insertion, so no
+ * single insertion moves all entries. If the bucket array cannot be grown,
+ * the table keeps working with longer chains.
+ *
+ * Memory footprint is one pointer and a 32-bit hash value in each entry,
+ * and one pointer per bucket. The table grows when there are on average
+ * more than two entries per bucket.
+ *
+ * Example of an entry type that can be stored to this table.
+ * ~~~
+ *     typedef struct example_neighbour
+ *     {
+ *         uint8_t        address[16];
+ *         ns_hash_link_t link;
+ *     }
+ *     example_neighbour_t;
+ *
+ *     static bool example_neighbour_match(const void *key, const void *entry)
+ *     {
+ *         return memcmp(key, ((const example_neighbour_t *) entry)->address, 16) == 0;
+ *     }
+ *
+ *     static const ns_hash_allocator_t my_allocator = NS_HASH_MEM_BOOK_ALLOCATOR(NULL);
+ *     static NS_HASH_DEFINE(my_table, example_neighbour_t, link, &my_allocator);
+ *
+ *     if (ns_hash_insert(&my_table, neighbour, ns_hash_bytes(neighbour->address, 16)) != 0) {
+ *         // no memory for buckets
+ *     }
+ *     example_neighbour_t *found = ns_hash_find(&my_table, ns_hash_bytes(address, 16), address, example_neighbour_match);
+ * ~~~
+ * NOTE: the link field SHALL NOT be accessed by the user.
+ *
+ * As with ns_list, the operations are implemented as type-checked macros. The
+ * macros do not evaluate any arguments more than once, unless documented.
+ *
+ * In macro documentation, `table_t` refers to a table type defined using
+ * NS_HASH_HEAD(), and `entry_t` to the entry type that was passed to it.
+ */
+
+/** \brief The type for the link member in the user's entry structure.
+ *
+ * Users should not access this member directly - just pass its name to the
+ * table head macros.
+ */
+typedef struct ns_hash_link {
+    struct ns_hash_link *next;  ///< Next link in the bucket, or NULL
+    uint32_t hash;              ///< Hash value of the entry
+} ns_hash_link_t;
+
+/** \brief Allocator for bucket arrays. */
+typedef struct ns_hash_allocator {
+    void *(*alloc)(void *context, size_t size); ///< Allocate memory, return NULL on failure
+    void (*free)(void *context, void *ptr);     ///< Free memory returned by alloc
+    void *context;                              ///< Passed to alloc and free
+} ns_hash_allocator_t;
+
+/** \brief Underlying generic hash table head.
+ *
+ * Users should not use this type directly, but use the NS_HASH_HEAD() macro.
+ */
+typedef struct ns_hash {
+    const ns_hash_allocator_t *allocator;   ///< Bucket array allocator
+    ns_hash_link_t **buckets;               ///< Bucket array, NULL until first insertion
+    ns_hash_link_t **old_buckets;           ///< Bucket array being moved from, NULL if not growing
+    uint16_t bucket_count;                  ///< Number of buckets, power of two
+    uint16_t old_bucket_count;              ///< Number of buckets in old array
+    uint16_t moved_count;                   ///< Number of old buckets moved to the bucket array
+    uint_fast16_t count;                    ///< Number of entries
+} ns_hash_t;
+
+/** \brief Match function type.
+ *
+ * \param key   Key that was passed to ns_hash_find().
+ * \param entry Entry on the table with the same hash value.
+ *
+ * \return true if the entry matches the key.
+ */
+typedef bool ns_hash_match_t(const void *key, const void *entry);
+
+/** \brief Declare a hash table head type
+ *
+ * As NS_LIST_HEAD() - see its documentation.
+ * ~~~
+ *     typedef NS_HASH_HEAD(example_neighbour_t, link) example_neighbour_table_t;
+ * ~~~
+ */
+#define NS_HASH_HEAD(entry_type, field) \
+    NS_HASH_HEAD_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
+/// \privatesection
+/** \brief Internal macro defining a table head, given the offset to the link
+ * The offset and type members are used by the ns_list.h internal macros.
+ */
+#define NS_HASH_HEAD_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_hash_t shash; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    entry_type *type; \
+}
+
+/// \publicsection
+/** \brief Allocator using a nsdynmemLIB memory book.
+ *
+ * \param book `(ns_mem_book_t *)` Memory book, or NULL for the default heap (ns_dyn_mem_alloc()).
+ */
+#define NS_HASH_MEM_BOOK_ALLOCATOR(book) { ns_hash_mem_book_alloc, ns_hash_mem_book_free, book }
+
+/** \hideinitializer \brief Initialise a table
+ *
+ * A table head must be initialised using this function, NS_HASH_INIT() or
+ * NS_HASH_DEFINE() before use. Does not allocate memory.
+ *
+ * \param table     `(table_t *)`                   Pointer to table.
+ * \param allocator `(const ns_hash_allocator_t *)` Bucket array allocator, must remain valid while the table is used.
+ */
+#define ns_hash_init(table, allocator) ns_hash_init_(&(table)->shash, allocator)
+
+/** \brief Initialiser for an empty table
+ *
+ * \param allocator `(const ns_hash_allocator_t *)` Bucket array allocator.
+ */
+#define NS_HASH_INIT(allocator) { { allocator, NULL, NULL, 0, 0, 0, 0 } }
+
+/** \brief Define a table, and initialise to empty.
+ *
+ * Usage:
+ * ~~~
+ *     static NS_HASH_DEFINE(my_table, entry_t, link, &my_allocator);
+ * ~~~
+ */
+#define NS_HASH_DEFINE(name, type, field, allocator) \
+    NS_HASH_HEAD(type, field) name = NS_HASH_INIT(allocator)
+
+/** \hideinitializer \brief Release the memory of a table.
+ *
+ * Frees the bucket arrays; entries on the table become detached, and the
+ * table is empty. The table can be used again without initialisation.
+ *
+ * \param table `(table_t *)` Pointer to table.
+ */
+#define ns_hash_deinit(table) ns_hash_deinit_(&(table)->shash)
+
+/** \hideinitializer \brief Insert an entry to the table.
+ *
+ * O(1). May allocate a bucket array.
+ *
+ * \param table `(table_t *)`           Pointer to table.
+ * \param entry `(entry_t * restrict)`  Pointer to new entry to insert.
+ * \param hash  `(uint32_t)`            Hash value of the entry.
+ *
+ * \return      `(int)`                 0 if inserted.
+ * \return                              -1 if there is no memory for the first bucket array.
+ */
+#define ns_hash_insert(table, entry, hash) \
+    ns_hash_insert_(&(table)->shash, NS_LIST_OFFSET_(table), NS_LIST_TYPECHECK_(table, entry), hash)
+
+/** \hideinitializer \brief Remove an entry.
+ *
+ * O(1) on average; the bucket is searched for the previous entry.
+ *
+ * \param table `(table_t *)` Pointer to table.
+ * \param entry `(entry_t *)` Entry on table to be removed.
+ */
+#define ns_hash_remove(table, entry) \
+    ns_hash_remove_(&(table)->shash, NS_LIST_OFFSET_(table), NS_LIST_TYPECHECK_(table, entry))
+
+/** \hideinitializer \brief Find an entry.
+ *
+ * O(1) on average.
+ *
+ * \param table `(const table_t *)`   Pointer to table.
+ * \param hash  `(uint32_t)`          Hash value of the key.
+ * \param key   `(const void *)`      Key passed to match function.
+ * \param match `(ns_hash_match_t *)` Match function, called for entries with the same hash value.
+ *
+ * \return      `(entry_t *)`         Pointer to matching entry.
+ * \return                            NULL if not found.
+ */
+#define ns_hash_find(table, hash, key, match) \
+    NS_LIST_TYPECAST_(table, ns_hash_find_(&(table)->shash, NS_LIST_OFFSET_(table), hash, key, match))
+
+/** \brief Get the number of entries on a table.
+ *
+ * \param table `(const table_t *)` Pointer to table.
+ *
+ * \return      `(uint_fast16_t)`   Number of entries.
+ */
+#define ns_hash_count(table) ((table)->shash.count)
+
+/** \brief Check if a table is empty.
+ *
+ * \param table `(const table_t *)` Pointer to table.
+ *
+ * \return      `(bool)`            true if the table is empty.
+ */
+#define ns_hash_is_empty(table) ((bool) ((table)->shash.count == 0))
+
+/** \hideinitializer \brief Get the first entry in iteration order.
+ *
+ * Iteration order is not specified, and changes when entries are inserted.
+ *
+ * \param table `(const table_t *)` Pointer to table.
+ *
+ * \return      `(entry_t *)`       Pointer to first entry.
+ * \return                          NULL if table is empty.
+ */
+#define ns_hash_get_first(table) \
+    NS_LIST_TYPECAST_(table, ns_hash_get_first_(&(table)->shash, NS_LIST_OFFSET_(table)))
+
+/** \hideinitializer \brief Get the next entry in iteration order.
+ *
+ * \param table   `(const table_t *)`  Pointer to table.
+ * \param current `(const entry_t *)`  Pointer to current entry.
+ *
+ * \return        `(entry_t *)`        Pointer to next entry.
+ * \return                             NULL if current entry is last.
+ */
+#define ns_hash_get_next(table, current) \
+    NS_LIST_TYPECAST_(table, ns_hash_get_next_(&(table)->shash, NS_LIST_OFFSET_(table), NS_LIST_TYPECHECK_(table, current)))
+
+/** \brief Iterate over all entries of a table.
+ *
+ * As ns_list_foreach() - see its documentation. Entries must not be inserted
+ * or removed during the iteration.
+ *
+ * \param type                      Entry type `([const] entry_t)`.
+ * \param e                         Name for iteration pointer to be defined
+ *                                  inside the loop.
+ * \param table `(const table_t *)` Pointer to table - evaluated multiple times.
+ */
+#define ns_hash_foreach(type, e, table) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_hash_get_first(table)); \
+        e; e = NS_LIST_TYPECOERCE(type *, ns_hash_get_next(table, e)))
+
+/** \brief Iterate over all entries of a table, where user may remove.
+ *
+ * As ns_hash_foreach(), but removal of current entry is permitted. Entries
+ * must not be inserted during the iteration.
+ *
+ * \param type                Entry type `(entry_t)`.
+ * \param e                   Name for iteration pointer to be defined
+ *                            inside the loop.
+ * \param table `(table_t *)` Pointer to table - evaluated multiple times.
+ */
+#define ns_hash_foreach_safe(type, e, table) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_hash_get_first(table)), *_next##e; \
+        e && (_next##e = NS_LIST_TYPECOERCE(type *, ns_hash_get_next(table, e)), true); e = _next##e)
+
+/** \brief Calculate a hash value of data.
+ *
+ * 32-bit FNV-1a hash.
+ *
+ * \param data Pointer to data.
+ * \param len  Length of data.
+ *
+ * \return Hash value.
+ */
+uint32_t ns_hash_bytes(const void *data, uint_fast16_t len);
+
+/** \brief Allocator callbacks for NS_HASH_MEM_BOOK_ALLOCATOR(). */
+void *ns_hash_mem_book_alloc(void *context, size_t size);
+void ns_hash_mem_book_free(void *context, void *ptr);
+
+/** \privatesection
+ *  Internal functions - designed to be accessed using corresponding macros above
+ */
+void ns_hash_init_(ns_hash_t *table, const ns_hash_allocator_t *allocator);
+void ns_hash_deinit_(ns_hash_t *table);
+int ns_hash_insert_(ns_hash_t *table, ns_list_offset_t link_offset, void *restrict entry, uint32_t hash);
+void ns_hash_remove_(ns_hash_t *table, ns_list_offset_t link_offset, void *entry);
+void *ns_hash_find_(const ns_hash_t *table, ns_list_offset_t link_offset, uint32_t hash, const void *key, ns_hash_match_t *match);
+void *ns_hash_get_first_(const ns_hash_t *table, ns_list_offset_t link_offset);
+void *ns_hash_get_next_(const ns_hash_t *table, ns_list_offset_t link_offset, const void *current);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NS_HASH_H_ */
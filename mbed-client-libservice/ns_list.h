@@ -1,5 +1,5 @@
 /*
- * Copyright (c) 2014-2016, 2018-2020, Pelion and affiliates.
+ * Copyright (c) 2014-2016, 2018-2021, Pelion and affiliates.
  * SPDX-License-Identifier: Apache-2.0
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
@@ -83,7 +83,12 @@ extern "C" {
  * than once, unless documented.
  *
  * In macro documentation, `list_t` refers to a list type defined using
- * NS_LIST_HEAD(), and `entry_t` to the entry type that was passed to it.
+ * NS_LIST_HEAD() or NS_LIST_HEAD_COUNTED(), and `entry_t` to the entry type
+ * that was passed to it.
+ *
+ * If the length of a list is checked frequently, declare it with
+ * NS_LIST_HEAD_COUNTED(). Counted lists are used with the same macros, but
+ * the list head also stores the number of entries, so ns_list_count() is O(1).
  */
 
 /** \brief Underlying generic linked list head.
@@ -96,6 +101,15 @@ typedef struct ns_list {
     ///< to head's `first_entry` pointer if list is empty
 } ns_list_t;
 
+/** \brief Underlying generic counted linked list head.
+ *
+ * Users should not use this type directly, but use the NS_LIST_HEAD_COUNTED() macro.
+ */
+typedef struct ns_list_counted {
+    ns_list_t list;         ///< List head, must be first
+    uint_fast16_t count;    ///< Number of entries on the list
+} ns_list_counted_t;
+
 /** \brief Declare a list head type
  *
  * This union stores the real list head, and also encodes as compile-time type
@@ -150,6 +164,29 @@ typedef struct ns_list {
 #define NS_LIST_HEAD_INCOMPLETE(entry_type) \
     NS_LIST_HEAD_BY_OFFSET_(entry_type, 0)
 
+/** \brief Declare a counted list head type
+ *
+ * As NS_LIST_HEAD(), but the list head also maintains the number of
+ * entries on the list, so ns_list_count() is O(1). This costs one
+ * `uint_fast16_t` in the list head, and the count update on each add and
+ * remove. The link member of the entries is the same as for other lists.
+ *
+ * Counted lists are used with the same macros as other lists, but they
+ * must be initialised with ns_list_init(), NS_LIST_COUNTED_INIT() or
+ * NS_LIST_COUNTED_DEFINE(). A counted list must not contain over 65535 entries.
+ * ~~~
+ *     static NS_LIST_HEAD_COUNTED(example_entry_t, link) my_queue;
+ *     ns_list_init(&my_queue);
+ *     ...
+ *     if (ns_list_count(&my_queue) >= QUEUE_LIMIT) {
+ *         return -1;
+ *     }
+ *     ns_list_add_to_end(&my_queue, entry);
+ * ~~~
+ */
+#define NS_LIST_HEAD_COUNTED(entry_type, field) \
+    NS_LIST_HEAD_COUNTED_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
 /// \privatesection
 /** \brief Internal macro defining a list head, given the offset to the link pointer
  * The +1 allows for link_offset being 0 - we can't declare a 0-size array
@@ -162,6 +199,23 @@ union \
     NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
     NS_FUNNY_COMPARE_RESTORE \
     char (*offset)[link_offset + 1]; \
+    char (*counted)[1]; \
+    entry_type *type; \
+}
+
+/** \brief Internal macro defining a counted list head, given the offset to the link pointer
+ * The size of the counted array tells the macros that the count is maintained.
+ */
+#define NS_LIST_HEAD_COUNTED_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_list_counted_t clist; \
+    ns_list_t slist; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    char (*counted)[2]; \
     entry_type *type; \
 }
 
@@ -170,6 +224,11 @@ union \
  */
 #define NS_LIST_OFFSET_(list) ((ns_list_offset_t) (sizeof *(list)->offset - 1))
 
+/** \brief Check if the list maintains an entry count.
+ * \return `(bool)` Compile-time constant, true for lists declared with NS_LIST_HEAD_COUNTED()
+ */
+#define NS_LIST_COUNTED_(list) ((bool) (sizeof *(list)->counted - 1))
+
 /** \brief Get the entry pointer type.
  * \def NS_LIST_PTR_TYPE_
  *
@@ -300,7 +359,10 @@ typedef struct ns_list_link {
  *
  * \param list Pointer to a NS_LIST_HEAD() structure.
  */
-#define ns_list_init(list) ns_list_init_(&(list)->slist)
+#define ns_list_init(list) \
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_init_(&(list)->slist) : \
+    ns_list_init_(&(list)->slist))
 
 /** \brief Initialiser for an empty list
  *
@@ -352,6 +414,22 @@ typedef struct ns_list_link {
 #define NS_LIST_DEFINE(name, type, field) \
     NS_LIST_HEAD(type, field) NS_LIST_NAME_INIT(name)
 
+/** \brief Initialiser for an empty counted list
+ *
+ * As NS_LIST_INIT(), for lists declared with NS_LIST_HEAD_COUNTED().
+ */
+#define NS_LIST_COUNTED_INIT(name) { { { NULL, &(name).slist.first_entry }, 0 } }
+
+/** \brief Define a counted list, and initialise to empty.
+ *
+ * As NS_LIST_DEFINE(), for a list declared with NS_LIST_HEAD_COUNTED().
+ * ~~~
+ *     static NS_LIST_COUNTED_DEFINE(my_list, entry_t, link);
+ * ~~~
+ */
+#define NS_LIST_COUNTED_DEFINE(name, type, field) \
+    NS_LIST_HEAD_COUNTED(type, field) name = NS_LIST_COUNTED_INIT(name)
+
 /** \hideinitializer \brief Add an entry to the start of the linked list.
  *
  * ns_list_add_to_end() is *slightly* more efficient than ns_list_add_to_start().
@@ -360,7 +438,9 @@ typedef struct ns_list_link {
  * \param entry `(entry_t * restrict)` Pointer to new entry to add.
  */
 #define ns_list_add_to_start(list, entry) \
-    ns_list_add_to_start_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_add_to_start_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)) : \
+    ns_list_add_to_start_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)))
 
 /** \hideinitializer \brief Add an entry to the end of the linked list.
  *
@@ -368,7 +448,9 @@ typedef struct ns_list_link {
  * \param entry `(entry_t * restrict)` Pointer to new entry to add.
  */
 #define ns_list_add_to_end(list, entry) \
-    ns_list_add_to_end_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_add_to_end_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)) : \
+    ns_list_add_to_end_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)))
 
 /** \hideinitializer \brief Add an entry before a specified entry.
  *
@@ -377,7 +459,9 @@ typedef struct ns_list_link {
  * \param entry  `(entry_t * restrict)` Pointer to new entry to add.
  */
 #define ns_list_add_before(list, before, entry) \
-    ns_list_add_before_(NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, before), NS_LIST_TYPECHECK_(list, entry))
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_add_before_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, before), NS_LIST_TYPECHECK_(list, entry)) : \
+    ns_list_add_before_(NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, before), NS_LIST_TYPECHECK_(list, entry)))
 
 /** \hideinitializer \brief Add an entry after a specified entry.
  *
@@ -388,7 +472,9 @@ typedef struct ns_list_link {
  * \param entry `(entry_t * restrict)` Pointer to new entry to add.
  */
 #define ns_list_add_after(list, after, entry) \
-    ns_list_add_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, after), NS_LIST_TYPECHECK_(list, entry))
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_add_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, after), NS_LIST_TYPECHECK_(list, entry)) : \
+    ns_list_add_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, after), NS_LIST_TYPECHECK_(list, entry)))
 
 /** \brief Check if a list is empty.
  *
@@ -445,7 +531,9 @@ typedef struct ns_list_link {
  * \param entry `(entry_t *)` Entry on list to be removed.
  */
 #define ns_list_remove(list, entry) \
-    ns_list_remove_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_remove_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)) : \
+    ns_list_remove_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry)))
 
 /** \hideinitializer \brief Replace an entry.
  *
@@ -467,8 +555,90 @@ typedef struct ns_list_link {
  */
 #define ns_list_concatenate(dst, src) \
         (NS_PTR_MATCH_(dst, src, "concatenating different list types"), \
+        NS_LIST_COUNTED_(src) ? \
+        ns_list_counted_concatenate_(&(dst)->slist, &(src)->slist, NS_LIST_OFFSET_(src)) : \
         ns_list_concatenate_(&(dst)->slist, &(src)->slist, NS_LIST_OFFSET_(src)))
 
+/** \brief Comparison function type for sorting.
+ *
+ * \param a First entry.
+ * \param b Second entry.
+ *
+ * \return <0, 0 or >0 if entry a is less than, equal to or greater than entry b.
+ */
+typedef int ns_list_compare_t(const void *a, const void *b);
+
+/** \hideinitializer \brief Sort a list.
+ *
+ * Bottom-up merge sort on the links, O(n log n), needing no memory
+ * allocation. The sort is stable - entries comparing equal keep their order.
+ *
+ * \param list    `(list_t *)`            Pointer to list.
+ * \param compare `(ns_list_compare_t *)` Comparison function.
+ */
+#define ns_list_sort(list, compare) \
+    ns_list_sort_(&(list)->slist, NS_LIST_OFFSET_(list), compare)
+
+/** \hideinitializer \brief Merge two sorted lists.
+ *
+ * Move the entries on the source list into the destination list, keeping
+ * it sorted, and leaving the source list empty. Both lists must be sorted
+ * by the same comparison function. O(n). Entries from the destination list
+ * are placed before equal entries from the source list.
+ *
+ * \param dst     `(list_t *)`            Pointer to sorted destination list.
+ * \param src     `(list_t *)`            Pointer to sorted source list.
+ * \param compare `(ns_list_compare_t *)` Comparison function.
+ */
+#define ns_list_merge(dst, src, compare) \
+        (NS_PTR_MATCH_(dst, src, "merging different list types"), \
+        NS_LIST_COUNTED_(src) ? \
+        ns_list_counted_merge_(&(dst)->slist, &(src)->slist, NS_LIST_OFFSET_(src), compare) : \
+        ns_list_merge_(&(dst)->slist, &(src)->slist, NS_LIST_OFFSET_(src), compare))
+
+/** \hideinitializer \brief Move a range of entries to another list.
+ *
+ * Detach the entries from first to last inclusive from the source list, and
+ * insert them, keeping their order, before an entry on the destination
+ * list. The lists can be the same, as long as before is not in the range.
+ *
+ * O(1) for plain lists. For counted lists, the entries in the range are
+ * counted, so O(number of entries moved).
+ *
+ * \param dst    `(list_t *)`  Pointer to destination list.
+ * \param before `(entry_t *)` Entry on destination list before which to place
+ *                             the range, or NULL to place at the end.
+ * \param src    `(list_t *)`  Pointer to source list.
+ * \param first  `(entry_t *)` First entry of the range on source list.
+ * \param last   `(entry_t *)` Last entry of the range on source list, which is
+ *                             either first or follows it.
+ */
+#define ns_list_splice_range(dst, before, src, first, last) \
+        (NS_PTR_MATCH_(dst, src, "splicing different list types"), \
+        NS_PTR_MATCH_((dst)->type, before, "incorrect entry type for list"), \
+        NS_LIST_COUNTED_(src) ? \
+        ns_list_counted_splice_range_(&(dst)->slist, before, &(src)->slist, NS_LIST_OFFSET_(src), NS_LIST_TYPECHECK_(src, first), NS_LIST_TYPECHECK_(src, last)) : \
+        ns_list_splice_range_(&(dst)->slist, before, &(src)->slist, NS_LIST_OFFSET_(src), NS_LIST_TYPECHECK_(src, first), NS_LIST_TYPECHECK_(src, last)))
+
+/** \hideinitializer \brief Split a list after an entry.
+ *
+ * Move the entries following the specified entry to the end of the
+ * destination list. The destination list is typically empty, in which case
+ * the source list is split in two.
+ *
+ * O(1) for plain lists. For counted lists, the moved entries are counted,
+ * so O(number of entries moved).
+ *
+ * \param list  `(list_t *)`  Pointer to list to split.
+ * \param entry `(entry_t *)` Entry on list, which remains as its last entry.
+ * \param dst   `(list_t *)`  Pointer to destination list.
+ */
+#define ns_list_split_after(list, entry, dst) \
+        (NS_PTR_MATCH_(list, dst, "splitting to different list type"), \
+        NS_LIST_COUNTED_(list) ? \
+        ns_list_counted_split_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry), &(dst)->slist) : \
+        ns_list_split_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry), &(dst)->slist))
+
 /** \brief Iterate forwards over a list.
  *
  * Example:
@@ -559,14 +729,18 @@ typedef struct ns_list_link {
 
 /** \hideinitializer \brief Count entries on a list
  *
- * Unlike other operations, this is O(n). Note: if list might contain over
- * 65535 entries, this function **must not** be used to get the entry count.
+ * Unlike other operations, this is O(n), unless the list was declared with
+ * NS_LIST_HEAD_COUNTED(), in which case it is O(1). Note: if list might contain
+ * over 65535 entries, this function **must not** be used to get the entry count.
  *
  * \param list `(const list_t *)` Pointer to list.
 
  * \return     `(uint_fast16_t)`  Number of entries that are stored in list.
  */
-#define ns_list_count(list) ns_list_count_(&(list)->slist, NS_LIST_OFFSET_(list))
+#define ns_list_count(list) \
+    (NS_LIST_COUNTED_(list) ? \
+    ns_list_counted_count_(&(list)->slist) : \
+    ns_list_count_(&(list)->slist, NS_LIST_OFFSET_(list)))
 
 /** \privatesection
  *  Internal functions - designed to be accessed using corresponding macros above
@@ -584,6 +758,21 @@ NS_INLINE void ns_list_remove_(ns_list_t *list, ns_list_offset_t link_offset, vo
 NS_INLINE void ns_list_replace_(ns_list_t *list, ns_list_offset_t link_offset, void *current, void *restrict replacement);
 NS_INLINE void ns_list_concatenate_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t offset);
 NS_INLINE uint_fast16_t ns_list_count_(const ns_list_t *list, ns_list_offset_t link_offset);
+NS_INLINE void ns_list_counted_init_(ns_list_t *list);
+NS_INLINE void ns_list_counted_add_to_start_(ns_list_t *list, ns_list_offset_t link_offset, void *restrict entry);
+NS_INLINE void ns_list_counted_add_to_end_(ns_list_t *list, ns_list_offset_t link_offset, void *restrict entry);
+NS_INLINE void ns_list_counted_add_before_(ns_list_t *list, ns_list_offset_t link_offset, void *before, void *restrict entry);
+NS_INLINE void ns_list_counted_add_after_(ns_list_t *list, ns_list_offset_t link_offset, void *after, void *restrict entry);
+NS_INLINE void ns_list_counted_remove_(ns_list_t *list, ns_list_offset_t link_offset, void *entry);
+NS_INLINE void ns_list_counted_concatenate_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t offset);
+NS_INLINE uint_fast16_t ns_list_counted_count_(const ns_list_t *list);
+NS_INLINE void ns_list_splice_range_(ns_list_t *dst, void *before, ns_list_t *src, ns_list_offset_t link_offset, void *first, void *last);
+NS_INLINE void ns_list_split_after_(ns_list_t *list, ns_list_offset_t link_offset, void *entry, ns_list_t *dst);
+NS_INLINE void ns_list_counted_splice_range_(ns_list_t *dst, void *before, ns_list_t *src, ns_list_offset_t link_offset, void *first, void *last);
+NS_INLINE void ns_list_counted_split_after_(ns_list_t *list, ns_list_offset_t link_offset, void *entry, ns_list_t *dst);
+void ns_list_sort_(ns_list_t *list, ns_list_offset_t link_offset, ns_list_compare_t *compare);
+void ns_list_merge_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t link_offset, ns_list_compare_t *compare);
+void ns_list_counted_merge_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t link_offset, ns_list_compare_t *compare);
 
 /* Provide definitions, either for inlining, or for ns_list.c */
 #if defined NS_ALLOW_INLINING || defined NS_LIST_FN
@@ -605,6 +794,9 @@ NS_INLINE uint_fast16_t ns_list_count_(const ns_list_t *list, ns_list_offset_t l
  * as the next pointer is first in the ns_list_link_t */
 #define NS_LIST_ENTRY_(linkptr, offset) ((void *)((char *)(linkptr) - offset))
 
+/* Lvalue of the entry count of a counted list; the list head is the first member of ns_list_counted_t */
+#define NS_LIST_COUNT_(list) (((ns_list_counted_t *)(list))->count)
+
 NS_LIST_FN void ns_list_init_(ns_list_t *list)
 {
     list->first_entry = NULL;
@@ -765,6 +957,112 @@ NS_LIST_FN uint_fast16_t ns_list_count_(const ns_list_t *list, ns_list_offset_t
 
     return count;
 }
+
+NS_LIST_FN void ns_list_counted_init_(ns_list_t *list)
+{
+    ns_list_init_(list);
+    NS_LIST_COUNT_(list) = 0;
+}
+
+NS_LIST_FN void ns_list_counted_add_to_start_(ns_list_t *list, ns_list_offset_t offset, void *restrict entry)
+{
+    ns_list_add_to_start_(list, offset, entry);
+    NS_LIST_COUNT_(list)++;
+}
+
+NS_LIST_FN void ns_list_counted_add_to_end_(ns_list_t *list, ns_list_offset_t offset, void *restrict entry)
+{
+    ns_list_add_to_end_(list, offset, entry);
+    NS_LIST_COUNT_(list)++;
+}
+
+NS_LIST_FN void ns_list_counted_add_before_(ns_list_t *list, ns_list_offset_t offset, void *current, void *restrict entry)
+{
+    ns_list_add_before_(offset, current, entry);
+    NS_LIST_COUNT_(list)++;
+}
+
+NS_LIST_FN void ns_list_counted_add_after_(ns_list_t *list, ns_list_offset_t offset, void *current, void *restrict entry)
+{
+    ns_list_add_after_(list, offset, current, entry);
+    NS_LIST_COUNT_(list)++;
+}
+
+NS_LIST_FN void ns_list_counted_remove_(ns_list_t *list, ns_list_offset_t offset, void *removed)
+{
+    ns_list_remove_(list, offset, removed);
+    NS_LIST_COUNT_(list)--;
+}
+
+NS_LIST_FN void ns_list_counted_concatenate_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t offset)
+{
+    ns_list_concatenate_(dst, src, offset);
+    NS_LIST_COUNT_(dst) += NS_LIST_COUNT_(src);
+    NS_LIST_COUNT_(src) = 0;
+}
+
+NS_LIST_FN uint_fast16_t ns_list_counted_count_(const ns_list_t *list)
+{
+    return ((const ns_list_counted_t *) list)->count;
+}
+
+NS_LIST_FN void ns_list_splice_range_(ns_list_t *dst, void *before, ns_list_t *src, ns_list_offset_t offset, void *first, void *last)
+{
+    void **first_prev = NS_LIST_PREV_(first, offset);
+    void *after_last = NS_LIST_NEXT_(last, offset);
+
+    /* Detach the range from the source list */
+    *first_prev = after_last;
+    if (after_last) {
+        NS_LIST_PREV_(after_last, offset) = first_prev;
+    } else {
+        src->last_nextptr = first_prev;
+    }
+
+    /* And link it in before the specified entry, or at the end */
+    if (before) {
+        void **before_prev = NS_LIST_PREV_(before, offset);
+        *before_prev = first;
+        NS_LIST_PREV_(first, offset) = before_prev;
+        NS_LIST_NEXT_(last, offset) = before;
+        NS_LIST_PREV_(before, offset) = &NS_LIST_NEXT_(last, offset);
+    } else {
+        *dst->last_nextptr = first;
+        NS_LIST_PREV_(first, offset) = dst->last_nextptr;
+        NS_LIST_NEXT_(last, offset) = NULL;
+        dst->last_nextptr = &NS_LIST_NEXT_(last, offset);
+    }
+}
+
+NS_LIST_FN void ns_list_split_after_(ns_list_t *list, ns_list_offset_t offset, void *entry, ns_list_t *dst)
+{
+    void *first = NS_LIST_NEXT_(entry, offset);
+
+    if (first) {
+        ns_list_splice_range_(dst, NULL, list, offset, first, NS_LIST_ENTRY_(list->last_nextptr, offset));
+    }
+}
+
+NS_LIST_FN void ns_list_counted_splice_range_(ns_list_t *dst, void *before, ns_list_t *src, ns_list_offset_t offset, void *first, void *last)
+{
+    uint_fast16_t count = 1;
+
+    for (void *e = first; e != last; e = NS_LIST_NEXT_(e, offset)) {
+        count++;
+    }
+    ns_list_splice_range_(dst, before, src, offset, first, last);
+    NS_LIST_COUNT_(src) -= count;
+    NS_LIST_COUNT_(dst) += count;
+}
+
+NS_LIST_FN void ns_list_counted_split_after_(ns_list_t *list, ns_list_offset_t offset, void *entry, ns_list_t *dst)
+{
+    void *first = NS_LIST_NEXT_(entry, offset);
+
+    if (first) {
+        ns_list_counted_splice_range_(dst, NULL, list, offset, first, NS_LIST_ENTRY_(list->last_nextptr, offset));
+    }
+}
 #endif /* defined NS_ALLOW_INLINING || defined NS_LIST_FN */
 
 #ifdef __cplusplus
@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_LIST_HPP_
+#define NS_LIST_HPP_
+
+#include "ns_list.h"
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+/** \file
+ * \ingroup ns_list
+ * \brief C++ wrapper for the linked list support library.
+ *
+ * The ns_list.hpp file provides ns::intrusive_list, a C++11 class template
+ * over the same list head and entry link as ns_list.h. The link offset is a
+ * template parameter, so entry pointers are typed without the
+ * NS_LIST_PTR_TYPE_ decltype casts, and link accesses are compile-time
+ * constant offsets.
+ *
+ * Iteration is implemented in this header, so loops are fully inlined
+ * (ns_list.h inline functions are not inlined in C++, see NS_ALLOW_INLINING).
+ * Other operations call the ns_list.h functions. Bidirectional iterators are
+ * provided for range-based for loops and standard algorithms.
+ * ~~~
+ *     typedef struct example_entry
+ *     {
+ *         uint8_t        *data;
+ *         uint32_t        data_count;
+ *         ns_list_link_t  link;
+ *     }
+ *     example_entry_t;
+ *
+ *     typedef ns::intrusive_list<example_entry_t, offsetof(example_entry_t, link)> example_list_t;
+ *
+ *     example_list_t my_list;
+ *     my_list.add_to_end(entry);
+ *     for (example_entry_t &e : my_list) {
+ *         ...
+ *     }
+ *     auto big = std::find_if(my_list.begin(), my_list.end(),
+ *                             [](const example_entry_t &e) { return e.data_count > 100; });
+ * ~~~
+ *
+ * Lists are not copyable or movable, as entries point back into the head.
+ * Iterators remain valid until their entry is removed; erase() returns an
+ * iterator to the next entry.
+ *
+ * If the Counted template parameter is true, the list maintains an entry
+ * count as NS_LIST_HEAD_COUNTED() lists do, and size() is O(1).
+ */
+
+namespace ns {
+
+/** \brief Intrusive doubly-linked list of T, linked by the ns_list_link_t at LinkOffset in T. */
+template <typename T, ns_list_offset_t LinkOffset, bool Counted = false>
+class intrusive_list {
+    static_assert(LinkOffset + sizeof(ns_list_link_t) <= sizeof(T), "link offset outside entry");
+
+public:
+    typedef T value_type;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef uint_fast16_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    /** \brief Offset of the link member in the entry */
+    static constexpr ns_list_offset_t link_offset = LinkOffset;
+
+    /** \brief true if the list maintains an entry count */
+    static constexpr bool counted = Counted;
+
+    /** \brief Bidirectional iterator, E is T or const T */
+    template <typename E>
+    class basic_iterator {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename std::remove_const<E>::type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef E *pointer;
+        typedef E &reference;
+
+        basic_iterator() noexcept : list_(nullptr), entry_(nullptr) {}
+
+        /** Conversion from iterator to const_iterator */
+        template <typename F, typename = typename std::enable_if<std::is_convertible<F *, E *>::value>::type>
+        basic_iterator(const basic_iterator<F> &other) noexcept : list_(other.list_), entry_(other.entry_) {}
+
+        reference operator*() const noexcept
+        {
+            return *entry_;
+        }
+
+        pointer operator->() const noexcept
+        {
+            return entry_;
+        }
+
+        basic_iterator &operator++() noexcept
+        {
+            entry_ = intrusive_list::next(entry_);
+            return *this;
+        }
+
+        basic_iterator operator++(int) noexcept
+        {
+            basic_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        /** Decrementing end() gives the last entry */
+        basic_iterator &operator--() noexcept
+        {
+            entry_ = entry_ ? list_->get_previous(entry_) : list_->get_last();
+            return *this;
+        }
+
+        basic_iterator operator--(int) noexcept
+        {
+            basic_iterator tmp = *this;
+            --*this;
+            return tmp;
+        }
+
+        template <typename F>
+        bool operator==(const basic_iterator<F> &other) const noexcept
+        {
+            return entry_ == other.entry_;
+        }
+
+        template <typename F>
+        bool operator!=(const basic_iterator<F> &other) const noexcept
+        {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        friend class intrusive_list;
+        template <typename F> friend class basic_iterator;
+
+        basic_iterator(const intrusive_list *list, E *entry) noexcept : list_(list), entry_(entry) {}
+
+        const intrusive_list *list_;
+        E *entry_;
+    };
+
+    typedef basic_iterator<T> iterator;
+    typedef basic_iterator<const T> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    intrusive_list() noexcept
+    {
+        init();
+    }
+
+    intrusive_list(const intrusive_list &) = delete;
+    intrusive_list &operator=(const intrusive_list &) = delete;
+
+    /** \brief Reinitialise to empty, detaching any entries. */
+    void init() noexcept
+    {
+        if (Counted) {
+            ns_list_counted_init_(list());
+        } else {
+            ns_list_init_(list());
+        }
+    }
+
+    bool is_empty() const noexcept
+    {
+        return !list()->first_entry;
+    }
+
+    bool empty() const noexcept
+    {
+        return is_empty();
+    }
+
+    /** \brief Number of entries - O(1) if counted, otherwise O(n). */
+    size_type size() const noexcept
+    {
+        return Counted ? ns_list_counted_count_(list()) : ns_list_count_(list(), LinkOffset);
+    }
+
+    T *get_first() const noexcept
+    {
+        return static_cast<T *>(list()->first_entry);
+    }
+
+    T *get_last() const noexcept
+    {
+        return is_empty() ? nullptr : entry(list()->last_nextptr);
+    }
+
+    T *get_next(const T *current) const noexcept
+    {
+        return next(current);
+    }
+
+    T *get_previous(const T *current) const noexcept
+    {
+        // prev points to the previous entry's next pointer, which is first in its link
+        return current == list()->first_entry ? nullptr : entry(link(current)->prev);
+    }
+
+    void add_to_start(T *entry)
+    {
+        if (Counted) {
+            ns_list_counted_add_to_start_(list(), LinkOffset, entry);
+        } else {
+            ns_list_add_to_start_(list(), LinkOffset, entry);
+        }
+    }
+
+    void add_to_end(T *entry)
+    {
+        if (Counted) {
+            ns_list_counted_add_to_end_(list(), LinkOffset, entry);
+        } else {
+            ns_list_add_to_end_(list(), LinkOffset, entry);
+        }
+    }
+
+    void add_before(T *before, T *entry)
+    {
+        if (Counted) {
+            ns_list_counted_add_before_(list(), LinkOffset, before, entry);
+        } else {
+            ns_list_add_before_(LinkOffset, before, entry);
+        }
+    }
+
+    void add_after(T *after, T *entry)
+    {
+        if (Counted) {
+            ns_list_counted_add_after_(list(), LinkOffset, after, entry);
+        } else {
+            ns_list_add_after_(list(), LinkOffset, after, entry);
+        }
+    }
+
+    void remove(T *entry)
+    {
+        if (Counted) {
+            ns_list_counted_remove_(list(), LinkOffset, entry);
+        } else {
+            ns_list_remove_(list(), LinkOffset, entry);
+        }
+    }
+
+    void replace(T *current, T *replacement)
+    {
+        ns_list_replace_(list(), LinkOffset, current, replacement);
+    }
+
+    /** \brief Move all entries of src to the end of this list. */
+    void concatenate(intrusive_list &src)
+    {
+        if (Counted) {
+            ns_list_counted_concatenate_(list(), src.list(), LinkOffset);
+        } else {
+            ns_list_concatenate_(list(), src.list(), LinkOffset);
+        }
+    }
+
+    /** \brief Stable sort - see ns_list_sort(). */
+    void sort(ns_list_compare_t *compare)
+    {
+        ns_list_sort_(list(), LinkOffset, compare);
+    }
+
+    /** \brief Merge sorted src into this sorted list - see ns_list_merge(). */
+    void merge(intrusive_list &src, ns_list_compare_t *compare)
+    {
+        if (Counted) {
+            ns_list_counted_merge_(list(), src.list(), LinkOffset, compare);
+        } else {
+            ns_list_merge_(list(), src.list(), LinkOffset, compare);
+        }
+    }
+
+    /** \brief Move entries first to last of src before an entry - see ns_list_splice_range(). */
+    void splice_range(T *before, intrusive_list &src, T *first, T *last)
+    {
+        if (Counted) {
+            ns_list_counted_splice_range_(list(), before, src.list(), LinkOffset, first, last);
+        } else {
+            ns_list_splice_range_(list(), before, src.list(), LinkOffset, first, last);
+        }
+    }
+
+    /** \brief Move entries after an entry to the end of dst - see ns_list_split_after(). */
+    void split_after(T *entry, intrusive_list &dst)
+    {
+        if (Counted) {
+            ns_list_counted_split_after_(list(), LinkOffset, entry, dst.list());
+        } else {
+            ns_list_split_after_(list(), LinkOffset, entry, dst.list());
+        }
+    }
+
+    iterator begin() noexcept
+    {
+        return iterator(this, get_first());
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return const_iterator(this, get_first());
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    iterator end() noexcept
+    {
+        return iterator(this, nullptr);
+    }
+
+    const_iterator end() const noexcept
+    {
+        return const_iterator(this, nullptr);
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    reverse_iterator rbegin() noexcept
+    {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin() const noexcept
+    {
+        return const_reverse_iterator(end());
+    }
+
+    reverse_iterator rend() noexcept
+    {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend() const noexcept
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    /** \brief Iterator to an entry on the list */
+    iterator iterator_to(T &entry) noexcept
+    {
+        return iterator(this, &entry);
+    }
+
+    /** \brief Remove the entry at pos, returning an iterator to the next entry */
+    iterator erase(const_iterator pos)
+    {
+        T *entry = const_cast<T *>(pos.entry_);
+        iterator next_pos(this, next(entry));
+        remove(entry);
+        return next_pos;
+    }
+
+    /** \brief Insert an entry before pos, which can be end() */
+    iterator insert(const_iterator pos, T &entry)
+    {
+        if (pos.entry_) {
+            add_before(const_cast<T *>(pos.entry_), &entry);
+        } else {
+            add_to_end(&entry);
+        }
+        return iterator(this, &entry);
+    }
+
+private:
+    typedef typename std::conditional<Counted, ns_list_counted_t, ns_list_t>::type head_type;
+
+    // ns_list_counted_t starts with its ns_list_t
+    ns_list_t *list() noexcept
+    {
+        return reinterpret_cast<ns_list_t *>(&head_);
+    }
+
+    const ns_list_t *list() const noexcept
+    {
+        return reinterpret_cast<const ns_list_t *>(&head_);
+    }
+
+    static ns_list_link_t *link(const T *entry) noexcept
+    {
+        return reinterpret_cast<ns_list_link_t *>(reinterpret_cast<char *>(const_cast<T *>(entry)) + LinkOffset);
+    }
+
+    // Entry containing a link, or its next pointer
+    static T *entry(void *link) noexcept
+    {
+        return reinterpret_cast<T *>(static_cast<char *>(link) - LinkOffset);
+    }
+
+    static T *entry(void **next_ptr) noexcept
+    {
+        return entry(static_cast<void *>(next_ptr));
+    }
+
+    static T *next(const T *current) noexcept
+    {
+        return static_cast<T *>(link(current)->next);
+    }
+
+    head_type head_;
+};
+
+template <typename T, ns_list_offset_t LinkOffset, bool Counted>
+constexpr ns_list_offset_t intrusive_list<T, LinkOffset, Counted>::link_offset;
+
+template <typename T, ns_list_offset_t LinkOffset, bool Counted>
+constexpr bool intrusive_list<T, LinkOffset, Counted>::counted;
+
+/** \brief Alias for an intrusive_list maintaining an entry count */
+template <typename T, ns_list_offset_t LinkOffset>
+using counted_intrusive_list = intrusive_list<T, LinkOffset, true>;
+
+} // namespace ns
+
+#endif /* NS_LIST_HPP_ */
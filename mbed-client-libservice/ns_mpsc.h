@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_MPSC_H_
+#define NS_MPSC_H_
+
+#include "ns_types.h"
+#include "ns_list.h"
+
+#if !defined __cplusplus && defined __STDC_VERSION__ && __STDC_VERSION__ >= 201112L && !defined __STDC_NO_ATOMICS__
+#include <stdatomic.h>
+#if ATOMIC_POINTER_LOCK_FREE == 2
+#define NS_MPSC_LOCK_FREE 1
+#endif
+#endif
+
+#ifndef NS_MPSC_LOCK_FREE
+#define NS_MPSC_LOCK_FREE 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file
+ * \ingroup ns_list
+ * \brief Multi-producer single-consumer queue support library.
+ *
+ * The ns_mpsc.h file provides an intrusive FIFO queue that can be pushed to
+ * from any thread or interrupt handler, and popped from one consumer thread,
+ * typically the stack's event loop. It is intended for handing entries over
+ * to the event loop without putting every ns_list operation in
+ * platform_enter_critical().
+ *
+ * Pushing is wait-free, a single atomic exchange and store. Popping is
+ * lock-free, and does not block producers.
+ *
+ * The implementation uses C11 atomics when the compiler provides them and
+ * pointer atomics are lock-free. Otherwise the atomic accesses are done in
+ * platform_enter_critical(), so the queue works everywhere, but without the
+ * benefit of not disabling interrupts.
+ *
+ * Memory footprint is three pointers for the queue head, and one pointer in
+ * each entry. An entry can only be on one queue at a time; as an entry is
+ * normally moved from the queue to an ns_list by the consumer, the two links
+ * can share storage:
+ * ~~~
+ *     typedef struct example_event
+ *     {
+ *         int event_type;
+ *         union {
+ *             ns_mpsc_link_t mpsc_link;
+ *             ns_list_link_t link;
+ *         };
+ *     }
+ *     example_event_t;
+ *
+ *     static NS_MPSC_DEFINE(posted_events, example_event_t, mpsc_link);
+ *
+ *     // in interrupt handler
+ *     ns_mpsc_push(&posted_events, event);
+ *     signal_event_loop();
+ *
+ *     // in event loop
+ *     example_event_t *event;
+ *     while ((event = ns_mpsc_pop(&posted_events)) != NULL) {
+ *         ns_list_add_to_end(&event_queue, event);
+ *     }
+ * ~~~
+ *
+ * NOTE: the link field SHALL NOT be accessed by the user.
+ *
+ * As with ns_list, the operations are implemented as type-checked macros. The
+ * macros do not evaluate any arguments more than once, unless documented.
+ *
+ * In macro documentation, `mpsc_t` refers to a queue type defined using
+ * NS_MPSC_HEAD(), and `entry_t` to the entry type that was passed to it.
+ */
+
+/// \privatesection
+/** \brief Internal macro declaring a pointer shared between threads */
+#if NS_MPSC_LOCK_FREE
+#define NS_MPSC_ATOMIC_(type) _Atomic(type)
+#else
+#define NS_MPSC_ATOMIC_(type) type
+#endif
+
+/// \publicsection
+/** \brief The type for the link member in the user's entry structure.
+ *
+ * Users should not access this member directly - just pass its name to the
+ * queue head macros.
+ */
+typedef struct ns_mpsc_link {
+    NS_MPSC_ATOMIC_(struct ns_mpsc_link *) next;    ///< Next link towards the producer end, or NULL
+} ns_mpsc_link_t;
+
+/** \brief Underlying generic queue head.
+ *
+ * Users should not use this type directly, but use the NS_MPSC_HEAD() macro.
+ */
+typedef struct ns_mpsc {
+    NS_MPSC_ATOMIC_(ns_mpsc_link_t *) head; ///< Last pushed link, or stub - accessed by producers
+    ns_mpsc_link_t *tail;                   ///< Link to pop next, or stub - accessed by consumer
+    ns_mpsc_link_t stub;                    ///< Placeholder link, keeping the queue non-empty
+} ns_mpsc_t;
+
+/** \brief Declare a queue head type
+ *
+ * As NS_LIST_HEAD() - see its documentation.
+ * ~~~
+ *     typedef NS_MPSC_HEAD(example_event_t, mpsc_link) example_event_mpsc_t;
+ * ~~~
+ */
+#define NS_MPSC_HEAD(entry_type, field) \
+    NS_MPSC_HEAD_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
+/// \privatesection
+/** \brief Internal macro defining a queue head, given the offset to the link
+ * The offset and type members are used by the ns_list.h internal macros.
+ */
+#define NS_MPSC_HEAD_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_mpsc_t smpsc; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    entry_type *type; \
+}
+
+/// \publicsection
+/** \hideinitializer \brief Initialise a queue
+ *
+ * A queue head must be initialised using this function, NS_MPSC_INIT() or
+ * NS_MPSC_DEFINE() before use. If used on a queue containing existing
+ * entries, those entries will become detached. Must not be called while
+ * producers may be pushing to the queue.
+ *
+ * \param mpsc Pointer to a NS_MPSC_HEAD() structure.
+ */
+#define ns_mpsc_init(mpsc) ns_mpsc_init_(&(mpsc)->smpsc)
+
+/** \brief Initialiser for an empty queue
+ *
+ * Usage in an enclosing initialiser:
+ * ~~~
+ *     static my_type_including_a_queue_t x = {
+ *         "Something",
+ *         23,
+ *         NS_MPSC_INIT(x.queue),
+ *     };
+ * ~~~
+ * NS_MPSC_DEFINE() or ns_mpsc_init() provide simpler alternatives.
+ */
+#define NS_MPSC_INIT(name) { { &(name).smpsc.stub, &(name).smpsc.stub, { NULL } } }
+
+/** \brief Define a queue, and initialise to empty.
+ *
+ * Usage:
+ * ~~~
+ *     static NS_MPSC_DEFINE(my_queue, entry_t, link);
+ * ~~~
+ */
+#define NS_MPSC_DEFINE(name, type, field) \
+    NS_MPSC_HEAD(type, field) name = NS_MPSC_INIT(name)
+
+/** \hideinitializer \brief Push an entry to the end of the queue.
+ *
+ * Can be called from any thread or interrupt handler.
+ *
+ * \param mpsc  `(mpsc_t *)`            Pointer to queue.
+ * \param entry `(entry_t * restrict)`  Pointer to new entry to push.
+ */
+#define ns_mpsc_push(mpsc, entry) \
+    ns_mpsc_push_(&(mpsc)->smpsc, NS_LIST_OFFSET_(mpsc), NS_LIST_TYPECHECK_(mpsc, entry))
+
+/** \hideinitializer \brief Pop an entry from the start of the queue.
+ *
+ * Must only be called from the consumer thread.
+ *
+ * If a producer is in the middle of pushing, entries pushed by it and after
+ * it cannot be popped until its push completes, and NULL may be returned
+ * although the queue is not empty. Producers should signal the consumer
+ * after pushing, so that it tries again.
+ *
+ * \param mpsc `(mpsc_t *)`  Pointer to queue.
+ *
+ * \return     `(entry_t *)` Pointer to popped entry.
+ * \return                   NULL if no entry is available.
+ */
+#define ns_mpsc_pop(mpsc) \
+    NS_LIST_TYPECAST_(mpsc, ns_mpsc_pop_(&(mpsc)->smpsc, NS_LIST_OFFSET_(mpsc)))
+
+/** \hideinitializer \brief Check if a queue is empty.
+ *
+ * Must only be called from the consumer thread. The result may be outdated
+ * immediately, if producers are pushing.
+ *
+ * \param mpsc `(mpsc_t *)` Pointer to queue.
+ *
+ * \return     `(bool)`     true if the queue is empty.
+ */
+#define ns_mpsc_is_empty(mpsc) ns_mpsc_is_empty_(&(mpsc)->smpsc)
+
+/** \privatesection
+ *  Internal functions - designed to be accessed using corresponding macros above
+ */
+void ns_mpsc_init_(ns_mpsc_t *mpsc);
+void ns_mpsc_push_(ns_mpsc_t *mpsc, ns_list_offset_t link_offset, void *restrict entry);
+void *ns_mpsc_pop_(ns_mpsc_t *mpsc, ns_list_offset_t link_offset);
+bool ns_mpsc_is_empty_(ns_mpsc_t *mpsc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NS_MPSC_H_ */
@@ -29,7 +29,8 @@
  *
  * When client writes data this module will:
  * -initialize the NVM if not already initialized
- * -(re)create the key with a given size
+ * -(re)create the key with a given size, unless the key was recently created
+ *  by this module with the same size (see ns_nvm_key_index_set)
  * -write data to the key
  * -flush data to the NVM
  *
@@ -40,6 +41,30 @@
  * When client deletes a key this module will:
  * -initialize the NVM if not initialized
  * -delete the key from NVM
+ *
+ * Optionally written data can be cached in RAM (write-back cache, see
+ * ns_nvm_write_back_set). Cached writes complete immediately and repeated
+ * writes to the same key are coalesced, so that only the latest value is
+ * written to NVM when the write-back delay expires or ns_nvm_sync is called.
+ *
+ * Writes and deletes can be grouped to a batch (see ns_nvm_batch_begin). Batch
+ * members are not flushed separately, NVM is flushed once when the batch is committed.
+ *
+ * Optionally read data can be cached in RAM (read cache, see ns_nvm_read_cache_set).
+ * Reads of recently read keys are then completed without accessing platform NVM.
+ *
+ * By default one request is executed at a time and other requests wait in a queue.
+ * If platform NVM can handle overlapping operations, requests to different keys can
+ * be executed concurrently (see ns_nvm_in_flight_depth_set). Requests to the same key
+ * are always executed in the order they were made.
+ *
+ * Queued requests are started in priority order (see ns_nvm_data_read_prio). A request
+ * waiting behind higher priority requests is raised in priority, so it is not starved.
+ *
+ * A queued write or delete is not executed if a newer write or delete to the same key
+ * is queued after it, unless a read of the key or ns_nvm_sync is queued in between.
+ * Callback of the replaced request is called with the status of the newer request.
+ * Batch members are not replaced.
  */
 
 /*
@@ -55,6 +80,23 @@
  */
 typedef void (ns_nvm_callback)(int status, void *context);
 
+/**
+ *  Priority of a queued request
+ */
+typedef enum {
+    NS_NVM_PRIORITY_LOW = 0,    /**< Bulk data, e.g. statistics */
+    NS_NVM_PRIORITY_NORMAL,     /**< Default priority */
+    NS_NVM_PRIORITY_HIGH        /**< Latency sensitive data, e.g. credentials */
+} ns_nvm_priority_t;
+
+/**
+ *  Read cache statistics
+ */
+typedef struct {
+    uint32_t hits;      /**< Reads completed from read cache */
+    uint32_t misses;    /**< Reads made to platform NVM while read cache is enabled */
+} ns_nvm_read_cache_statistics_t;
+
 /**
  * \brief Delete key from NVM
  *
@@ -97,3 +139,169 @@ int ns_nvm_data_read(ns_nvm_callback *callback, const char *key_name, uint8_t *b
  * \return provided callback function will be called with status indicating success or failure.
  */
 int ns_nvm_data_write(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context);
+
+/**
+ * \brief Delete key from NVM with given priority
+ *
+ * As ns_nvm_key_delete, but request is started before queued requests of lower priority.
+ * Requests to the same key are still executed in the order they were made.
+ *
+ * \param priority priority of the request, ns_nvm_key_delete uses NS_NVM_PRIORITY_NORMAL
+ */
+int ns_nvm_key_delete_prio(ns_nvm_callback *callback, const char *key_name, void *context, ns_nvm_priority_t priority);
+
+/**
+ * \brief Read data from NVM with given priority
+ *
+ * As ns_nvm_data_read, but request is started before queued requests of lower priority.
+ * Requests to the same key are still executed in the order they were made.
+ *
+ * \param priority priority of the request, ns_nvm_data_read uses NS_NVM_PRIORITY_NORMAL
+ */
+int ns_nvm_data_read_prio(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context, ns_nvm_priority_t priority);
+
+/**
+ * \brief Write data to NVM with given priority
+ *
+ * As ns_nvm_data_write, but request is started before queued requests of lower priority.
+ * Requests to the same key are still executed in the order they were made.
+ *
+ * \param priority priority of the request, ns_nvm_data_write uses NS_NVM_PRIORITY_NORMAL
+ */
+int ns_nvm_data_write_prio(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context, ns_nvm_priority_t priority);
+
+/**
+ * \brief Configure write-back cache
+ *
+ * When write-back cache is enabled, ns_nvm_data_write copies the data to RAM and
+ * calls the callback before returning. Data is written to NVM when write-back delay
+ * has expired (see ns_nvm_write_back_timer) or when ns_nvm_sync is called. Further
+ * writes to the same key before that only replace the cached data. Reads of a cached
+ * key are served from the cache and callback is called before returning. If the cache
+ * is full, data is written directly to NVM.
+ *
+ * Write-back cache is disabled by default. Disabling the cache does not drop
+ * cached data, it is still written to NVM by timer or ns_nvm_sync.
+ *
+ * \param delay write-back delay in ns_nvm_write_back_timer ticks
+ * \param max_entries maximum number of cached keys, 0 disables the cache
+ */
+void ns_nvm_write_back_set(uint32_t delay, uint8_t max_entries);
+
+/**
+ * \brief Write-back cache timer
+ *
+ * Writes cached data whose write-back delay has expired to NVM. Should be called
+ * periodically when write-back cache is enabled.
+ *
+ * \param ticks number of ticks elapsed since previous call
+ */
+void ns_nvm_write_back_timer(uint32_t ticks);
+
+/**
+ * \brief Write all cached data to NVM
+ *
+ * Writes all cached data to NVM and calls the callback when all write requests made
+ * before this call have been completed. Callback may be called before returning.
+ *
+ * \param callback function to be called when data has been written
+ * \param context argument will be provided as an argument when callback is called
+ *
+ * \return NS_NVM_OK if synchronization is in progress and callback will be called
+ * \return NS_NVM_ERROR or NS_NVM_MEMORY in error case, callback will not be called
+ * \return provided callback function will be called with NS_NVM_ERROR if writing any
+ *         cached data has failed since previous ns_nvm_sync, otherwise NS_NVM_OK.
+ */
+int ns_nvm_sync(ns_nvm_callback *callback, void *context);
+
+/**
+ * \brief Configure read cache
+ *
+ * When read cache is enabled, data read successfully from NVM is stored to RAM and
+ * following reads of the same key are completed from the cache; callback is called
+ * before returning. When the cache is full, least recently used key is removed.
+ * Writes and deletes made using this module remove the key from the cache.
+ *
+ * Read cache is disabled by default.
+ *
+ * \param max_entries maximum number of cached keys, 0 disables the cache
+ */
+void ns_nvm_read_cache_set(uint8_t max_entries);
+
+/**
+ * \brief Get read cache statistics
+ *
+ * \param statistics read cache hit and miss counts
+ */
+void ns_nvm_read_cache_statistics_get(ns_nvm_read_cache_statistics_t *statistics);
+
+/**
+ * \brief Begin a batch of writes and deletes
+ *
+ * Following ns_nvm_data_write and ns_nvm_key_delete calls are members of the batch
+ * until ns_nvm_batch_commit is called. Batch members are written to NVM in order
+ * without flushing and bypass write-back cache. Member callbacks are called when
+ * the batch has been flushed, with status of the member; member callback can be NULL.
+ *
+ * \return NS_NVM_OK if batch was started
+ * \return NS_NVM_ERROR if batch is already open
+ */
+int ns_nvm_batch_begin(void);
+
+/**
+ * \brief Commit a batch of writes and deletes
+ *
+ * Flushes NVM once after all batch members have been written. Member callbacks are
+ * called before the commit callback. Callback may be called before returning.
+ *
+ * \param callback function to be called when batch has been committed
+ * \param context argument will be provided as an argument when callback is called
+ *
+ * \return NS_NVM_OK if commit is in progress and callback will be called
+ * \return NS_NVM_ERROR or NS_NVM_MEMORY in error case, batch stays open and callback will not be called
+ * \return provided callback function will be called with status of the first failed member
+ *         or flush status if all members succeeded.
+ */
+int ns_nvm_batch_commit(ns_nvm_callback *callback, void *context);
+
+/**
+ * \brief Set the maximum number of requests executed concurrently
+ *
+ * Requests to different keys are started without waiting for earlier requests to
+ * complete, until depth requests are in progress. Requests to the same key, sync and
+ * batch commit are started after earlier conflicting requests have been completed.
+ * Platform NVM must support overlapping operations when depth is greater than one.
+ *
+ * \param depth maximum number of requests in progress, 0 or 1 (default) executes one request at a time
+ */
+void ns_nvm_in_flight_depth_set(uint8_t depth);
+
+/**
+ * \brief Set the number of created keys remembered
+ *
+ * Keys created by this module are remembered together with their size, and writes of
+ * the same size to a remembered key are made without re-creating the key. If the key
+ * has been deleted outside of this module, it is created again. Least recently written
+ * keys are forgotten first. Default size is NS_NVM_HELPER_KEY_INDEX_SIZE (8).
+ *
+ * \param max_entries maximum number of keys remembered, 0 disables the index
+ */
+void ns_nvm_key_index_set(uint8_t max_entries);
+
+/**
+ * \brief Preallocate requests
+ *
+ * Each NVM operation needs a request that is normally allocated from the heap with
+ * ns_dyn_mem_temporary_alloc. After this call requests are taken from a pool of count
+ * preallocated requests, and the heap is used only if the pool is exhausted.
+ * Initialization needs one request in addition to the request of the first operation.
+ * The pool covers requests only: write-back cache, read cache and key index entries
+ * are still allocated from the heap when those features are enabled.
+ *
+ * \param count number of requests in the pool, 0 releases the pool
+ *
+ * \return NS_NVM_OK if pool was allocated or released
+ * \return NS_NVM_ERROR if pool is already initialized, or pool requests are in use when releasing
+ * \return NS_NVM_MEMORY if pool allocation failed
+ */
+int ns_nvm_request_pool_init(uint8_t count);
@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_PQUEUE_H_
+#define NS_PQUEUE_H_
+
+#include "ns_types.h"
+#include "ns_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file
+ * \ingroup ns_list
+ * \brief Priority queue support library.
+ *
+ * The ns_pqueue.h file provides an intrusive pairing heap, intended for timer
+ * and event queues that would otherwise be kept sorted on an ns_list with an
+ * O(n) insertion.
+ *
+ * Operation           | Cost
+ * ------------------- | ---------------------
+ * insert              | O(1)
+ * get_first           | O(1)
+ * remove_first        | O(log n) amortised
+ * remove              | O(log n) amortised
+ * decrease_key        | O(1)
+ *
+ * Memory footprint is one pointer for the queue head, and three pointers in
+ * each entry.
+ *
+ * The queue does not store a comparison function; it is passed to the
+ * operations that need it, and must be the same for all operations on a
+ * queue. The comparison is `compare(a, b)`, returning a negative value if
+ * entry a should be before entry b. Unlike ns_tree, order of entries with
+ * equal keys is not preserved.
+ *
+ * Example of an entry type that can be stored to this queue.
+ * ~~~
+ *     typedef struct example_timer
+ *     {
+ *         uint32_t         expiry;
+ *         ns_pqueue_link_t link;
+ *     }
+ *     example_timer_t;
+ *
+ *     static int example_timer_compare(const void *a, const void *b)
+ *     {
+ *         uint32_t a_expiry = ((const example_timer_t *) a)->expiry;
+ *         uint32_t b_expiry = ((const example_timer_t *) b)->expiry;
+ *         return a_expiry < b_expiry ? -1 : a_expiry > b_expiry;
+ *     }
+ *
+ *     static NS_PQUEUE_DEFINE(my_timers, example_timer_t, link);
+ *
+ *     ns_pqueue_insert(&my_timers, timer, example_timer_compare);
+ *
+ *     example_timer_t *first;
+ *     while ((first = ns_pqueue_get_first(&my_timers)) && first->expiry <= now) {
+ *         ns_pqueue_remove_first(&my_timers, example_timer_compare);
+ *         ...
+ *     }
+ * ~~~
+ *
+ * NOTE: the link field SHALL NOT be accessed by the user.
+ *
+ * As with ns_list, the operations are implemented as type-checked macros, and
+ * the O(1) operations are inline functions if NS_ALLOW_INLINING is set. The
+ * macros do not evaluate any arguments more than once, unless documented.
+ *
+ * In macro documentation, `pqueue_t` refers to a queue type defined using
+ * NS_PQUEUE_HEAD(), and `entry_t` to the entry type that was passed to it.
+ */
+
+/** \brief The type for the link member in the user's entry structure.
+ *
+ * Users should not access this member directly - just pass its name to the
+ * queue head macros.
+ */
+typedef struct ns_pqueue_link {
+    struct ns_pqueue_link *child;   ///< First child link, or NULL
+    struct ns_pqueue_link *next;    ///< Next sibling link, or NULL
+    struct ns_pqueue_link *prev;    ///< Previous sibling link, parent link if first child, or NULL for root
+} ns_pqueue_link_t;
+
+/** \brief Underlying generic queue head.
+ *
+ * Users should not use this type directly, but use the NS_PQUEUE_HEAD() macro.
+ */
+typedef struct ns_pqueue {
+    ns_pqueue_link_t *root; ///< Link of first entry, or NULL if queue is empty
+} ns_pqueue_t;
+
+/** \brief Comparison function type.
+ *
+ * \param a First entry.
+ * \param b Second entry.
+ *
+ * \return <0 if a is before b, >=0 otherwise.
+ */
+typedef int ns_pqueue_compare_t(const void *a, const void *b);
+
+/** \brief Declare a queue head type
+ *
+ * As NS_LIST_HEAD() - see its documentation.
+ * ~~~
+ *     typedef NS_PQUEUE_HEAD(example_timer_t, link) example_timer_queue_t;
+ * ~~~
+ */
+#define NS_PQUEUE_HEAD(entry_type, field) \
+    NS_PQUEUE_HEAD_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
+/// \privatesection
+/** \brief Internal macro defining a queue head, given the offset to the link
+ * The offset and type members are used by the ns_list.h internal macros.
+ */
+#define NS_PQUEUE_HEAD_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_pqueue_t spqueue; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    entry_type *type; \
+}
+
+/// \publicsection
+/** \hideinitializer \brief Initialise a queue
+ *
+ * A queue head must be initialised using this function, NS_PQUEUE_INIT() or
+ * NS_PQUEUE_DEFINE() before use. If used on a queue containing existing
+ * entries, those entries will become detached.
+ *
+ * \param pqueue Pointer to a NS_PQUEUE_HEAD() structure.
+ */
+#define ns_pqueue_init(pqueue) ((void) ((pqueue)->spqueue.root = NULL))
+
+/** \brief Initialiser for an empty queue */
+#define NS_PQUEUE_INIT(name) { { NULL } }
+
+/** \brief Define a queue, and initialise to empty.
+ *
+ * Usage:
+ * ~~~
+ *     static NS_PQUEUE_DEFINE(my_queue, entry_t, link);
+ * ~~~
+ */
+#define NS_PQUEUE_DEFINE(name, type, field) \
+    NS_PQUEUE_HEAD(type, field) name = NS_PQUEUE_INIT(name)
+
+/** \hideinitializer \brief Insert an entry to the queue.
+ *
+ * O(1).
+ *
+ * \param pqueue  `(pqueue_t *)`            Pointer to queue.
+ * \param entry   `(entry_t * restrict)`    Pointer to new entry to insert.
+ * \param compare `(ns_pqueue_compare_t *)` Comparison function.
+ */
+#define ns_pqueue_insert(pqueue, entry, compare) \
+    ns_pqueue_insert_(&(pqueue)->spqueue, NS_LIST_OFFSET_(pqueue), NS_LIST_TYPECHECK_(pqueue, entry), compare)
+
+/** \brief Check if a queue is empty.
+ *
+ * \param pqueue `(const pqueue_t *)` Pointer to queue.
+ *
+ * \return       `(bool)`             true if the queue is empty.
+ */
+#define ns_pqueue_is_empty(pqueue) ((bool) ((pqueue)->spqueue.root == NULL))
+
+/** \hideinitializer \brief Get the first entry.
+ *
+ * O(1). If several entries compare equal, any of them can be first.
+ *
+ * \param pqueue `(const pqueue_t *)` Pointer to queue.
+ *
+ * \return       `(entry_t *)`        Pointer to first entry.
+ * \return                            NULL if queue is empty.
+ */
+#define ns_pqueue_get_first(pqueue) \
+    NS_LIST_TYPECAST_(pqueue, ns_pqueue_get_first_(&(pqueue)->spqueue, NS_LIST_OFFSET_(pqueue)))
+
+/** \hideinitializer \brief Remove the first entry.
+ *
+ * O(log n) amortised.
+ *
+ * \param pqueue  `(pqueue_t *)`            Pointer to queue.
+ * \param compare `(ns_pqueue_compare_t *)` Comparison function.
+ *
+ * \return        `(entry_t *)`             Pointer to removed entry.
+ * \return                                  NULL if queue was empty.
+ */
+#define ns_pqueue_remove_first(pqueue, compare) \
+    NS_LIST_TYPECAST_(pqueue, ns_pqueue_remove_first_(&(pqueue)->spqueue, NS_LIST_OFFSET_(pqueue), compare))
+
+/** \hideinitializer \brief Remove an entry.
+ *
+ * O(log n) amortised. The entry can be anywhere in the queue.
+ *
+ * \param pqueue  `(pqueue_t *)`            Pointer to queue.
+ * \param entry   `(entry_t *)`             Entry on queue to be removed.
+ * \param compare `(ns_pqueue_compare_t *)` Comparison function.
+ */
+#define ns_pqueue_remove(pqueue, entry, compare) \
+    ns_pqueue_remove_(&(pqueue)->spqueue, NS_LIST_OFFSET_(pqueue), NS_LIST_TYPECHECK_(pqueue, entry), compare)
+
+/** \hideinitializer \brief Reposition an entry after its key has decreased.
+ *
+ * To be called after the key of an entry has been changed so that the entry
+ * moves towards the start of the queue. To move an entry towards the end, use
+ * ns_pqueue_remove() and ns_pqueue_insert().
+ *
+ * O(1).
+ *
+ * \param pqueue  `(pqueue_t *)`            Pointer to queue.
+ * \param entry   `(entry_t *)`             Entry on queue with decreased key.
+ * \param compare `(ns_pqueue_compare_t *)` Comparison function.
+ */
+#define ns_pqueue_decrease_key(pqueue, entry, compare) \
+    ns_pqueue_decrease_key_(&(pqueue)->spqueue, NS_LIST_OFFSET_(pqueue), NS_LIST_TYPECHECK_(pqueue, entry), compare)
+
+/** \privatesection
+ *  Internal functions - designed to be accessed using corresponding macros above
+ */
+NS_INLINE ns_pqueue_link_t *ns_pqueue_meld_(ns_list_offset_t link_offset, ns_pqueue_link_t *a, ns_pqueue_link_t *b, ns_pqueue_compare_t *compare);
+NS_INLINE void ns_pqueue_insert_(ns_pqueue_t *pqueue, ns_list_offset_t link_offset, void *restrict entry, ns_pqueue_compare_t *compare);
+NS_INLINE void *ns_pqueue_get_first_(const ns_pqueue_t *pqueue, ns_list_offset_t link_offset);
+NS_INLINE void ns_pqueue_decrease_key_(ns_pqueue_t *pqueue, ns_list_offset_t link_offset, void *entry, ns_pqueue_compare_t *compare);
+void *ns_pqueue_remove_first_(ns_pqueue_t *pqueue, ns_list_offset_t link_offset, ns_pqueue_compare_t *compare);
+void ns_pqueue_remove_(ns_pqueue_t *pqueue, ns_list_offset_t link_offset, void *entry, ns_pqueue_compare_t *compare);
+
+/* Provide definitions, either for inlining, or for ns_pqueue.c */
+#if defined NS_ALLOW_INLINING || defined NS_PQUEUE_FN
+#ifndef NS_PQUEUE_FN
+#define NS_PQUEUE_FN NS_INLINE
+#endif
+
+/* Pointer to the link member in entry e */
+#define NS_PQUEUE_LINK_(e, offset) ((ns_pqueue_link_t *)((char *)(e) + offset))
+
+/* Convert a link pointer back to the entry */
+#define NS_PQUEUE_ENTRY_(link, offset) ((void *)((char *)(link) - offset))
+
+/* Link the later of two subtree roots as the first child of the other, and
+ * return the new subtree root. Sibling links of the returned root are not
+ * changed.
+ */
+NS_PQUEUE_FN ns_pqueue_link_t *ns_pqueue_meld_(ns_list_offset_t offset, ns_pqueue_link_t *a, ns_pqueue_link_t *b, ns_pqueue_compare_t *compare)
+{
+    if (compare(NS_PQUEUE_ENTRY_(b, offset), NS_PQUEUE_ENTRY_(a, offset)) < 0) {
+        ns_pqueue_link_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    b->next = a->child;
+    if (b->next) {
+        b->next->prev = b;
+    }
+    b->prev = a;
+    a->child = b;
+
+    return a;
+}
+
+NS_PQUEUE_FN void ns_pqueue_insert_(ns_pqueue_t *pqueue, ns_list_offset_t offset, void *restrict entry, ns_pqueue_compare_t *compare)
+{
+    ns_pqueue_link_t *link = NS_PQUEUE_LINK_(entry, offset);
+
+    link->child = NULL;
+    link->next = NULL;
+    link->prev = NULL;
+    if (pqueue->root) {
+        link = ns_pqueue_meld_(offset, pqueue->root, link, compare);
+    }
+    pqueue->root = link;
+}
+
+NS_PQUEUE_FN void *ns_pqueue_get_first_(const ns_pqueue_t *pqueue, ns_list_offset_t offset)
+{
+    return pqueue->root ? NS_PQUEUE_ENTRY_(pqueue->root, offset) : NULL;
+}
+
+NS_PQUEUE_FN void ns_pqueue_decrease_key_(ns_pqueue_t *pqueue, ns_list_offset_t offset, void *entry, ns_pqueue_compare_t *compare)
+{
+    ns_pqueue_link_t *link = NS_PQUEUE_LINK_(entry, offset);
+
+    if (link == pqueue->root) {
+        return;
+    }
+
+    // detach subtree from its parent, and meld it with the root
+    if (link->prev->child == link) {
+        link->prev->child = link->next;
+    } else {
+        link->prev->next = link->next;
+    }
+    if (link->next) {
+        link->next->prev = link->prev;
+    }
+    link->next = NULL;
+    link->prev = NULL;
+    pqueue->root = ns_pqueue_meld_(offset, pqueue->root, link, compare);
+}
+#endif /* defined NS_ALLOW_INLINING || defined NS_PQUEUE_FN */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NS_PQUEUE_H_ */
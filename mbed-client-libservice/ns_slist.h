@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_SLIST_H_
+#define NS_SLIST_H_
+
+#include "ns_types.h"
+#include "ns_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file
+ * \ingroup ns_list
+ * \brief Singly-linked list support library.
+ *
+ * The ns_slist.h file provides a singly-linked list/queue, with O(1)
+ * insertion at either end, O(1) removal from the start, and forward
+ * iteration. It is a companion to ns_list.h for entries that are only ever
+ * queued at the end and taken from the start (FIFO queue), or added to and
+ * taken from the start (stack).
+ *
+ * Memory footprint is two pointers for the list head, and one pointer in each
+ * list entry. It is similar in concept to BSD's STAILQ.
+ *
+ * Compared to ns_list, removal of an arbitrary entry and iteration backwards
+ * are not supported, except ns_slist_remove(), which is O(n).
+ *
+ * Example of an entry type that can be stored to this list.
+ * ~~~
+ *     typedef struct example_entry
+ *     {
+ *         uint8_t         *data;
+ *         uint32_t        data_count;
+ *         ns_slist_link_t link;
+ *     }
+ *     example_entry_t;
+ *
+ *     static NS_SLIST_DEFINE(my_queue, example_entry_t, link);
+ *
+ *     ns_slist_add_to_end(&my_queue, entry);
+ *     ...
+ *     example_entry_t *next = ns_slist_remove_first(&my_queue);
+ * ~~~
+ * NOTE: the link field SHALL NOT be accessed by the user.
+ *
+ * As with ns_list, the operations are implemented as type-checked macros
+ * backed by optionally-inline functions. The macros do not evaluate any
+ * arguments more than once, unless documented.
+ *
+ * In macro documentation, `list_t` refers to a list type defined using
+ * NS_SLIST_HEAD(), and `entry_t` to the entry type that was passed to it.
+ */
+
+/** \brief Underlying generic singly-linked list head.
+ *
+ * Users should not use this type directly, but use the NS_SLIST_HEAD() macro.
+ */
+typedef struct ns_slist {
+    void *first_entry;      ///< Pointer to first entry, or NULL if list is empty
+    void **last_nextptr;    ///< Pointer to last entry's `next` pointer, or
+    ///< to head's `first_entry` pointer if list is empty
+} ns_slist_t;
+
+/** \brief Declare a singly-linked list head type
+ *
+ * As NS_LIST_HEAD() - see its documentation.
+ * ~~~
+ *     typedef NS_SLIST_HEAD(example_entry_t, link) example_queue_t;
+ * ~~~
+ */
+#define NS_SLIST_HEAD(entry_type, field) \
+    NS_SLIST_HEAD_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
+/** \brief Declare a singly-linked list head type for an incomplete entry type.
+ *
+ * As NS_LIST_HEAD_INCOMPLETE(), the link must be the first member of the entry.
+ */
+#define NS_SLIST_HEAD_INCOMPLETE(entry_type) \
+    NS_SLIST_HEAD_BY_OFFSET_(entry_type, 0)
+
+/// \privatesection
+/** \brief Internal macro defining a list head, given the offset to the link pointer
+ * The offset and type members are used by the ns_list.h internal macros.
+ */
+#define NS_SLIST_HEAD_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_slist_t slist; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    entry_type *type; \
+}
+
+/// \publicsection
+/** \brief The type for the link member in the user's entry structure.
+ *
+ * Users should not access this member directly - just pass its name to the
+ * list head macros.
+ */
+typedef struct ns_slist_link {
+    void *next;     ///< Pointer to next entry, or NULL if none
+} ns_slist_link_t;
+
+/** \brief Initialiser for an entry's link member
+ *
+ * As NS_LIST_LINK_INIT().
+ */
+#define NS_SLIST_LINK_INIT(name) \
+    NS_FUNNY_INTPTR_OK \
+    { NS_LIST_POISON } \
+    NS_FUNNY_INTPTR_RESTORE
+
+/** \hideinitializer \brief Initialise an entry's list link
+ *
+ * As ns_list_link_init().
+ *
+ * \param entry Pointer to an entry
+ * \param field The name of the link member to initialise
+ */
+#define ns_slist_link_init(entry, field) ns_slist_link_init_(&(entry)->field)
+
+/** \hideinitializer \brief Initialise a list
+ *
+ * As ns_list_init(). A zero-initialised list head is *not* valid.
+ *
+ * \param list Pointer to a NS_SLIST_HEAD() structure.
+ */
+#define ns_slist_init(list) ns_slist_init_(&(list)->slist)
+
+/** \brief Initialiser for an empty list
+ *
+ * As NS_LIST_INIT().
+ */
+#define NS_SLIST_INIT(name) { { NULL, &(name).slist.first_entry } }
+
+/** \brief Name and initialiser for an empty list
+ *
+ * As NS_LIST_NAME_INIT().
+ */
+#define NS_SLIST_NAME_INIT(name) name = NS_SLIST_INIT(name)
+
+/** \brief Define a list, and initialise to empty.
+ *
+ * Usage:
+ * ~~~
+ *     static NS_SLIST_DEFINE(my_list, entry_t, link);
+ * ~~~
+ */
+#define NS_SLIST_DEFINE(name, type, field) \
+    NS_SLIST_HEAD(type, field) NS_SLIST_NAME_INIT(name)
+
+/** \hideinitializer \brief Add an entry to the start of the list.
+ *
+ * \param list  `(list_t *)`           Pointer to list.
+ * \param entry `(entry_t * restrict)` Pointer to new entry to add.
+ */
+#define ns_slist_add_to_start(list, entry) \
+    ns_slist_add_to_start_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+
+/** \hideinitializer \brief Add an entry to the end of the list.
+ *
+ * \param list  `(list_t *)`           Pointer to list.
+ * \param entry `(entry_t * restrict)` Pointer to new entry to add.
+ */
+#define ns_slist_add_to_end(list, entry) \
+    ns_slist_add_to_end_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+
+/** \hideinitializer \brief Add an entry after a specified entry.
+ *
+ * \param list  `(list_t *)`           Pointer to list.
+ * \param after `(entry_t *)`          Existing entry after which to place the new entry.
+ * \param entry `(entry_t * restrict)` Pointer to new entry to add.
+ */
+#define ns_slist_add_after(list, after, entry) \
+    ns_slist_add_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, after), NS_LIST_TYPECHECK_(list, entry))
+
+/** \brief Check if a list is empty.
+ *
+ * \param list `(const list_t *)` Pointer to list.
+ *
+ * \return     `(bool)`           true if the list is empty.
+ */
+#define ns_slist_is_empty(list) ((bool) ((list)->slist.first_entry == NULL))
+
+/** \brief Get the first entry.
+ *
+ * \param list `(const list_t *)` Pointer to list.
+ *
+ * \return     `(entry_t *)`      Pointer to first entry.
+ * \return                        NULL if list is empty.
+ */
+#define ns_slist_get_first(list) NS_LIST_TYPECAST_(list, (list)->slist.first_entry)
+
+/** \hideinitializer \brief Get the next entry.
+ *
+ * \param list    `(const list_t *)`  Pointer to list.
+ * \param current `(const entry_t *)` Pointer to current entry.
+ *
+ * \return        `(entry_t *)`       Pointer to next entry.
+ * \return                            NULL if current entry is last.
+ */
+#define ns_slist_get_next(list, current) \
+    NS_LIST_TYPECAST_(list, ns_slist_get_next_(NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, current)))
+
+/** \hideinitializer \brief Get the last entry.
+ *
+ * \param list `(const list_t *)` Pointer to list.
+ *
+ * \return     `(entry_t *)`      Pointer to last entry.
+ * \return                        NULL if list is empty.
+ */
+#define ns_slist_get_last(list) \
+    NS_LIST_TYPECAST_(list, ns_slist_get_last_(&(list)->slist, NS_LIST_OFFSET_(list)))
+
+/** \hideinitializer \brief Remove the first entry.
+ *
+ * \param list `(list_t *)`  Pointer to list.
+ *
+ * \return     `(entry_t *)` Pointer to removed entry.
+ * \return                   NULL if list is empty.
+ */
+#define ns_slist_remove_first(list) \
+    NS_LIST_TYPECAST_(list, ns_slist_remove_first_(&(list)->slist, NS_LIST_OFFSET_(list)))
+
+/** \hideinitializer \brief Remove the entry after a specified entry.
+ *
+ * \param list  `(list_t *)`  Pointer to list.
+ * \param after `(entry_t *)` Existing entry, which must not be the last entry.
+ *
+ * \return      `(entry_t *)` Pointer to removed entry.
+ */
+#define ns_slist_remove_after(list, after) \
+    NS_LIST_TYPECAST_(list, ns_slist_remove_after_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, after)))
+
+/** \hideinitializer \brief Remove an entry.
+ *
+ * Unlike other operations, this is O(n), as the list is searched for the
+ * previous entry. Use ns_slist_remove_first() or ns_slist_remove_after()
+ * where possible.
+ *
+ * \param list  `(list_t *)`  Pointer to list.
+ * \param entry `(entry_t *)` Entry on list to be removed.
+ */
+#define ns_slist_remove(list, entry) \
+    ns_slist_remove_(&(list)->slist, NS_LIST_OFFSET_(list), NS_LIST_TYPECHECK_(list, entry))
+
+/** \hideinitializer \brief Concatenate two lists.
+ *
+ * Attach the entries on the source list to the end of the destination
+ * list, leaving the source list empty.
+ *
+ * \param dst `(list_t *)` Pointer to destination list.
+ * \param src `(list_t *)` Pointer to source list.
+ */
+#define ns_slist_concatenate(dst, src) \
+        (NS_PTR_MATCH_(dst, src, "concatenating different list types"), \
+        ns_slist_concatenate_(&(dst)->slist, &(src)->slist))
+
+/** \brief Iterate forwards over a list.
+ *
+ * As ns_list_foreach() - see its documentation. Deletion of the current
+ * entry is not permitted.
+ *
+ * \param type                    Entry type `([const] entry_t)`.
+ * \param e                       Name for iteration pointer to be defined
+ *                                inside the loop.
+ * \param list `(const list_t *)` Pointer to list - evaluated multiple times.
+ */
+#define ns_slist_foreach(type, e, list) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_slist_get_first(list)); \
+        e; e = NS_LIST_TYPECOERCE(type *, ns_slist_get_next(list, e)))
+
+/** \brief Iterate forwards over a list, where user may delete.
+ *
+ * As ns_slist_foreach(), but the current entry may be removed, or reused
+ * on another list, as its next pointer is recorded before running user code.
+ * ~~~
+ *     ns_slist_foreach_safe(my_entry_t, cur, &my_list)
+ *     {
+ *         ns_slist_remove_first(&my_list);
+ *         free(cur);
+ *     }
+ * ~~~
+ * \param type               Entry type `(entry_t)`.
+ * \param e                  Name for iteration pointer to be defined
+ *                           inside the loop.
+ * \param list `(list_t *)`  Pointer to list - evaluated multiple times.
+ */
+#define ns_slist_foreach_safe(type, e, list) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_slist_get_first(list)), *_next##e; \
+        e && (_next##e = NS_LIST_TYPECOERCE(type *, ns_slist_get_next(list, e)), true); e = _next##e)
+
+/** \hideinitializer \brief Count entries on a list
+ *
+ * Unlike other operations, this is O(n). Note: if list might contain over
+ * 65535 entries, this function **must not** be used to get the entry count.
+ *
+ * \param list `(const list_t *)` Pointer to list.
+ *
+ * \return     `(uint_fast16_t)`  Number of entries that are stored in list.
+ */
+#define ns_slist_count(list) ns_slist_count_(&(list)->slist, NS_LIST_OFFSET_(list))
+
+/** \privatesection
+ *  Internal functions - designed to be accessed using corresponding macros above
+ */
+NS_INLINE void ns_slist_init_(ns_slist_t *list);
+NS_INLINE void ns_slist_link_init_(ns_slist_link_t *link);
+NS_INLINE void ns_slist_add_to_start_(ns_slist_t *list, ns_list_offset_t link_offset, void *restrict entry);
+NS_INLINE void ns_slist_add_to_end_(ns_slist_t *list, ns_list_offset_t link_offset, void *restrict entry);
+NS_INLINE void ns_slist_add_after_(ns_slist_t *list, ns_list_offset_t link_offset, void *after, void *restrict entry);
+NS_INLINE void *ns_slist_get_next_(ns_list_offset_t link_offset, const void *current);
+NS_INLINE void *ns_slist_get_last_(const ns_slist_t *list, ns_list_offset_t link_offset);
+NS_INLINE void *ns_slist_remove_first_(ns_slist_t *list, ns_list_offset_t link_offset);
+NS_INLINE void *ns_slist_remove_after_(ns_slist_t *list, ns_list_offset_t link_offset, void *after);
+NS_INLINE void ns_slist_remove_(ns_slist_t *list, ns_list_offset_t link_offset, void *entry);
+NS_INLINE void ns_slist_concatenate_(ns_slist_t *dst, ns_slist_t *src);
+NS_INLINE uint_fast16_t ns_slist_count_(const ns_slist_t *list, ns_list_offset_t link_offset);
+
+/* Provide definitions, either for inlining, or for ns_slist.c */
+#if defined NS_ALLOW_INLINING || defined NS_SLIST_FN
+#ifndef NS_SLIST_FN
+#define NS_SLIST_FN NS_INLINE
+#endif
+
+/* Pointer to the link member in entry e */
+#define NS_SLIST_LINK_(e, offset) ((ns_slist_link_t *)((char *)(e) + offset))
+
+/* Lvalue of the next link pointer in entry e */
+#define NS_SLIST_NEXT_(e, offset) (NS_SLIST_LINK_(e, offset)->next)
+
+/* Convert a pointer to a link's next pointer back to the entry */
+#define NS_SLIST_ENTRY_(nextptr, offset) ((void *)((char *)(nextptr) - offset))
+
+NS_SLIST_FN void ns_slist_init_(ns_slist_t *list)
+{
+    list->first_entry = NULL;
+    list->last_nextptr = &list->first_entry;
+}
+
+NS_SLIST_FN void ns_slist_link_init_(ns_slist_link_t *link)
+{
+    NS_FUNNY_INTPTR_OK
+    link->next = NS_LIST_POISON;
+    NS_FUNNY_INTPTR_RESTORE
+}
+
+NS_SLIST_FN void ns_slist_add_to_start_(ns_slist_t *list, ns_list_offset_t offset, void *restrict entry)
+{
+    void *next;
+
+    NS_SLIST_NEXT_(entry, offset) = next = list->first_entry;
+    if (!next) {
+        list->last_nextptr = &NS_SLIST_NEXT_(entry, offset);
+    }
+    list->first_entry = entry;
+}
+
+NS_SLIST_FN void ns_slist_add_to_end_(ns_slist_t *list, ns_list_offset_t offset, void *restrict entry)
+{
+    NS_SLIST_NEXT_(entry, offset) = NULL;
+    *list->last_nextptr = entry;
+    list->last_nextptr = &NS_SLIST_NEXT_(entry, offset);
+}
+
+NS_SLIST_FN void ns_slist_add_after_(ns_slist_t *list, ns_list_offset_t offset, void *current, void *restrict entry)
+{
+    void *next;
+
+    NS_SLIST_NEXT_(entry, offset) = next = NS_SLIST_NEXT_(current, offset);
+    if (!next) {
+        list->last_nextptr = &NS_SLIST_NEXT_(entry, offset);
+    }
+    NS_SLIST_NEXT_(current, offset) = entry;
+}
+
+NS_SLIST_FN void *ns_slist_get_next_(ns_list_offset_t offset, const void *current)
+{
+    return NS_SLIST_NEXT_(current, offset);
+}
+
+NS_SLIST_FN void *ns_slist_get_last_(const ns_slist_t *list, ns_list_offset_t offset)
+{
+    if (!list->first_entry) {
+        return NULL;
+    }
+
+    // last_nextptr points to the next pointer of the last entry, which is
+    // the first member of the link
+    return NS_SLIST_ENTRY_(list->last_nextptr, offset);
+}
+
+NS_SLIST_FN void *ns_slist_remove_first_(ns_slist_t *list, ns_list_offset_t offset)
+{
+    void *removed;
+
+    removed = list->first_entry;
+    if (!removed) {
+        return NULL;
+    }
+
+    list->first_entry = NS_SLIST_NEXT_(removed, offset);
+    if (!list->first_entry) {
+        list->last_nextptr = &list->first_entry;
+    }
+
+    ns_slist_link_init_(NS_SLIST_LINK_(removed, offset));
+    return removed;
+}
+
+NS_SLIST_FN void *ns_slist_remove_after_(ns_slist_t *list, ns_list_offset_t offset, void *current)
+{
+    void *removed;
+    void *next;
+
+    removed = NS_SLIST_NEXT_(current, offset);
+    NS_SLIST_NEXT_(current, offset) = next = NS_SLIST_NEXT_(removed, offset);
+    if (!next) {
+        list->last_nextptr = &NS_SLIST_NEXT_(current, offset);
+    }
+
+    ns_slist_link_init_(NS_SLIST_LINK_(removed, offset));
+    return removed;
+}
+
+NS_SLIST_FN void ns_slist_remove_(ns_slist_t *list, ns_list_offset_t offset, void *removed)
+{
+    void **prev_nextptr = &list->first_entry;
+
+    while (*prev_nextptr != removed) {
+        prev_nextptr = &NS_SLIST_NEXT_(*prev_nextptr, offset);
+    }
+
+    *prev_nextptr = NS_SLIST_NEXT_(removed, offset);
+    if (!*prev_nextptr) {
+        list->last_nextptr = prev_nextptr;
+    }
+
+    ns_slist_link_init_(NS_SLIST_LINK_(removed, offset));
+}
+
+NS_SLIST_FN void ns_slist_concatenate_(ns_slist_t *dst, ns_slist_t *src)
+{
+    if (!src->first_entry) {
+        return;
+    }
+
+    *dst->last_nextptr = src->first_entry;
+    dst->last_nextptr = src->last_nextptr;
+
+    ns_slist_init_(src);
+}
+
+NS_SLIST_FN uint_fast16_t ns_slist_count_(const ns_slist_t *list, ns_list_offset_t offset)
+{
+    uint_fast16_t count = 0;
+
+    for (void *p = list->first_entry; p; p = NS_SLIST_NEXT_(p, offset)) {
+        count++;
+    }
+
+    return count;
+}
+#endif /* defined NS_ALLOW_INLINING || defined NS_SLIST_FN */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NS_SLIST_H_ */
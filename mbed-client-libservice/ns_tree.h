@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NS_TREE_H_
+#define NS_TREE_H_
+
+#include "ns_types.h"
+#include "ns_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \file
+ * \ingroup ns_list
+ * \brief Balanced binary tree support library.
+ *
+ * The ns_tree.h file provides an intrusive red-black tree, keeping entries
+ * sorted with O(log n) insertion, removal and search, and in-order iteration
+ * in both directions. It is intended for sorted collections that would
+ * otherwise be kept on an ns_list with a linear scan on insertion.
+ *
+ * Memory footprint is one pointer for the tree head, and three pointers and
+ * a byte in each entry.
+ *
+ * The tree does not store a comparison function; it is passed to the
+ * operations that need it. The comparison is `compare(key, entry)`, returning
+ * a negative value, zero or a positive value if the key is less than, equal
+ * to or greater than the entry. When inserting, the key is the new entry.
+ * Entries with equal keys are allowed, and are kept in insertion order.
+ *
+ * Example of an entry type that can be stored to this tree.
+ * ~~~
+ *     typedef struct example_timer
+ *     {
+ *         uint32_t       expiry;
+ *         ns_tree_link_t link;
+ *     }
+ *     example_timer_t;
+ *
+ *     static int example_timer_compare(const void *key, const void *entry)
+ *     {
+ *         uint32_t a = *(const uint32_t *) key;
+ *         uint32_t b = ((const example_timer_t *) entry)->expiry;
+ *         return a < b ? -1 : a > b;
+ *     }
+ *
+ *     static NS_TREE_DEFINE(my_timers, example_timer_t, link);
+ *
+ *     ns_tree_insert(&my_timers, timer, example_timer_compare);
+ *     example_timer_t *first = ns_tree_lower_bound(&my_timers, &now, example_timer_compare);
+ * ~~~
+ * In this example the key is the first member of the entry, so the same
+ * function can be used with a new entry or a pointer to an expiry time as the
+ * key. Otherwise a separate comparison function is needed for searching.
+ *
+ * NOTE: the link field SHALL NOT be accessed by the user.
+ *
+ * As with ns_list, the operations are implemented as type-checked macros. The
+ * macros do not evaluate any arguments more than once, unless documented.
+ *
+ * In macro documentation, `tree_t` refers to a tree type defined using
+ * NS_TREE_HEAD(), and `entry_t` to the entry type that was passed to it.
+ */
+
+/** \brief The type for the link member in the user's entry structure.
+ *
+ * Users should not access this member directly - just pass its name to the
+ * tree head macros.
+ */
+typedef struct ns_tree_link {
+    struct ns_tree_link *parent;    ///< Parent link, or NULL for root
+    struct ns_tree_link *left;      ///< Left child link, or NULL
+    struct ns_tree_link *right;     ///< Right child link, or NULL
+    uint8_t red;                    ///< Node colour
+} ns_tree_link_t;
+
+/** \brief Underlying generic tree head.
+ *
+ * Users should not use this type directly, but use the NS_TREE_HEAD() macro.
+ */
+typedef struct ns_tree {
+    ns_tree_link_t *root;   ///< Link of root entry, or NULL if tree is empty
+} ns_tree_t;
+
+/** \brief Comparison function type.
+ *
+ * \param key   Key to compare, or new entry when inserting.
+ * \param entry Entry on the tree.
+ *
+ * \return <0, 0 or >0 if key is less than, equal to or greater than entry.
+ */
+typedef int ns_tree_compare_t(const void *key, const void *entry);
+
+/** \brief Declare a tree head type
+ *
+ * As NS_LIST_HEAD() - see its documentation.
+ * ~~~
+ *     typedef NS_TREE_HEAD(example_timer_t, link) example_timer_tree_t;
+ * ~~~
+ */
+#define NS_TREE_HEAD(entry_type, field) \
+    NS_TREE_HEAD_BY_OFFSET_(entry_type, offsetof(entry_type, field))
+
+/// \privatesection
+/** \brief Internal macro defining a tree head, given the offset to the link
+ * The offset and type members are used by the ns_list.h internal macros.
+ */
+#define NS_TREE_HEAD_BY_OFFSET_(entry_type, link_offset) \
+union \
+{ \
+    ns_tree_t stree; \
+    NS_FUNNY_COMPARE_OK \
+    NS_STATIC_ASSERT(link_offset <= (ns_list_offset_t) -1, "link offset too large") \
+    NS_FUNNY_COMPARE_RESTORE \
+    char (*offset)[link_offset + 1]; \
+    entry_type *type; \
+}
+
+/// \publicsection
+/** \hideinitializer \brief Initialise a tree
+ *
+ * A tree head must be initialised using this function, NS_TREE_INIT() or
+ * NS_TREE_DEFINE() before use. If used on a tree containing existing entries,
+ * those entries will become detached.
+ *
+ * \param tree Pointer to a NS_TREE_HEAD() structure.
+ */
+#define ns_tree_init(tree) ((void) ((tree)->stree.root = NULL))
+
+/** \brief Initialiser for an empty tree */
+#define NS_TREE_INIT(name) { { NULL } }
+
+/** \brief Define a tree, and initialise to empty.
+ *
+ * Usage:
+ * ~~~
+ *     static NS_TREE_DEFINE(my_tree, entry_t, link);
+ * ~~~
+ */
+#define NS_TREE_DEFINE(name, type, field) \
+    NS_TREE_HEAD(type, field) name = NS_TREE_INIT(name)
+
+/** \hideinitializer \brief Insert an entry to the tree.
+ *
+ * O(log n). Entry is placed after existing entries with an equal key.
+ *
+ * \param tree    `(tree_t *)`            Pointer to tree.
+ * \param entry   `(entry_t * restrict)`  Pointer to new entry to insert.
+ * \param compare `(ns_tree_compare_t *)` Comparison function, called with the new entry as key.
+ */
+#define ns_tree_insert(tree, entry, compare) \
+    ns_tree_insert_(&(tree)->stree, NS_LIST_OFFSET_(tree), NS_LIST_TYPECHECK_(tree, entry), compare)
+
+/** \hideinitializer \brief Remove an entry.
+ *
+ * O(log n).
+ *
+ * \param tree  `(tree_t *)`  Pointer to tree.
+ * \param entry `(entry_t *)` Entry on tree to be removed.
+ */
+#define ns_tree_remove(tree, entry) \
+    ns_tree_remove_(&(tree)->stree, NS_LIST_OFFSET_(tree), NS_LIST_TYPECHECK_(tree, entry))
+
+/** \brief Check if a tree is empty.
+ *
+ * \param tree `(const tree_t *)` Pointer to tree.
+ *
+ * \return     `(bool)`           true if the tree is empty.
+ */
+#define ns_tree_is_empty(tree) ((bool) ((tree)->stree.root == NULL))
+
+/** \hideinitializer \brief Get the first (smallest) entry.
+ *
+ * \param tree `(const tree_t *)` Pointer to tree.
+ *
+ * \return     `(entry_t *)`      Pointer to first entry.
+ * \return                        NULL if tree is empty.
+ */
+#define ns_tree_get_first(tree) \
+    NS_LIST_TYPECAST_(tree, ns_tree_get_first_(&(tree)->stree, NS_LIST_OFFSET_(tree)))
+
+/** \hideinitializer \brief Get the last (largest) entry.
+ *
+ * \param tree `(const tree_t *)` Pointer to tree.
+ *
+ * \return     `(entry_t *)`      Pointer to last entry.
+ * \return                        NULL if tree is empty.
+ */
+#define ns_tree_get_last(tree) \
+    NS_LIST_TYPECAST_(tree, ns_tree_get_last_(&(tree)->stree, NS_LIST_OFFSET_(tree)))
+
+/** \hideinitializer \brief Get the next entry in order.
+ *
+ * \param tree    `(const tree_t *)`  Pointer to tree.
+ * \param current `(const entry_t *)` Pointer to current entry.
+ *
+ * \return        `(entry_t *)`       Pointer to next entry.
+ * \return                            NULL if current entry is last.
+ */
+#define ns_tree_get_next(tree, current) \
+    NS_LIST_TYPECAST_(tree, ns_tree_get_next_(NS_LIST_OFFSET_(tree), NS_LIST_TYPECHECK_(tree, current)))
+
+/** \hideinitializer \brief Get the previous entry in order.
+ *
+ * \param tree    `(const tree_t *)`  Pointer to tree.
+ * \param current `(const entry_t *)` Pointer to current entry.
+ *
+ * \return        `(entry_t *)`       Pointer to previous entry.
+ * \return                            NULL if current entry is first.
+ */
+#define ns_tree_get_previous(tree, current) \
+    NS_LIST_TYPECAST_(tree, ns_tree_get_previous_(NS_LIST_OFFSET_(tree), NS_LIST_TYPECHECK_(tree, current)))
+
+/** \hideinitializer \brief Find the first entry not less than a key.
+ *
+ * O(log n).
+ *
+ * \param tree    `(const tree_t *)`      Pointer to tree.
+ * \param key     `(const void *)`        Key passed to comparison function.
+ * \param compare `(ns_tree_compare_t *)` Comparison function.
+ *
+ * \return        `(entry_t *)`           Pointer to first entry that is greater than or equal to key.
+ * \return                                NULL if all entries are less than key.
+ */
+#define ns_tree_lower_bound(tree, key, compare) \
+    NS_LIST_TYPECAST_(tree, ns_tree_lower_bound_(&(tree)->stree, NS_LIST_OFFSET_(tree), key, compare))
+
+/** \hideinitializer \brief Find the first entry greater than a key.
+ *
+ * O(log n).
+ *
+ * \param tree    `(const tree_t *)`      Pointer to tree.
+ * \param key     `(const void *)`        Key passed to comparison function.
+ * \param compare `(ns_tree_compare_t *)` Comparison function.
+ *
+ * \return        `(entry_t *)`           Pointer to first entry that is greater than key.
+ * \return                                NULL if no entry is greater than key.
+ */
+#define ns_tree_upper_bound(tree, key, compare) \
+    NS_LIST_TYPECAST_(tree, ns_tree_upper_bound_(&(tree)->stree, NS_LIST_OFFSET_(tree), key, compare))
+
+/** \hideinitializer \brief Find an entry equal to a key.
+ *
+ * O(log n). If there are several equal entries, the first one is returned.
+ *
+ * \param tree    `(const tree_t *)`      Pointer to tree.
+ * \param key     `(const void *)`        Key passed to comparison function.
+ * \param compare `(ns_tree_compare_t *)` Comparison function.
+ *
+ * \return        `(entry_t *)`           Pointer to entry equal to key.
+ * \return                                NULL if not found.
+ */
+#define ns_tree_find(tree, key, compare) \
+    NS_LIST_TYPECAST_(tree, ns_tree_find_(&(tree)->stree, NS_LIST_OFFSET_(tree), key, compare))
+
+/** \brief Iterate over a tree in order.
+ *
+ * As ns_list_foreach() - see its documentation. Deletion of the current
+ * entry is not permitted.
+ *
+ * \param type                    Entry type `([const] entry_t)`.
+ * \param e                       Name for iteration pointer to be defined
+ *                                inside the loop.
+ * \param tree `(const tree_t *)` Pointer to tree - evaluated multiple times.
+ */
+#define ns_tree_foreach(type, e, tree) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_tree_get_first(tree)); \
+        e; e = NS_LIST_TYPECOERCE(type *, ns_tree_get_next(tree, e)))
+
+/** \brief Iterate over a tree in order, where user may delete.
+ *
+ * As ns_tree_foreach(), but deletion of current entry is permitted as its
+ * next entry is recorded before running user code.
+ *
+ * \param type               Entry type `(entry_t)`.
+ * \param e                  Name for iteration pointer to be defined
+ *                           inside the loop.
+ * \param tree `(tree_t *)`  Pointer to tree - evaluated multiple times.
+ */
+#define ns_tree_foreach_safe(type, e, tree) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_tree_get_first(tree)), *_next##e; \
+        e && (_next##e = NS_LIST_TYPECOERCE(type *, ns_tree_get_next(tree, e)), true); e = _next##e)
+
+/** \brief Iterate over a tree in reverse order.
+ *
+ * As ns_tree_foreach(), but going backwards.
+ */
+#define ns_tree_foreach_reverse(type, e, tree) \
+    for (type *e = NS_LIST_TYPECOERCE(type *, ns_tree_get_last(tree)); \
+        e; e = NS_LIST_TYPECOERCE(type *, ns_tree_get_previous(tree, e)))
+
+/** \privatesection
+ *  Internal functions - designed to be accessed using corresponding macros above
+ */
+void ns_tree_insert_(ns_tree_t *tree, ns_list_offset_t link_offset, void *restrict entry, ns_tree_compare_t *compare);
+void ns_tree_remove_(ns_tree_t *tree, ns_list_offset_t link_offset, void *entry);
+void *ns_tree_get_first_(const ns_tree_t *tree, ns_list_offset_t link_offset);
+void *ns_tree_get_last_(const ns_tree_t *tree, ns_list_offset_t link_offset);
+void *ns_tree_get_next_(ns_list_offset_t link_offset, const void *current);
+void *ns_tree_get_previous_(ns_list_offset_t link_offset, const void *current);
+void *ns_tree_lower_bound_(const ns_tree_t *tree, ns_list_offset_t link_offset, const void *key, ns_tree_compare_t *compare);
+void *ns_tree_upper_bound_(const ns_tree_t *tree, ns_list_offset_t link_offset, const void *key, ns_tree_compare_t *compare);
+void *ns_tree_find_(const ns_tree_t *tree, ns_list_offset_t link_offset, const void *key, ns_tree_compare_t *compare);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NS_TREE_H_ */
@@ -30,16 +30,111 @@ extern "C" {
 
 #if NSDYNMEM_TRACKER_ENABLED==1
 
+/*
+ * Sampling mode
+ *
+ * If sample_interval is set above one in configuration, tracker records on
+ * average one allocation per sample_interval allocated bytes instead of every
+ * allocation.
+ * Sample points are placed on the allocated byte stream with random distance
+ * (mean sample_interval) between them, and allocation is recorded if one or
+ * more sample points hit it. Each recorded allocation is weighted with the
+ * number of sample points that hit it, so memory and allocation count totals
+ * reported in ns_dyn_mem_tracker_lib_allocators_t are unbiased estimates of the
+ * real totals. Frees of allocations that were not sampled are ignored.
+ *
+ * sample_interval shall not be changed while there are tracked allocations.
+ */
+
+/*
+ * Call stack capture
+ *
+ * If stack_capture function is set in configuration, tracker captures up to
+ * stack_depth frames for each tracked allocation. Captured call stacks are
+ * interned to stacks array so that each memory block stores only a stack
+ * identifier. Allocations are grouped by caller address and call stack, so
+ * allocations made through shared helper functions are reported separately
+ * for each call stack. Stack frames can be read using
+ * ns_dyn_mem_tracker_lib_stack_frames_get().
+ */
+
+// Maximum number of captured call stack frames
+#define NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX 16
+
+/*
+ * Lifetime histograms
+ *
+ * Tracker stores the step (see ns_dyn_mem_tracker_lib_step()) on which memory
+ * block was allocated and on free updates the lifetime histogram of the caller.
+ * Histogram bucket 0 counts blocks freed on the same step, bucket n counts
+ * lifetimes of 2^(n-1) ... 2^n - 1 steps and the last bucket counts all longer
+ * lifetimes.
+ */
+
+// Number of lifetime histogram buckets
+#ifndef NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS
+#define NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS 12
+#endif
+
+/*
+ * Report export
+ *
+ * ns_dyn_mem_tracker_lib_export_collapsed() writes currently allocated memory
+ * grouped by caller and call stack in collapsed stack text format, one line
+ * for each group:
+ *
+ *     0x<outermost frame>;...;0x<innermost frame>;<function>:<line> <value>
+ *
+ * Value is either allocated bytes or allocation count (estimates in sampling
+ * mode). Output can be used directly with flame graph and differential flame
+ * graph tools; frame addresses are resolved to symbols by the host tooling.
+ */
+
+/*
+ * Extended memory block table
+ *
+ * Memory blocks of callers that are already in memory blocks array are stored
+ * to extended memory blocks array, which is an open addressing hash table with
+ * linear probing. If block_index_hash is not set in configuration, built-in
+ * ns_dyn_mem_tracker_lib_default_block_index_hash() is used. Freed entries are
+ * marked as deleted so that probe sequences are not broken. When live and
+ * deleted entries exceed 3/4 of the table, the table is grown using
+ * ext_alloc_mem_blocks (or, if mostly deleted entries, only cleaned) and all
+ * entries are rehashed in place. Lookup and probe counts are updated to
+ * configuration for monitoring the table performance.
+ */
+
+/*
+ * Leak detection
+ *
+ * ns_dyn_mem_tracker_lib_leak_snapshot_update() stores a snapshot of allocated
+ * memory of each caller. It is intended to be called periodically, e.g. from a
+ * timer in soak tests. Each caller keeps count of consecutive snapshots on
+ * which its allocated memory was larger than on the previous snapshot; when
+ * allocated memory does not grow the count is reset. Snapshot updates handle
+ * only the caller entries of memory blocks array, not every allocated block.
+ * ns_dyn_mem_tracker_lib_leak_allocators_update() lists callers whose allocated
+ * memory has grown on at least leak_snapshots_count consecutive snapshots,
+ * largest growth first, and returns the number of such callers.
+ */
+
 // Memory block structure with caller information
 typedef struct ns_dyn_mem_tracker_lib_mem_blocks_s {
     void *block;                   /**< Allocated memory block */
     void *caller_addr;             /**< Caller address */
     uint32_t size;                 /**< Allocation size */
     uint32_t total_size;           /**< Total allocation size for all allocations */
-    uint32_t lifetime;             /**< Memory block lifetime in steps (e.g. seconds) */
+    uint32_t alloc_step;           /**< Step when memory block was allocated */
+    uint32_t change_step;          /**< Step when caller allocated or freed memory last time */
     uint32_t ref_count;            /**< Reference count */
     const char *function;          /**< Caller function */
     uint16_t line;                 /**< Caller line in module */
+    uint32_t alloc_count_scaled;   /**< Estimated number of allocations for all allocations (1/256 units, sampling mode) */
+    uint16_t samples;              /**< Number of sample points that hit the allocation (1 if sampling is not used) */
+    uint16_t stack_id;             /**< Call stack identifier, 0 if no call stack */
+    uint32_t leak_snapshot_size;   /**< Total allocation size on last leak snapshot */
+    uint32_t leak_start_size;      /**< Total allocation size on leak snapshot before growth started */
+    uint16_t leak_growth_count;    /**< Number of consecutive leak snapshots on which total allocation size has grown */
     bool permanent : 1;            /**< Permanent memory block */
     bool permanent_printed : 1;    /**< Permanent memory block printed */
 } ns_dyn_mem_tracker_lib_mem_blocks_t;
@@ -49,24 +144,66 @@ typedef struct ns_dyn_mem_tracker_lib_mem_blocks_ext_s {
     void *block;                   /**< Allocated memory block */
     void *caller_addr;             /**< Caller address */
     uint32_t size;                 /**< Allocation size */
+    uint32_t alloc_step;           /**< Step when memory block was allocated */
+    uint16_t samples;              /**< Number of sample points that hit the allocation (1 if sampling is not used) */
+    uint16_t stack_id;             /**< Call stack identifier, 0 if no call stack */
 } ns_dyn_mem_tracker_lib_mem_blocks_ext_t;
 
+// Interned call stack structure
+typedef struct ns_dyn_mem_tracker_lib_stack_s {
+    uint32_t hash;                 /**< Hash of the call stack frames */
+    uint32_t ref_count;            /**< Number of tracked allocations with the call stack */
+    uint8_t depth;                 /**< Number of frames, 0 if entry is not used */
+} ns_dyn_mem_tracker_lib_stack_t;
+
 // Allocator information structure
 typedef struct ns_dyn_mem_tracker_lib_allocators_s {
     void *caller_addr;             /**< Caller address */
-    uint32_t alloc_count;          /**< Number of allocations */
-    uint32_t total_memory;         /**< Total memory used by allocations */
-    uint32_t min_lifetime;         /**< Shortest lifetime among the allocations */
+    uint32_t alloc_count;          /**< Number of allocations (estimated in sampling mode) */
+    uint32_t total_memory;         /**< Total memory used by allocations (estimated in sampling mode) */
+    uint32_t sampled_count;        /**< Number of tracked (sampled) allocations */
+    uint32_t min_lifetime;         /**< Steps since caller allocated or freed memory last time */
     const char *function;          /**< Function name string */
     uint16_t line;                 /**< Module line */
+    uint16_t stack_id;             /**< Call stack identifier, 0 if no call stack */
 } ns_dyn_mem_tracker_lib_allocators_t;
 
+// Leaking allocator information structure
+typedef struct ns_dyn_mem_tracker_lib_leak_allocators_s {
+    void *caller_addr;             /**< Caller address */
+    uint32_t alloc_count;          /**< Number of allocations (estimated in sampling mode) */
+    uint32_t total_memory;         /**< Total memory used by allocations (estimated in sampling mode) */
+    uint32_t growth;               /**< Memory growth during consecutive growing snapshots */
+    uint16_t growth_count;         /**< Number of consecutive snapshots on which memory has grown */
+    const char *function;          /**< Function name string */
+    uint16_t line;                 /**< Module line */
+    uint16_t stack_id;             /**< Call stack identifier, 0 if no call stack */
+} ns_dyn_mem_tracker_lib_leak_allocators_t;
+
+// Caller lifetime histogram structure
+typedef struct ns_dyn_mem_tracker_lib_lifetime_histogram_s {
+    void *caller_addr;             /**< Caller address, NULL if entry is not used */
+    const char *function;          /**< Function name string */
+    uint32_t buckets[NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS];  /**< Number of freed blocks on each lifetime bucket */
+    uint16_t line;                 /**< Module line */
+} ns_dyn_mem_tracker_lib_lifetime_histogram_t;
+
 // Memory block array allocator / array size increase allocator
 typedef ns_dyn_mem_tracker_lib_mem_blocks_t *ns_dyn_mem_tracker_lib_alloc_mem_blocks(ns_dyn_mem_tracker_lib_mem_blocks_t *blocks, uint16_t *mem_blocks_count);
 // Extended memory block array allocator / array size increase allocator
 typedef ns_dyn_mem_tracker_lib_mem_blocks_ext_t *ns_dyn_mem_tracker_lib_alloc_mem_blocks_ext(ns_dyn_mem_tracker_lib_mem_blocks_ext_t *blocks, uint32_t *mem_blocks_count);
 // Extended memory block array index hash function to get memory block (allocation/search start) index from block address
 typedef uint32_t ns_dyn_mem_tracker_lib_mem_block_index_hash(void *block, uint32_t ext_mem_blocks_count);
+// Call stack capture function, stores up to max_depth return addresses (innermost first) to frames and returns number of stored frames
+typedef uint8_t ns_dyn_mem_tracker_lib_stack_capture(void **frames, uint8_t max_depth);
+// Report writer function, returns 0 on success or <0 to stop the export
+typedef int8_t ns_dyn_mem_tracker_lib_writer(const char *data, uint16_t data_len, void *context);
+
+// Exported value
+typedef enum {
+    NS_DYN_MEM_TRACKER_LIB_EXPORT_BYTES,      /**< Allocated bytes */
+    NS_DYN_MEM_TRACKER_LIB_EXPORT_COUNT       /**< Number of allocations */
+} ns_dyn_mem_tracker_lib_export_value_t;
 
 typedef struct ns_dyn_mem_tracker_lib_conf_s {
     ns_dyn_mem_tracker_lib_mem_blocks_t *mem_blocks;                    /**< Memory blocks array, if NULL calls allocator on init */
@@ -87,6 +224,27 @@ typedef struct ns_dyn_mem_tracker_lib_conf_s {
     uint16_t to_permanent_allocators_count;                             /**< To permanent allocators array count */
     uint16_t max_snap_shot_allocators_count;                            /**< Snap shot of maximum memory used by allocators array count */
     uint16_t to_permanent_steps_count;                                  /**< How many steps before moving block to permanent allocators list */
+    uint32_t sample_interval;                                           /**< Average bytes allocated between sampled allocations, 0 or 1 tracks all allocations */
+    uint32_t sample_bytes_left;                                         /**< Bytes left until next sample point (internal) */
+    uint32_t sample_seed;                                               /**< Sample interval random generator state (internal) */
+    ns_dyn_mem_tracker_lib_stack_capture *stack_capture;                /**< Call stack capture function, if NULL call stacks are not captured */
+    ns_dyn_mem_tracker_lib_stack_t *stacks;                             /**< Interned call stacks array */
+    void **stack_frames;                                                /**< Call stack frames array, stacks_count * stack_depth entries */
+    uint16_t stacks_count;                                              /**< Number of entries in interned call stacks array */
+    uint8_t stack_depth;                                                /**< Maximum number of captured frames (up to NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX) */
+    ns_dyn_mem_tracker_lib_lifetime_histogram_t *lifetime_histograms;   /**< Caller lifetime histograms array, can be NULL */
+    uint16_t lifetime_histograms_count;                                 /**< Caller lifetime histograms array count */
+    uint32_t current_step;                                              /**< Current step, incremented by ns_dyn_mem_tracker_lib_step() */
+    uint32_t ext_mem_blocks_used;                                       /**< Number of live entries in extended memory blocks array (internal) */
+    uint32_t ext_mem_blocks_deleted;                                    /**< Number of deleted entries in extended memory blocks array (internal) */
+    uint32_t ext_lookups;                                               /**< Number of extended memory blocks array lookups */
+    uint32_t ext_probes;                                                /**< Number of entries probed on extended memory blocks array lookups */
+    uint32_t ext_max_probe_length;                                      /**< Longest probe sequence on extended memory blocks array lookup */
+    uint32_t ext_rehash_count;                                          /**< Number of extended memory blocks array rehashes */
+    ns_dyn_mem_tracker_lib_leak_allocators_t *leak_allocators;          /**< Leaking allocators array, can be NULL */
+    uint16_t leak_allocators_count;                                     /**< Leaking allocators array count */
+    uint16_t leak_snapshots_count;                                      /**< How many consecutive growing snapshots before allocator is listed as leaking */
+    uint32_t leak_snapshot_count;                                       /**< Number of leak snapshots taken */
 } ns_dyn_mem_tracker_lib_conf_t;
 
 int8_t ns_dyn_mem_tracker_lib_alloc(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, const char *function, uint32_t line, void *block, uint32_t alloc_size);
@@ -94,6 +252,11 @@ int8_t ns_dyn_mem_tracker_lib_free(ns_dyn_mem_tracker_lib_conf_t *conf, void *ca
 void ns_dyn_mem_tracker_lib_step(ns_dyn_mem_tracker_lib_conf_t *conf);
 int8_t ns_dyn_mem_tracker_lib_allocator_lists_update(ns_dyn_mem_tracker_lib_conf_t *conf);
 void ns_dyn_mem_tracker_lib_max_snap_shot_update(ns_dyn_mem_tracker_lib_conf_t *conf);
+void ns_dyn_mem_tracker_lib_leak_snapshot_update(ns_dyn_mem_tracker_lib_conf_t *conf);
+uint16_t ns_dyn_mem_tracker_lib_leak_allocators_update(ns_dyn_mem_tracker_lib_conf_t *conf);
+void **ns_dyn_mem_tracker_lib_stack_frames_get(ns_dyn_mem_tracker_lib_conf_t *conf, uint16_t stack_id, uint8_t *depth);
+int8_t ns_dyn_mem_tracker_lib_export_collapsed(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_export_value_t value, ns_dyn_mem_tracker_lib_writer *writer, void *context);
+uint32_t ns_dyn_mem_tracker_lib_default_block_index_hash(void *block, uint32_t ext_mem_blocks_count);
 
 #endif
 
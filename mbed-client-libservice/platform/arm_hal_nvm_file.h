@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * File-backed implementation of Nanostack NVM API (arm_hal_nvm.h) for POSIX hosts.
+ *
+ * Each key is stored in its own file in a configured directory. Writes replace the
+ * key file atomically (write and sync a temporary file, and rename it), platform_nvm_flush
+ * makes the renames and deletes durable.
+ *
+ * Operations are executed in the order they were requested by a worker thread.
+ * Callbacks are not called from the worker thread, but from platform_nvm_file_dispatch
+ * which must be called by the application thread, for example from its event loop when
+ * notified that operations have been completed. NVM API functions must be called from
+ * the application thread only.
+ */
+
+#ifndef _PLATFORM_NVM_FILE_H_
+#define _PLATFORM_NVM_FILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ns_types.h"
+#include "platform/arm_hal_nvm.h"
+
+/** \brief Completion notification type.
+ *
+ * Called from the worker thread when an operation has been completed. Application should
+ * call platform_nvm_file_dispatch from its own thread, notification must not call it directly.
+ */
+typedef void (platform_nvm_file_notify)(void);
+
+/** \brief Configure NVM storage. Must be called before platform_nvm_init.
+ *
+ * \param directory directory where keys are stored, created by platform_nvm_init if it does not exist.
+ *                  If not configured, "nvm" in the current working directory is used.
+ * \param notify function to be called from the worker thread when an operation has been completed, can be NULL.
+ *
+ * \return PLATFORM_NVM_OK if configuration was changed.
+ * \return PLATFORM_NVM_ERROR if NVM is initialized or directory name is too long.
+ */
+platform_nvm_status platform_nvm_file_configure(const char *directory, platform_nvm_file_notify *notify);
+
+/** \brief Call callbacks of completed operations.
+ *
+ * Callbacks are called in the order the operations were requested. Callbacks can request new operations.
+ *
+ * \return number of callbacks called.
+ */
+int platform_nvm_file_dispatch(void);
+
+/** \brief Wait until an operation has been completed.
+ *
+ * Returns immediately if there are completed operations waiting for dispatch or no operations in progress.
+ */
+void platform_nvm_file_wait(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _PLATFORM_NVM_FILE_H_ */
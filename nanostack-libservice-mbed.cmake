@@ -26,7 +26,12 @@ target_include_directories(mbed-nanostack-libservice
 target_sources(mbed-nanostack-libservice
     INTERFACE
         source/IPv6_fcf_lib/ip_fsc.c
+        source/libList/ns_hash.c
         source/libList/ns_list.c
+        source/libList/ns_mpsc.c
+        source/libList/ns_pqueue.c
+        source/libList/ns_slist.c
+        source/libList/ns_tree.c
         source/libip4string/ip4tos.c
         source/libip4string/stoip4.c
         source/libip6string/stoip6.c
@@ -31,7 +31,12 @@ set(LS_SOURCES
     source/libBits/common_functions.c
     source/libip6string/ip6tos.c
     source/libip6string/stoip6.c
+    source/libList/ns_hash.c
     source/libList/ns_list.c
+    source/libList/ns_mpsc.c
+    source/libList/ns_pqueue.c
+    source/libList/ns_slist.c
+    source/libList/ns_tree.c
     source/nsdynmemLIB/nsdynmemLIB.c
     source/nsdynmemtracker/nsdynmem_tracker_lib.c
     source/nvmHelper/ns_nvm_helper.c)
@@ -47,6 +52,16 @@ target_include_directories(nanostack-libservice PUBLIC ${nanostack-libservice_SO
 target_include_directories(nanostack-libservice PUBLIC ${nanostack-libservice_SOURCE_DIR}/mbed-client-libservice)
 target_include_directories(nanostack-libservice PUBLIC ${nanostack-libservice_SOURCE_DIR}/mbed-client-libservice/platform)
 
+# File-backed platform NVM for POSIX hosts
+if (UNIX)
+    find_package(Threads REQUIRED)
+
+    add_library(nanostack-libservice-nvm-file
+        source/platform/linux/arm_hal_nvm_file.c)
+
+    target_link_libraries(nanostack-libservice-nvm-file PUBLIC nanostack-libservice Threads::Threads)
+endif ()
+
 if (test_all OR ${CMAKE_PROJECT_NAME} STREQUAL "nanostack-libservice")
     # Tests after this line
     enable_testing()
@@ -128,8 +143,97 @@ if (test_all OR ${CMAKE_PROJECT_NAME} STREQUAL "nanostack-libservice")
         gtest_main
     )
 
+    add_executable(nsdynmem_tracker_test
+        source/nsdynmemtracker/nsdynmem_tracker_lib.c
+        test/nsdynmemtracker/nsdynmem_tracker_test.cpp
+        test/stubs/platform_critical.c
+    )
+
+    target_compile_definitions(nsdynmem_tracker_test PRIVATE NSDYNMEM_TRACKER_ENABLED=1)
+
+    target_include_directories(nsdynmem_tracker_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice)
+    target_include_directories(nsdynmem_tracker_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice/platform)
+
+    target_link_libraries(
+        nsdynmem_tracker_test
+        gtest_main
+    )
+
+    # Benchmark, not run as part of the tests
+    add_executable(nsdynmem_tracker_bench
+        source/nsdynmemLIB/nsdynmemLIB.c
+        source/nsdynmemtracker/nsdynmem_tracker_lib.c
+        test/nsdynmemtracker/nsdynmem_tracker_bench.cpp
+        test/stubs/platform_critical.c
+        test/stubs/ns_list_stub.c
+    )
+
+    target_compile_definitions(nsdynmem_tracker_bench PRIVATE NSDYNMEM_TRACKER_ENABLED=1)
+
+    target_include_directories(nsdynmem_tracker_bench PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice)
+    target_include_directories(nsdynmem_tracker_bench PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice/platform)
+
+    add_executable(nslist_test
+        source/libList/ns_hash.c
+        source/libList/ns_list.c
+        source/libList/ns_mpsc.c
+        source/libList/ns_pqueue.c
+        source/libList/ns_slist.c
+        source/libList/ns_tree.c
+        source/nsdynmemLIB/nsdynmemLIB.c
+        test/nslist/nshash_test.cpp
+        test/nslist/nslist_test.cpp
+        test/nslist/nslisthpp_test.cpp
+        test/nslist/nsmpsc_test.cpp
+        test/nslist/nspqueue_test.cpp
+        test/nslist/nsslist_test.cpp
+        test/nslist/nstree_test.cpp
+        test/stubs/platform_critical.c
+    )
+
+    target_include_directories(nslist_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice)
+    target_include_directories(nslist_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice/platform)
+
+    target_link_libraries(
+        nslist_test
+        gtest_main
+    )
+
+    add_executable(nvmfile_test
+        source/platform/linux/arm_hal_nvm_file.c
+        test/nvmfile/nvmfile_test.cpp
+        test/stubs/ns_list_stub.c
+    )
+
+    target_include_directories(nvmfile_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice)
+    target_include_directories(nvmfile_test PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice/platform)
+
+    target_link_libraries(
+        nvmfile_test
+        gtest_main
+        Threads::Threads
+    )
+
+    # Benchmark, not run as part of the tests
+    add_executable(nsnvmhelper_bench
+        source/nsdynmemLIB/nsdynmemLIB.c
+        source/nvmHelper/ns_nvm_helper.c
+        source/platform/linux/arm_hal_nvm_file.c
+        test/nsnvmhelper/nsnvmhelper_bench.cpp
+        test/stubs/platform_critical.c
+        test/stubs/ns_list_stub.c
+    )
+
+    target_include_directories(nsnvmhelper_bench PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice)
+    target_include_directories(nsnvmhelper_bench PUBLIC ${CMAKE_CURRENT_SOURCE_DIR}/mbed-client-libservice/platform)
+
+    target_link_libraries(
+        nsnvmhelper_bench
+        Threads::Threads
+    )
+
     # GTest framework requires C++ version 11
-    set_target_properties(dynmem_test ip6tos_test stoip6_test nsnvmhelper_test
+    set_target_properties(dynmem_test ip6tos_test stoip6_test nsnvmhelper_test nsdynmem_tracker_test nsdynmem_tracker_bench nslist_test nvmfile_test nsnvmhelper_bench
     PROPERTIES
         CXX_STANDARD 11
     )
@@ -139,6 +243,9 @@ if (test_all OR ${CMAKE_PROJECT_NAME} STREQUAL "nanostack-libservice")
     gtest_discover_tests(stoip6_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR stoip6)
     gtest_discover_tests(dynmem_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR nsdynmem)
     gtest_discover_tests(nsnvmhelper_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR nvmhelper)
+    gtest_discover_tests(nsdynmem_tracker_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR nsdynmemtracker)
+    gtest_discover_tests(nslist_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR nslist)
+    gtest_discover_tests(nvmfile_test EXTRA_ARGS --gtest_output=xml: XML_OUTPUT_DIR nvmfile)
 
     if (enable_coverage_data AND ${CMAKE_PROJECT_NAME} STREQUAL "nanostack-libservice")
         file(MAKE_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}/html")
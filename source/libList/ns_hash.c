@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Chained hash table with incremental growth.
+ *
+ * When the table grows, the bucket array is doubled. Old bucket i maps to
+ * new buckets i and i + old_bucket_count, so old buckets are moved in order,
+ * and new buckets are initialised only when their old bucket is moved. Until
+ * then an entry belongs to its old bucket, so each entry has exactly one
+ * bucket, determined by its hash value and the number of moved buckets.
+ */
+#include "ns_hash.h"
+#include "nsdynmemLIB.h"
+
+/* Number of buckets allocated on first insertion */
+#ifndef NS_HASH_MIN_BUCKETS
+#define NS_HASH_MIN_BUCKETS 8
+#endif
+
+/* Average number of entries per bucket before the table is grown */
+#ifndef NS_HASH_MAX_LOAD
+#define NS_HASH_MAX_LOAD 2
+#endif
+
+/* Number of old buckets moved on each insertion while growing */
+#ifndef NS_HASH_MOVE_STEP
+#define NS_HASH_MOVE_STEP 2
+#endif
+
+#define NS_HASH_MAX_BUCKETS 0x8000
+
+/* Pointer to the link member in entry e */
+#define NS_HASH_LINK_(e, offset) ((ns_hash_link_t *)((char *)(e) + offset))
+
+/* Convert a link pointer back to the entry, NULL stays NULL */
+#define NS_HASH_ENTRY_(link, offset) ((link) ? (void *)((char *)(link) - offset) : NULL)
+
+uint32_t ns_hash_bytes(const void *data, uint_fast16_t len)
+{
+    const uint8_t *ptr = data;
+    uint32_t hash = 2166136261U;
+
+    while (len--) {
+        hash ^= *ptr++;
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+void *ns_hash_mem_book_alloc(void *context, size_t size)
+{
+    if (!context) {
+        return ns_dyn_mem_alloc(size);
+    }
+    return ns_mem_alloc(context, size);
+}
+
+void ns_hash_mem_book_free(void *context, void *ptr)
+{
+    if (!context) {
+        ns_dyn_mem_free(ptr);
+    } else {
+        ns_mem_free(context, ptr);
+    }
+}
+
+static bool ns_hash_old_bucket_is_valid(const ns_hash_t *table, uint_fast16_t index)
+{
+    return table->old_buckets && index >= table->moved_count;
+}
+
+static bool ns_hash_bucket_is_valid(const ns_hash_t *table, uint_fast16_t index)
+{
+    // while growing, new buckets are valid after their old bucket has been moved
+    return !table->old_buckets || (index & (table->old_bucket_count - 1)) < table->moved_count;
+}
+
+static ns_hash_link_t **ns_hash_bucket(const ns_hash_t *table, uint32_t hash)
+{
+    if (table->old_buckets) {
+        uint_fast16_t index = hash & (table->old_bucket_count - 1);
+        if (ns_hash_old_bucket_is_valid(table, index)) {
+            return &table->old_buckets[index];
+        }
+    }
+    return &table->buckets[hash & (table->bucket_count - 1)];
+}
+
+static void ns_hash_move_buckets(ns_hash_t *table)
+{
+    for (int i = 0; i < NS_HASH_MOVE_STEP && table->moved_count < table->old_bucket_count; i++) {
+        uint_fast16_t index = table->moved_count++;
+        ns_hash_link_t *link = table->old_buckets[index];
+
+        table->buckets[index] = NULL;
+        table->buckets[index + table->old_bucket_count] = NULL;
+        while (link) {
+            ns_hash_link_t *next = link->next;
+            ns_hash_link_t **bucket = &table->buckets[link->hash & (table->bucket_count - 1)];
+            link->next = *bucket;
+            *bucket = link;
+            link = next;
+        }
+    }
+
+    if (table->moved_count == table->old_bucket_count) {
+        table->allocator->free(table->allocator->context, table->old_buckets);
+        table->old_buckets = NULL;
+        table->old_bucket_count = 0;
+        table->moved_count = 0;
+    }
+}
+
+static void ns_hash_grow(ns_hash_t *table)
+{
+    if (table->bucket_count >= NS_HASH_MAX_BUCKETS) {
+        return;
+    }
+
+    ns_hash_link_t **buckets = table->allocator->alloc(table->allocator->context, 2 * table->bucket_count * sizeof(ns_hash_link_t *));
+    if (!buckets) {
+        // continue with longer chains
+        return;
+    }
+
+    table->old_buckets = table->buckets;
+    table->old_bucket_count = table->bucket_count;
+    table->moved_count = 0;
+    table->buckets = buckets;
+    table->bucket_count *= 2;
+}
+
+void ns_hash_init_(ns_hash_t *table, const ns_hash_allocator_t *allocator)
+{
+    table->allocator = allocator;
+    table->buckets = NULL;
+    table->old_buckets = NULL;
+    table->bucket_count = 0;
+    table->old_bucket_count = 0;
+    table->moved_count = 0;
+    table->count = 0;
+}
+
+void ns_hash_deinit_(ns_hash_t *table)
+{
+    if (table->buckets) {
+        table->allocator->free(table->allocator->context, table->buckets);
+    }
+    if (table->old_buckets) {
+        table->allocator->free(table->allocator->context, table->old_buckets);
+    }
+    ns_hash_init_(table, table->allocator);
+}
+
+int ns_hash_insert_(ns_hash_t *table, ns_list_offset_t offset, void *restrict entry, uint32_t hash)
+{
+    ns_hash_link_t *link = NS_HASH_LINK_(entry, offset);
+
+    if (!table->buckets) {
+        table->buckets = table->allocator->alloc(table->allocator->context, NS_HASH_MIN_BUCKETS * sizeof(ns_hash_link_t *));
+        if (!table->buckets) {
+            return -1;
+        }
+        for (uint_fast16_t i = 0; i < NS_HASH_MIN_BUCKETS; i++) {
+            table->buckets[i] = NULL;
+        }
+        table->bucket_count = NS_HASH_MIN_BUCKETS;
+    } else if (table->old_buckets) {
+        ns_hash_move_buckets(table);
+    } else if (table->count >= (uint_fast32_t) table->bucket_count * NS_HASH_MAX_LOAD) {
+        ns_hash_grow(table);
+        if (table->old_buckets) {
+            ns_hash_move_buckets(table);
+        }
+    }
+
+    ns_hash_link_t **bucket = ns_hash_bucket(table, hash);
+    link->hash = hash;
+    link->next = *bucket;
+    *bucket = link;
+    table->count++;
+
+    return 0;
+}
+
+void ns_hash_remove_(ns_hash_t *table, ns_list_offset_t offset, void *entry)
+{
+    ns_hash_link_t *link = NS_HASH_LINK_(entry, offset);
+    ns_hash_link_t **prev_nextptr = ns_hash_bucket(table, link->hash);
+
+    while (*prev_nextptr != link) {
+        prev_nextptr = &(*prev_nextptr)->next;
+    }
+    *prev_nextptr = link->next;
+    table->count--;
+
+    NS_FUNNY_INTPTR_OK
+    link->next = (ns_hash_link_t *) NS_LIST_POISON;
+    NS_FUNNY_INTPTR_RESTORE
+}
+
+void *ns_hash_find_(const ns_hash_t *table, ns_list_offset_t offset, uint32_t hash, const void *key, ns_hash_match_t *match)
+{
+    if (!table->buckets) {
+        return NULL;
+    }
+
+    for (ns_hash_link_t *link = *ns_hash_bucket(table, hash); link; link = link->next) {
+        if (link->hash == hash && match(key, NS_HASH_ENTRY_(link, offset))) {
+            return NS_HASH_ENTRY_(link, offset);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Iteration order is the remaining old buckets, then the valid new buckets.
+ * Find the first non-empty bucket starting from the given one.
+ */
+static ns_hash_link_t *ns_hash_bucket_scan(const ns_hash_t *table, bool old, uint_fast16_t index)
+{
+    if (old) {
+        for (; index < table->old_bucket_count; index++) {
+            if (table->old_buckets[index]) {
+                return table->old_buckets[index];
+            }
+        }
+        index = 0;
+    }
+    for (; index < table->bucket_count; index++) {
+        if (ns_hash_bucket_is_valid(table, index) && table->buckets[index]) {
+            return table->buckets[index];
+        }
+    }
+    return NULL;
+}
+
+void *ns_hash_get_first_(const ns_hash_t *table, ns_list_offset_t offset)
+{
+    ns_hash_link_t *link;
+
+    if (table->old_buckets) {
+        link = ns_hash_bucket_scan(table, true, table->moved_count);
+    } else {
+        link = ns_hash_bucket_scan(table, false, 0);
+    }
+    return NS_HASH_ENTRY_(link, offset);
+}
+
+void *ns_hash_get_next_(const ns_hash_t *table, ns_list_offset_t offset, const void *current)
+{
+    const ns_hash_link_t *link = NS_HASH_LINK_(current, offset);
+
+    if (link->next) {
+        return NS_HASH_ENTRY_(link->next, offset);
+    }
+
+    if (table->old_buckets) {
+        uint_fast16_t index = link->hash & (table->old_bucket_count - 1);
+        if (ns_hash_old_bucket_is_valid(table, index)) {
+            return NS_HASH_ENTRY_(ns_hash_bucket_scan(table, true, index + 1), offset);
+        }
+    }
+    return NS_HASH_ENTRY_(ns_hash_bucket_scan(table, false, (link->hash & (table->bucket_count - 1)) + 1), offset);
+}
@@ -16,9 +16,118 @@
  */
 
 /*
- * All functions can be inlined, and definitions are in ns_list.h.
+ * Most functions can be inlined, and definitions are in ns_list.h.
  * Define NS_LIST_FN before including it to generate external definitions.
+ * Sorting and merging are not inlined, and are defined here.
  */
 #define NS_LIST_FN extern
 
 #include "ns_list.h"
+
+/* Link next entry e after tail, returning new tail */
+#define NS_LIST_APPEND_(tail, e, offset) \
+    (*(tail) = (e), NS_LIST_PREV_(e, offset) = (tail), &NS_LIST_NEXT_(e, offset))
+
+/*
+ * Simon Tatham's bottom-up merge sort: in each pass, merge adjacent runs of
+ * insize entries, doubling insize until a pass does a single merge. Only
+ * next pointers are maintained while sorting; prev pointers are fixed at
+ * the end.
+ */
+void ns_list_sort_(ns_list_t *list, ns_list_offset_t offset, ns_list_compare_t *compare)
+{
+    void *head = list->first_entry;
+    uint_fast16_t merges;
+
+    if (!head) {
+        return;
+    }
+
+    for (uint_fast32_t insize = 1; ; insize *= 2) {
+        void *p = head;
+        void **tailp = &head;
+        merges = 0;
+
+        while (p) {
+            void *q = p;
+            uint_fast32_t psize = 0;
+            uint_fast32_t qsize = insize;
+
+            merges++;
+            while (psize < insize && q) {
+                psize++;
+                q = NS_LIST_NEXT_(q, offset);
+            }
+
+            while (psize > 0 || (qsize > 0 && q)) {
+                void *e;
+                // take from p on ties, to keep the sort stable
+                if (psize > 0 && (qsize == 0 || !q || compare(q, p) >= 0)) {
+                    e = p;
+                    p = NS_LIST_NEXT_(p, offset);
+                    psize--;
+                } else {
+                    e = q;
+                    q = NS_LIST_NEXT_(q, offset);
+                    qsize--;
+                }
+                *tailp = e;
+                tailp = &NS_LIST_NEXT_(e, offset);
+            }
+            p = q;
+        }
+        *tailp = NULL;
+
+        if (merges <= 1) {
+            break;
+        }
+    }
+
+    void **tail = &list->first_entry;
+    for (void *e = head; e; e = NS_LIST_NEXT_(e, offset)) {
+        tail = NS_LIST_APPEND_(tail, e, offset);
+    }
+    list->last_nextptr = tail;
+}
+
+void ns_list_merge_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t offset, ns_list_compare_t *compare)
+{
+    void *a = dst->first_entry;
+    void *b = src->first_entry;
+    void **tail = &dst->first_entry;
+
+    if (!b) {
+        return;
+    }
+
+    while (a && b) {
+        if (compare(b, a) < 0) {
+            void *next = NS_LIST_NEXT_(b, offset);
+            tail = NS_LIST_APPEND_(tail, b, offset);
+            b = next;
+        } else {
+            void *next = NS_LIST_NEXT_(a, offset);
+            tail = NS_LIST_APPEND_(tail, a, offset);
+            a = next;
+        }
+    }
+
+    // attach the rest of either list, its own end is the end of the list
+    if (a) {
+        (void) NS_LIST_APPEND_(tail, a, offset);
+    } else {
+        if (b) {
+            (void) NS_LIST_APPEND_(tail, b, offset);
+            tail = src->last_nextptr;
+        }
+        dst->last_nextptr = tail;
+    }
+    ns_list_init_(src);
+}
+
+void ns_list_counted_merge_(ns_list_t *dst, ns_list_t *src, ns_list_offset_t offset, ns_list_compare_t *compare)
+{
+    ns_list_merge_(dst, src, offset, compare);
+    NS_LIST_COUNT_(dst) += NS_LIST_COUNT_(src);
+    NS_LIST_COUNT_(src) = 0;
+}
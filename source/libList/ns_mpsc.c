@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Intrusive MPSC queue as described by Dmitry Vyukov. Producers atomically
+ * swap themselves in as the head, then link the previous head to themselves.
+ * The stub link is re-pushed whenever the consumer would otherwise pop the
+ * last link, so the queue always holds at least one link.
+ */
+#include "ns_mpsc.h"
+#if !NS_MPSC_LOCK_FREE
+#include "platform/arm_hal_interrupt.h"
+#endif
+
+/* Pointer to the link member in entry e */
+#define NS_MPSC_LINK_(e, offset) ((ns_mpsc_link_t *)((char *)(e) + offset))
+
+/* Convert a link pointer back to the entry */
+#define NS_MPSC_ENTRY_(link, offset) ((void *)((char *)(link) - offset))
+
+#if NS_MPSC_LOCK_FREE
+static ns_mpsc_link_t *ns_mpsc_exchange(_Atomic(ns_mpsc_link_t *) *ptr, ns_mpsc_link_t *value)
+{
+    return atomic_exchange_explicit(ptr, value, memory_order_acq_rel);
+}
+
+static ns_mpsc_link_t *ns_mpsc_load(_Atomic(ns_mpsc_link_t *) *ptr)
+{
+    return atomic_load_explicit(ptr, memory_order_acquire);
+}
+
+static void ns_mpsc_store(_Atomic(ns_mpsc_link_t *) *ptr, ns_mpsc_link_t *value)
+{
+    atomic_store_explicit(ptr, value, memory_order_release);
+}
+#else
+/* No lock-free atomics, shared pointers are accessed in a critical section */
+static ns_mpsc_link_t *ns_mpsc_exchange(ns_mpsc_link_t **ptr, ns_mpsc_link_t *value)
+{
+    platform_enter_critical();
+    ns_mpsc_link_t *old = *ptr;
+    *ptr = value;
+    platform_exit_critical();
+    return old;
+}
+
+static ns_mpsc_link_t *ns_mpsc_load(ns_mpsc_link_t **ptr)
+{
+    platform_enter_critical();
+    ns_mpsc_link_t *value = *ptr;
+    platform_exit_critical();
+    return value;
+}
+
+static void ns_mpsc_store(ns_mpsc_link_t **ptr, ns_mpsc_link_t *value)
+{
+    platform_enter_critical();
+    *ptr = value;
+    platform_exit_critical();
+}
+#endif
+
+static void ns_mpsc_push_link(ns_mpsc_t *mpsc, ns_mpsc_link_t *link)
+{
+    ns_mpsc_store(&link->next, NULL);
+    ns_mpsc_link_t *prev = ns_mpsc_exchange(&mpsc->head, link);
+    // until this store, the consumer cannot see past prev
+    ns_mpsc_store(&prev->next, link);
+}
+
+void ns_mpsc_init_(ns_mpsc_t *mpsc)
+{
+    ns_mpsc_store(&mpsc->stub.next, NULL);
+    ns_mpsc_store(&mpsc->head, &mpsc->stub);
+    mpsc->tail = &mpsc->stub;
+}
+
+void ns_mpsc_push_(ns_mpsc_t *mpsc, ns_list_offset_t offset, void *restrict entry)
+{
+    ns_mpsc_push_link(mpsc, NS_MPSC_LINK_(entry, offset));
+}
+
+void *ns_mpsc_pop_(ns_mpsc_t *mpsc, ns_list_offset_t offset)
+{
+    ns_mpsc_link_t *tail = mpsc->tail;
+    ns_mpsc_link_t *next = ns_mpsc_load(&tail->next);
+
+    if (tail == &mpsc->stub) {
+        if (!next) {
+            return NULL;
+        }
+        mpsc->tail = next;
+        tail = next;
+        next = ns_mpsc_load(&tail->next);
+    }
+
+    if (!next) {
+        // tail is the last link, unless a push is in progress
+        if (tail != ns_mpsc_load(&mpsc->head)) {
+            return NULL;
+        }
+        // put the stub behind it, so that tail can be taken
+        ns_mpsc_push_link(mpsc, &mpsc->stub);
+        next = ns_mpsc_load(&tail->next);
+        if (!next) {
+            // another producer got in before the stub
+            return NULL;
+        }
+    }
+
+    mpsc->tail = next;
+    NS_FUNNY_INTPTR_OK
+    ns_mpsc_store(&tail->next, (ns_mpsc_link_t *) NS_LIST_POISON);
+    NS_FUNNY_INTPTR_RESTORE
+
+    return NS_MPSC_ENTRY_(tail, offset);
+}
+
+bool ns_mpsc_is_empty_(ns_mpsc_t *mpsc)
+{
+    return mpsc->tail == &mpsc->stub && ns_mpsc_load(&mpsc->head) == &mpsc->stub;
+}
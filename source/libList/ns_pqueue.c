@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Pairing heap. The O(1) operations can be inlined, and their definitions
+ * are in ns_pqueue.h. Define NS_PQUEUE_FN before including it to generate
+ * external definitions.
+ */
+#define NS_PQUEUE_FN extern
+
+#include "ns_pqueue.h"
+
+/*
+ * Combine a list of sibling subtrees into one, using the standard two-pass
+ * pairing: meld pairs from left to right, then meld the results from right
+ * to left. Returns the new subtree root with cleared sibling links.
+ */
+static ns_pqueue_link_t *ns_pqueue_merge_pairs(ns_list_offset_t offset, ns_pqueue_link_t *first, ns_pqueue_compare_t *compare)
+{
+    ns_pqueue_link_t *pairs = NULL;
+
+    if (!first) {
+        return NULL;
+    }
+
+    // first pass, results are pushed to a stack linked by next pointers
+    while (first) {
+        ns_pqueue_link_t *a = first;
+        ns_pqueue_link_t *b = a->next;
+        if (b) {
+            first = b->next;
+            a = ns_pqueue_meld_(offset, a, b, compare);
+        } else {
+            first = NULL;
+        }
+        a->next = pairs;
+        pairs = a;
+    }
+
+    // second pass, stack is popped in right to left order
+    ns_pqueue_link_t *root = pairs;
+    pairs = pairs->next;
+    while (pairs) {
+        ns_pqueue_link_t *next = pairs->next;
+        root = ns_pqueue_meld_(offset, root, pairs, compare);
+        pairs = next;
+    }
+    root->next = NULL;
+    root->prev = NULL;
+
+    return root;
+}
+
+static void ns_pqueue_link_poison(ns_pqueue_link_t *link)
+{
+    NS_FUNNY_INTPTR_OK
+    link->child = link->next = link->prev = (ns_pqueue_link_t *) NS_LIST_POISON;
+    NS_FUNNY_INTPTR_RESTORE
+}
+
+void *ns_pqueue_remove_first_(ns_pqueue_t *pqueue, ns_list_offset_t offset, ns_pqueue_compare_t *compare)
+{
+    ns_pqueue_link_t *link = pqueue->root;
+
+    if (!link) {
+        return NULL;
+    }
+    pqueue->root = ns_pqueue_merge_pairs(offset, link->child, compare);
+    ns_pqueue_link_poison(link);
+
+    return NS_PQUEUE_ENTRY_(link, offset);
+}
+
+void ns_pqueue_remove_(ns_pqueue_t *pqueue, ns_list_offset_t offset, void *entry, ns_pqueue_compare_t *compare)
+{
+    ns_pqueue_link_t *link = NS_PQUEUE_LINK_(entry, offset);
+
+    if (link == pqueue->root) {
+        ns_pqueue_remove_first_(pqueue, offset, compare);
+        return;
+    }
+
+    // detach subtree from its parent, and meld its children with the root
+    if (link->prev->child == link) {
+        link->prev->child = link->next;
+    } else {
+        link->prev->next = link->next;
+    }
+    if (link->next) {
+        link->next->prev = link->prev;
+    }
+    ns_pqueue_link_t *children = ns_pqueue_merge_pairs(offset, link->child, compare);
+    if (children) {
+        pqueue->root = ns_pqueue_meld_(offset, pqueue->root, children, compare);
+    }
+    ns_pqueue_link_poison(link);
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Red-black tree, following the classic algorithms (Cormen et al.) with NULL
+ * leaves. Rebalancing is done on links; entries are only needed to call the
+ * comparison function.
+ */
+#include "ns_tree.h"
+
+/* Pointer to the link member in entry e */
+#define NS_TREE_LINK_(e, offset) ((ns_tree_link_t *)((char *)(e) + offset))
+
+/* Convert a link pointer back to the entry, NULL stays NULL */
+#define NS_TREE_ENTRY_(link, offset) ((link) ? (void *)((char *)(link) - offset) : NULL)
+
+/* Colour of a link, NULL leaves are black */
+#define NS_TREE_IS_RED_(link) ((link) && (link)->red)
+
+static void ns_tree_replace_child(ns_tree_t *tree, ns_tree_link_t *parent, ns_tree_link_t *old_child, ns_tree_link_t *new_child)
+{
+    if (!parent) {
+        tree->root = new_child;
+    } else if (parent->left == old_child) {
+        parent->left = new_child;
+    } else {
+        parent->right = new_child;
+    }
+}
+
+static void ns_tree_rotate_left(ns_tree_t *tree, ns_tree_link_t *node)
+{
+    ns_tree_link_t *pivot = node->right;
+
+    node->right = pivot->left;
+    if (pivot->left) {
+        pivot->left->parent = node;
+    }
+    pivot->parent = node->parent;
+    ns_tree_replace_child(tree, node->parent, node, pivot);
+    pivot->left = node;
+    node->parent = pivot;
+}
+
+static void ns_tree_rotate_right(ns_tree_t *tree, ns_tree_link_t *node)
+{
+    ns_tree_link_t *pivot = node->left;
+
+    node->left = pivot->right;
+    if (pivot->right) {
+        pivot->right->parent = node;
+    }
+    pivot->parent = node->parent;
+    ns_tree_replace_child(tree, node->parent, node, pivot);
+    pivot->right = node;
+    node->parent = pivot;
+}
+
+static void ns_tree_insert_fixup(ns_tree_t *tree, ns_tree_link_t *node)
+{
+    ns_tree_link_t *parent;
+
+    while ((parent = node->parent) && parent->red) {
+        // parent is red, so it is not root and grandparent exists
+        ns_tree_link_t *grandparent = parent->parent;
+        if (parent == grandparent->left) {
+            ns_tree_link_t *uncle = grandparent->right;
+            if (NS_TREE_IS_RED_(uncle)) {
+                uncle->red = false;
+                parent->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->right) {
+                ns_tree_rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grandparent->red = true;
+            ns_tree_rotate_right(tree, grandparent);
+        } else {
+            ns_tree_link_t *uncle = grandparent->left;
+            if (NS_TREE_IS_RED_(uncle)) {
+                uncle->red = false;
+                parent->red = false;
+                grandparent->red = true;
+                node = grandparent;
+                continue;
+            }
+            if (node == parent->left) {
+                ns_tree_rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            grandparent->red = true;
+            ns_tree_rotate_left(tree, grandparent);
+        }
+    }
+    tree->root->red = false;
+}
+
+static void ns_tree_remove_fixup(ns_tree_t *tree, ns_tree_link_t *node, ns_tree_link_t *parent)
+{
+    // node has one black too few on its path, node can be NULL
+    while (node != tree->root && !NS_TREE_IS_RED_(node)) {
+        if (node == parent->left) {
+            ns_tree_link_t *sibling = parent->right;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                ns_tree_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+            if (!NS_TREE_IS_RED_(sibling->left) && !NS_TREE_IS_RED_(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!NS_TREE_IS_RED_(sibling->right)) {
+                sibling->left->red = false;
+                sibling->red = true;
+                ns_tree_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->right->red = false;
+            ns_tree_rotate_left(tree, parent);
+        } else {
+            ns_tree_link_t *sibling = parent->left;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                ns_tree_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+            if (!NS_TREE_IS_RED_(sibling->left) && !NS_TREE_IS_RED_(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!NS_TREE_IS_RED_(sibling->left)) {
+                sibling->right->red = false;
+                sibling->red = true;
+                ns_tree_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->left->red = false;
+            ns_tree_rotate_right(tree, parent);
+        }
+        node = tree->root;
+    }
+    if (node) {
+        node->red = false;
+    }
+}
+
+void ns_tree_insert_(ns_tree_t *tree, ns_list_offset_t offset, void *restrict entry, ns_tree_compare_t *compare)
+{
+    ns_tree_link_t *link = NS_TREE_LINK_(entry, offset);
+    ns_tree_link_t *parent = NULL;
+    ns_tree_link_t **childptr = &tree->root;
+
+    while (*childptr) {
+        parent = *childptr;
+        if (compare(entry, NS_TREE_ENTRY_(parent, offset)) < 0) {
+            childptr = &parent->left;
+        } else {
+            childptr = &parent->right;
+        }
+    }
+
+    link->parent = parent;
+    link->left = NULL;
+    link->right = NULL;
+    link->red = true;
+    *childptr = link;
+
+    ns_tree_insert_fixup(tree, link);
+}
+
+void ns_tree_remove_(ns_tree_t *tree, ns_list_offset_t offset, void *entry)
+{
+    ns_tree_link_t *link = NS_TREE_LINK_(entry, offset);
+    ns_tree_link_t *child;
+    ns_tree_link_t *parent;
+    bool removed_red;
+
+    if (!link->left || !link->right) {
+        // at most one child, which takes the place of the removed link
+        child = link->left ? link->left : link->right;
+        parent = link->parent;
+        removed_red = link->red;
+        if (child) {
+            child->parent = parent;
+        }
+        ns_tree_replace_child(tree, parent, link, child);
+    } else {
+        // two children, successor is moved to the place of the removed link
+        ns_tree_link_t *successor = link->right;
+        while (successor->left) {
+            successor = successor->left;
+        }
+        removed_red = successor->red;
+        child = successor->right;
+        if (successor->parent == link) {
+            parent = successor;
+        } else {
+            parent = successor->parent;
+            parent->left = child;
+            if (child) {
+                child->parent = parent;
+            }
+            successor->right = link->right;
+            link->right->parent = successor;
+        }
+        successor->left = link->left;
+        link->left->parent = successor;
+        successor->parent = link->parent;
+        ns_tree_replace_child(tree, link->parent, link, successor);
+        successor->red = link->red;
+    }
+
+    if (!removed_red) {
+        ns_tree_remove_fixup(tree, child, parent);
+    }
+
+    NS_FUNNY_INTPTR_OK
+    link->parent = link->left = link->right = (ns_tree_link_t *) NS_LIST_POISON;
+    NS_FUNNY_INTPTR_RESTORE
+}
+
+void *ns_tree_get_first_(const ns_tree_t *tree, ns_list_offset_t offset)
+{
+    ns_tree_link_t *link = tree->root;
+
+    if (link) {
+        while (link->left) {
+            link = link->left;
+        }
+    }
+    return NS_TREE_ENTRY_(link, offset);
+}
+
+void *ns_tree_get_last_(const ns_tree_t *tree, ns_list_offset_t offset)
+{
+    ns_tree_link_t *link = tree->root;
+
+    if (link) {
+        while (link->right) {
+            link = link->right;
+        }
+    }
+    return NS_TREE_ENTRY_(link, offset);
+}
+
+void *ns_tree_get_next_(ns_list_offset_t offset, const void *current)
+{
+    ns_tree_link_t *link = NS_TREE_LINK_(current, offset);
+
+    if (link->right) {
+        link = link->right;
+        while (link->left) {
+            link = link->left;
+        }
+        return NS_TREE_ENTRY_(link, offset);
+    }
+    while (link->parent && link == link->parent->right) {
+        link = link->parent;
+    }
+    return NS_TREE_ENTRY_(link->parent, offset);
+}
+
+void *ns_tree_get_previous_(ns_list_offset_t offset, const void *current)
+{
+    ns_tree_link_t *link = NS_TREE_LINK_(current, offset);
+
+    if (link->left) {
+        link = link->left;
+        while (link->right) {
+            link = link->right;
+        }
+        return NS_TREE_ENTRY_(link, offset);
+    }
+    while (link->parent && link == link->parent->left) {
+        link = link->parent;
+    }
+    return NS_TREE_ENTRY_(link->parent, offset);
+}
+
+void *ns_tree_lower_bound_(const ns_tree_t *tree, ns_list_offset_t offset, const void *key, ns_tree_compare_t *compare)
+{
+    ns_tree_link_t *found = NULL;
+
+    for (ns_tree_link_t *link = tree->root; link;) {
+        if (compare(key, NS_TREE_ENTRY_(link, offset)) <= 0) {
+            found = link;
+            link = link->left;
+        } else {
+            link = link->right;
+        }
+    }
+    return NS_TREE_ENTRY_(found, offset);
+}
+
+void *ns_tree_upper_bound_(const ns_tree_t *tree, ns_list_offset_t offset, const void *key, ns_tree_compare_t *compare)
+{
+    ns_tree_link_t *found = NULL;
+
+    for (ns_tree_link_t *link = tree->root; link;) {
+        if (compare(key, NS_TREE_ENTRY_(link, offset)) < 0) {
+            found = link;
+            link = link->left;
+        } else {
+            link = link->right;
+        }
+    }
+    return NS_TREE_ENTRY_(found, offset);
+}
+
+void *ns_tree_find_(const ns_tree_t *tree, ns_list_offset_t offset, const void *key, ns_tree_compare_t *compare)
+{
+    void *entry = ns_tree_lower_bound_(tree, offset, key, compare);
+
+    if (entry && compare(key, entry) != 0) {
+        return NULL;
+    }
+    return entry;
+}
@@ -24,11 +24,47 @@
 
 #if NSDYNMEM_TRACKER_ENABLED==1
 
+// Allocation count estimates are in 1/256 units
+#define COUNT_WEIGHT_SHIFT 8
+#define COUNT_WEIGHT_ONE (1 << COUNT_WEIGHT_SHIFT)
+#define COUNT_WEIGHT_MAX 0x00ffffff
+
+// Sample points in an allocation counted without drawing the interval to each of them
+#define SAMPLE_POINTS_DRAWN_MAX 16
+
+// Caller address of deleted extended memory block entry
+#define EXT_BLOCK_DELETED ((void *) 1)
+
+// Export output buffer
+typedef struct ns_dyn_mem_tracker_lib_export_s {
+    ns_dyn_mem_tracker_lib_writer *writer;
+    void *context;
+    int8_t status;
+    uint8_t len;
+    char buf[64];
+} ns_dyn_mem_tracker_lib_export_t;
+
+static bool ns_dyn_mem_tracker_lib_sampling(const ns_dyn_mem_tracker_lib_conf_t *conf);
+static uint16_t ns_dyn_mem_tracker_lib_sample(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t alloc_size);
+static uint32_t ns_dyn_mem_tracker_lib_sampled_size(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t size, uint16_t samples);
+static uint32_t ns_dyn_mem_tracker_lib_count_weight(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t size, uint16_t samples);
+static void ns_dyn_mem_tracker_lib_lifetime_update(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_mem_blocks_t *caller, uint32_t alloc_step);
+static void ns_dyn_mem_tracker_lib_allocator_set(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_allocators_t *allocator, ns_dyn_mem_tracker_lib_mem_blocks_t *block);
+static uint32_t ns_dyn_mem_tracker_lib_alloc_count(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_mem_blocks_t *block);
 static int8_t ns_dyn_mem_tracker_lib_find_free_index(ns_dyn_mem_tracker_lib_conf_t *conf, uint16_t *index);
-static int8_t ns_dyn_mem_tracker_lib_find_caller_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, uint16_t *caller_index);
+static uint16_t ns_dyn_mem_tracker_lib_stack_intern(ns_dyn_mem_tracker_lib_conf_t *conf);
+static void ns_dyn_mem_tracker_lib_stack_ref_update(ns_dyn_mem_tracker_lib_conf_t *conf, uint16_t stack_id, bool add);
+static int8_t ns_dyn_mem_tracker_lib_find_caller_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, uint16_t stack_id, uint16_t *caller_index);
 static int8_t ns_dyn_mem_tracker_lib_find_block_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block, uint16_t *block_index);
+static uint32_t ns_dyn_mem_tracker_lib_ext_start_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block);
+static int8_t ns_dyn_mem_tracker_lib_ext_reserve(ns_dyn_mem_tracker_lib_conf_t *conf);
+static void ns_dyn_mem_tracker_lib_ext_rehash(ns_dyn_mem_tracker_lib_conf_t *conf);
+static void ns_dyn_mem_tracker_lib_ext_probe_stats_update(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t probes);
 static int8_t ns_dyn_mem_tracker_lib_ext_find_free_index(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t start_index, uint32_t *free_index);
 static void ns_dyn_mem_tracker_lib_permanent_printed_value_set(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, bool new_value);
+static void ns_dyn_mem_tracker_lib_export_flush(ns_dyn_mem_tracker_lib_export_t *export);
+static void ns_dyn_mem_tracker_lib_export_string(ns_dyn_mem_tracker_lib_export_t *export, const char *str);
+static void ns_dyn_mem_tracker_lib_export_number(ns_dyn_mem_tracker_lib_export_t *export, uintptr_t value, uint8_t base);
 static int8_t ns_dyn_mem_tracker_lib_ext_find_block_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block, uint32_t start_index, uint32_t *block_index);
 
 int8_t ns_dyn_mem_tracker_lib_alloc(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, const char *function, uint32_t line, void *block, uint32_t alloc_size)
@@ -40,6 +76,16 @@ int8_t ns_dyn_mem_tracker_lib_alloc(ns_dyn_mem_tracker_lib_conf_t *conf, void *c
 
     platform_enter_critical();
 
+    uint16_t samples = ns_dyn_mem_tracker_lib_sample(conf, alloc_size);
+    if (samples == 0) {
+        // Allocation not sampled
+        platform_exit_critical();
+        return 0;
+    }
+
+    uint32_t sampled_size = ns_dyn_mem_tracker_lib_sampled_size(conf, alloc_size, samples);
+    uint32_t count_weight = ns_dyn_mem_tracker_lib_count_weight(conf, alloc_size, samples);
+
     // If dynamic memory blocks are not set, calls allocator
     if (conf->mem_blocks == NULL) {
         conf->mem_blocks = conf->alloc_mem_blocks(conf->mem_blocks, &conf->mem_blocks_count);
@@ -49,48 +95,46 @@ int8_t ns_dyn_mem_tracker_lib_alloc(ns_dyn_mem_tracker_lib_conf_t *conf, void *c
         }
     }
 
+    uint16_t stack_id = ns_dyn_mem_tracker_lib_stack_intern(conf);
+
     uint16_t caller_index = 0;
-    if (ns_dyn_mem_tracker_lib_find_caller_index(conf, caller_addr, &caller_index) >= 0) {
-        if (conf->ext_mem_blocks == NULL) {
-            conf->ext_mem_blocks = conf->ext_alloc_mem_blocks(conf->ext_mem_blocks, &conf->ext_mem_blocks_count);
-            if (conf->ext_mem_blocks == NULL) {
-                platform_exit_critical();
-                return -1;
-            }
+    if (ns_dyn_mem_tracker_lib_find_caller_index(conf, caller_addr, stack_id, &caller_index) >= 0) {
+        // Allocates, grows or cleans extended memory blocks array if needed
+        if (ns_dyn_mem_tracker_lib_ext_reserve(conf) < 0) {
+            platform_exit_critical();
+            return -1;
         }
 
         uint32_t free_index = 0;
-        uint32_t start_index = 0;
-        if (conf->block_index_hash != NULL) {
-            start_index = conf->block_index_hash(block, conf->ext_mem_blocks_count);
-        }
+        uint32_t start_index = ns_dyn_mem_tracker_lib_ext_start_index(conf, block);
         if (ns_dyn_mem_tracker_lib_ext_find_free_index(conf, start_index, &free_index) < 0) {
-            conf->ext_mem_blocks = conf->ext_alloc_mem_blocks(conf->ext_mem_blocks, &conf->ext_mem_blocks_count);
-            if (conf->ext_mem_blocks == NULL) {
-                platform_exit_critical();
-                return -1;
-            }
-            if (conf->block_index_hash != NULL) {
-                start_index = conf->block_index_hash(block, conf->ext_mem_blocks_count);
-            }
-            if (ns_dyn_mem_tracker_lib_ext_find_free_index(conf, start_index, &free_index) < 0) {
-                platform_exit_critical();
-                return -1;
-            }
+            platform_exit_critical();
+            return -1;
+        }
+
+        if (conf->ext_mem_blocks[free_index].caller_addr == EXT_BLOCK_DELETED) {
+            conf->ext_mem_blocks_deleted--;
         }
+        conf->ext_mem_blocks_used++;
 
         // Updates memory blocks array entry
         conf->mem_blocks[caller_index].ref_count++;
-        conf->mem_blocks[caller_index].total_size += alloc_size;
-        conf->mem_blocks[caller_index].lifetime = 0;
+        conf->mem_blocks[caller_index].total_size += sampled_size;
+        conf->mem_blocks[caller_index].alloc_count_scaled += count_weight;
+        conf->mem_blocks[caller_index].change_step = conf->current_step;
         conf->mem_blocks[caller_index].permanent = false;
         conf->mem_blocks[caller_index].permanent_printed = false;
 
         conf->ext_mem_blocks[free_index].block = block;
         conf->ext_mem_blocks[free_index].caller_addr = caller_addr;
         conf->ext_mem_blocks[free_index].size = alloc_size;
+        conf->ext_mem_blocks[free_index].samples = samples;
+        conf->ext_mem_blocks[free_index].alloc_step = conf->current_step;
+        conf->ext_mem_blocks[free_index].stack_id = stack_id;
+
+        ns_dyn_mem_tracker_lib_stack_ref_update(conf, stack_id, true);
 
-        conf->allocated_memory += alloc_size;
+        conf->allocated_memory += sampled_size;
 
         platform_exit_critical();
         return 0;
@@ -108,19 +152,28 @@ int8_t ns_dyn_mem_tracker_lib_alloc(ns_dyn_mem_tracker_lib_conf_t *conf, void *c
     conf->mem_blocks[free_index].block = block;
     conf->mem_blocks[free_index].caller_addr = caller_addr;
     conf->mem_blocks[free_index].size = alloc_size;
-    conf->mem_blocks[free_index].total_size = alloc_size;
-    conf->mem_blocks[free_index].lifetime = 0;
+    conf->mem_blocks[free_index].total_size = sampled_size;
+    conf->mem_blocks[free_index].alloc_count_scaled = count_weight;
+    conf->mem_blocks[free_index].samples = samples;
+    conf->mem_blocks[free_index].stack_id = stack_id;
+    conf->mem_blocks[free_index].alloc_step = conf->current_step;
+    conf->mem_blocks[free_index].change_step = conf->current_step;
     conf->mem_blocks[free_index].ref_count = 1;
     conf->mem_blocks[free_index].function = function;
     conf->mem_blocks[free_index].line = line;
     conf->mem_blocks[free_index].permanent = false;
     conf->mem_blocks[free_index].permanent_printed = false;
+    conf->mem_blocks[free_index].leak_snapshot_size = 0;
+    conf->mem_blocks[free_index].leak_start_size = 0;
+    conf->mem_blocks[free_index].leak_growth_count = 0;
 
     if (free_index > conf->last_mem_block_index) {
         conf->last_mem_block_index = free_index;
     }
 
-    conf->allocated_memory += alloc_size;
+    ns_dyn_mem_tracker_lib_stack_ref_update(conf, stack_id, true);
+
+    conf->allocated_memory += sampled_size;
 
     platform_exit_critical();
 
@@ -142,26 +195,37 @@ int8_t ns_dyn_mem_tracker_lib_free(ns_dyn_mem_tracker_lib_conf_t *conf, void *ca
 
     uint16_t block_index = 0;
     if (ns_dyn_mem_tracker_lib_find_block_index(conf, block, &block_index) >= 0) {
+        uint32_t size = conf->mem_blocks[block_index].size;
+        uint16_t samples = conf->mem_blocks[block_index].samples;
+        uint32_t sampled_size = ns_dyn_mem_tracker_lib_sampled_size(conf, size, samples);
+
+        ns_dyn_mem_tracker_lib_stack_ref_update(conf, conf->mem_blocks[block_index].stack_id, false);
+        ns_dyn_mem_tracker_lib_lifetime_update(conf, &conf->mem_blocks[block_index], conf->mem_blocks[block_index].alloc_step);
+
         // If last block for allocator clears the allocator
         if (conf->mem_blocks[block_index].ref_count <= 1) {
             conf->mem_blocks[block_index].ref_count = 0;
             conf->mem_blocks[block_index].caller_addr = NULL;
+            conf->mem_blocks[block_index].stack_id = 0;
             conf->mem_blocks[block_index].total_size = 0;
+            conf->mem_blocks[block_index].alloc_count_scaled = 0;
             conf->mem_blocks[block_index].function = NULL;
             conf->mem_blocks[block_index].line = 0;
         } else {
             // Other blocks exists
             conf->mem_blocks[block_index].ref_count--;
-            conf->mem_blocks[block_index].total_size -= conf->mem_blocks[block_index].size;
+            conf->mem_blocks[block_index].total_size -= sampled_size;
+            conf->mem_blocks[block_index].alloc_count_scaled -= ns_dyn_mem_tracker_lib_count_weight(conf, size, samples);
         }
 
-        conf->allocated_memory -= conf->mem_blocks[block_index].size;
+        conf->allocated_memory -= sampled_size;
 
         // Clears block specific fields
         conf->mem_blocks[block_index].block = NULL;
         conf->mem_blocks[block_index].size = 0;
+        conf->mem_blocks[block_index].samples = 0;
         // Resets lifetime and permanent settings
-        conf->mem_blocks[block_index].lifetime = 0;
+        conf->mem_blocks[block_index].change_step = conf->current_step;
         conf->mem_blocks[block_index].permanent = false;
         conf->mem_blocks[block_index].permanent_printed = false;
 
@@ -169,52 +233,74 @@ int8_t ns_dyn_mem_tracker_lib_free(ns_dyn_mem_tracker_lib_conf_t *conf, void *ca
         return 0;
     }
 
+    // In sampling mode block might not have been sampled
+    int8_t not_found_ret = ns_dyn_mem_tracker_lib_sampling(conf) ? 0 : -1;
+
     if (conf->ext_mem_blocks == NULL) {
         platform_exit_critical();
-        return -1;
+        return not_found_ret;
     }
 
     uint32_t ext_block_index = 0;
-    uint32_t start_index = 0;
-    if (conf->block_index_hash != NULL) {
-        start_index = conf->block_index_hash(block, conf->ext_mem_blocks_count);
-    }
+    uint32_t start_index = ns_dyn_mem_tracker_lib_ext_start_index(conf, block);
     if (ns_dyn_mem_tracker_lib_ext_find_block_index(conf, block, start_index, &ext_block_index) < 0) {
         platform_exit_critical();
-        return -1;
+        return not_found_ret;
     }
 
     void *ext_caller_addr = conf->ext_mem_blocks[ext_block_index].caller_addr;
+    uint16_t ext_stack_id = conf->ext_mem_blocks[ext_block_index].stack_id;
 
     uint16_t caller_index;
-    if (ns_dyn_mem_tracker_lib_find_caller_index(conf, ext_caller_addr, &caller_index) < 0) {
+    if (ns_dyn_mem_tracker_lib_find_caller_index(conf, ext_caller_addr, ext_stack_id, &caller_index) < 0) {
         platform_exit_critical();
         return -1;
     }
 
+    ns_dyn_mem_tracker_lib_stack_ref_update(conf, ext_stack_id, false);
+    ns_dyn_mem_tracker_lib_lifetime_update(conf, &conf->mem_blocks[caller_index], conf->ext_mem_blocks[ext_block_index].alloc_step);
+
+    uint32_t size = conf->ext_mem_blocks[ext_block_index].size;
+    uint16_t samples = conf->ext_mem_blocks[ext_block_index].samples;
+    uint32_t sampled_size = ns_dyn_mem_tracker_lib_sampled_size(conf, size, samples);
+
     conf->mem_blocks[caller_index].ref_count--;
-    conf->mem_blocks[caller_index].total_size -= conf->ext_mem_blocks[ext_block_index].size;
+    conf->mem_blocks[caller_index].total_size -= sampled_size;
+    conf->mem_blocks[caller_index].alloc_count_scaled -= ns_dyn_mem_tracker_lib_count_weight(conf, size, samples);
 
-    conf->allocated_memory -= conf->ext_mem_blocks[ext_block_index].size;
+    conf->allocated_memory -= sampled_size;
 
-    // Clears extended block
+    // Clears extended block. If next entry is empty, no probe sequence
+    // continues over the entry and it can be set empty instead of deleted.
+    uint32_t next_index = ext_block_index + 1 < conf->ext_mem_blocks_count ? ext_block_index + 1 : 0;
     conf->ext_mem_blocks[ext_block_index].block = NULL;
-    conf->ext_mem_blocks[ext_block_index].caller_addr = NULL;
+    if (conf->ext_mem_blocks[next_index].caller_addr == NULL) {
+        conf->ext_mem_blocks[ext_block_index].caller_addr = NULL;
+    } else {
+        conf->ext_mem_blocks[ext_block_index].caller_addr = EXT_BLOCK_DELETED;
+        conf->ext_mem_blocks_deleted++;
+    }
+    conf->ext_mem_blocks_used--;
     conf->ext_mem_blocks[ext_block_index].size = 0;
+    conf->ext_mem_blocks[ext_block_index].samples = 0;
+    conf->ext_mem_blocks[ext_block_index].stack_id = 0;
 
     // Resets lifetime and permanent settings
-    conf->mem_blocks[block_index].lifetime = 0;
-    conf->mem_blocks[block_index].permanent = false;
-    conf->mem_blocks[block_index].permanent_printed = false;
+    conf->mem_blocks[caller_index].change_step = conf->current_step;
+    conf->mem_blocks[caller_index].permanent = false;
+    conf->mem_blocks[caller_index].permanent_printed = false;
 
     // If last block for allocator clears the allocator
-    if (conf->mem_blocks[block_index].ref_count == 0) {
-        conf->mem_blocks[block_index].block = NULL;
-        conf->mem_blocks[block_index].caller_addr = NULL;
-        conf->mem_blocks[block_index].size = 0;
-        conf->mem_blocks[block_index].total_size = 0;
-        conf->mem_blocks[block_index].function = NULL;
-        conf->mem_blocks[block_index].line = 0;
+    if (conf->mem_blocks[caller_index].ref_count == 0) {
+        conf->mem_blocks[caller_index].block = NULL;
+        conf->mem_blocks[caller_index].caller_addr = NULL;
+        conf->mem_blocks[caller_index].size = 0;
+        conf->mem_blocks[caller_index].total_size = 0;
+        conf->mem_blocks[caller_index].alloc_count_scaled = 0;
+        conf->mem_blocks[caller_index].samples = 0;
+        conf->mem_blocks[caller_index].stack_id = 0;
+        conf->mem_blocks[caller_index].function = NULL;
+        conf->mem_blocks[caller_index].line = 0;
     }
 
     platform_exit_critical();
@@ -226,13 +312,8 @@ void ns_dyn_mem_tracker_lib_step(ns_dyn_mem_tracker_lib_conf_t *conf)
 {
     platform_enter_critical();
 
-    if (conf->mem_blocks_count != 0) {
-        for (uint32_t index = 0; index <= conf->last_mem_block_index; index++) {
-            if (conf->mem_blocks[index].block != NULL) {
-                conf->mem_blocks[index].lifetime++;
-            }
-        }
-    }
+    // Lifetimes are calculated from allocation and change steps
+    conf->current_step++;
 
     platform_exit_critical();
 }
@@ -261,13 +342,13 @@ int8_t ns_dyn_mem_tracker_lib_allocator_lists_update(ns_dyn_mem_tracker_lib_conf
     uint8_t permanent_count = 0;
 
     for (uint32_t index = 0; index <= conf->last_mem_block_index; index++) {
-        if (blocks[index].block != NULL) {
+        if (blocks[index].caller_addr != NULL) {
             void *caller_addr = blocks[index].caller_addr;
 
-            // Checks if caller address has already been counted
+            // Checks if caller address and call stack have already been counted
             bool next = false;
             for (uint32_t list_index = 0; list_index < top_allocators_count; list_index++) {
-                if (top_allocators[list_index].caller_addr == caller_addr) {
+                if (top_allocators[list_index].caller_addr == caller_addr && top_allocators[list_index].stack_id == blocks[index].stack_id) {
                     next = true;
                     break;
                 }
@@ -280,12 +361,7 @@ int8_t ns_dyn_mem_tracker_lib_allocator_lists_update(ns_dyn_mem_tracker_lib_conf
             // Checks whether all reference are marked permanent
             if (blocks[index].permanent) {
                 if (!blocks[index].permanent_printed && permanent_count < permanent_allocators_count) {
-                    permanent_allocators[permanent_count].caller_addr = caller_addr;
-                    permanent_allocators[permanent_count].alloc_count = blocks[index].ref_count;
-                    permanent_allocators[permanent_count].total_memory = blocks[index].total_size;
-                    permanent_allocators[permanent_count].min_lifetime = blocks[index].lifetime;
-                    permanent_allocators[permanent_count].function = blocks[index].function;
-                    permanent_allocators[permanent_count].line = blocks[index].line;
+                    ns_dyn_mem_tracker_lib_allocator_set(conf, &permanent_allocators[permanent_count], &blocks[index]);
 
                     permanent_count++;
                     blocks[index].permanent_printed = true;
@@ -293,15 +369,10 @@ int8_t ns_dyn_mem_tracker_lib_allocator_lists_update(ns_dyn_mem_tracker_lib_conf
                 continue;
             } else {
                 // Checks whether lifetime threshold has been reached, traces and skips
-                if (blocks[index].lifetime > conf->to_permanent_steps_count && to_permanent_count < to_permanent_allocators_count) {
+                if (conf->current_step - blocks[index].change_step > conf->to_permanent_steps_count && to_permanent_count < to_permanent_allocators_count) {
                     blocks[index].permanent = true;
 
-                    to_permanent_allocators[to_permanent_count].caller_addr = caller_addr;
-                    to_permanent_allocators[to_permanent_count].alloc_count = blocks[index].ref_count;
-                    to_permanent_allocators[to_permanent_count].total_memory = blocks[index].total_size;
-                    to_permanent_allocators[to_permanent_count].min_lifetime = blocks[index].lifetime;
-                    to_permanent_allocators[to_permanent_count].function = blocks[index].function;
-                    to_permanent_allocators[to_permanent_count].line = blocks[index].line;
+                    ns_dyn_mem_tracker_lib_allocator_set(conf, &to_permanent_allocators[to_permanent_count], &blocks[index]);
 
                     to_permanent_count++;
                     continue;
@@ -310,18 +381,13 @@ int8_t ns_dyn_mem_tracker_lib_allocator_lists_update(ns_dyn_mem_tracker_lib_conf
 
             // Add to list if allocation count is larger than entry on the list
             for (uint16_t list_index = 0; list_index < top_allocators_count; list_index++) {
-                if (blocks[index].ref_count >= top_allocators[list_index].alloc_count) {
+                if (ns_dyn_mem_tracker_lib_alloc_count(conf, &blocks[index]) >= top_allocators[list_index].alloc_count) {
                     if (list_index != (top_allocators_count - 1)) {
                         uint8_t index_count = (top_allocators_count - list_index - 1);
                         uint32_t size = index_count * sizeof(ns_dyn_mem_tracker_lib_allocators_t);
                         memmove(&top_allocators[list_index + 1], &top_allocators[list_index], size);
                     }
-                    top_allocators[list_index].caller_addr = caller_addr;
-                    top_allocators[list_index].alloc_count = blocks[index].ref_count;
-                    top_allocators[list_index].total_memory = blocks[index].total_size;
-                    top_allocators[list_index].min_lifetime = blocks[index].lifetime;
-                    top_allocators[list_index].function = blocks[index].function;
-                    top_allocators[list_index].line = blocks[index].line;
+                    ns_dyn_mem_tracker_lib_allocator_set(conf, &top_allocators[list_index], &blocks[index]);
                     break;
                 }
             }
@@ -349,13 +415,13 @@ void ns_dyn_mem_tracker_lib_max_snap_shot_update(ns_dyn_mem_tracker_lib_conf_t *
     memset(max_snap_shot_allocators, 0, max_snap_shot_allocators_count * sizeof(ns_dyn_mem_tracker_lib_allocators_t));
 
     for (uint32_t index = 0; index <= conf->last_mem_block_index; index++) {
-        if (blocks[index].block != NULL) {
+        if (blocks[index].caller_addr != NULL) {
             void *caller_addr = blocks[index].caller_addr;
 
-            // Checks if caller address has already been counted
+            // Checks if caller address and call stack have already been counted
             bool next = false;
             for (uint16_t list_index = 0; list_index < max_snap_shot_allocators_count; list_index++) {
-                if (max_snap_shot_allocators[list_index].caller_addr == caller_addr) {
+                if (max_snap_shot_allocators[list_index].caller_addr == caller_addr && max_snap_shot_allocators[list_index].stack_id == blocks[index].stack_id) {
                     next = true;
                     break;
                 }
@@ -373,12 +439,7 @@ void ns_dyn_mem_tracker_lib_max_snap_shot_update(ns_dyn_mem_tracker_lib_conf_t *
                         uint32_t size = index_count * sizeof(ns_dyn_mem_tracker_lib_allocators_t);
                         memmove(&max_snap_shot_allocators[list_index + 1], &max_snap_shot_allocators[list_index], size);
                     }
-                    max_snap_shot_allocators[list_index].caller_addr = blocks[index].caller_addr;
-                    max_snap_shot_allocators[list_index].alloc_count = blocks[index].ref_count;
-                    max_snap_shot_allocators[list_index].total_memory = blocks[index].total_size;
-                    max_snap_shot_allocators[list_index].min_lifetime = blocks[index].lifetime;
-                    max_snap_shot_allocators[list_index].function = blocks[index].function;
-                    max_snap_shot_allocators[list_index].line = blocks[index].line;
+                    ns_dyn_mem_tracker_lib_allocator_set(conf, &max_snap_shot_allocators[list_index], &blocks[index]);
                     break;
                 }
             }
@@ -388,6 +449,427 @@ void ns_dyn_mem_tracker_lib_max_snap_shot_update(ns_dyn_mem_tracker_lib_conf_t *
     platform_exit_critical();
 }
 
+void ns_dyn_mem_tracker_lib_leak_snapshot_update(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    platform_enter_critical();
+
+    ns_dyn_mem_tracker_lib_mem_blocks_t *blocks = conf->mem_blocks;
+
+    for (uint32_t index = 0; blocks != NULL && index <= conf->last_mem_block_index; index++) {
+        if (blocks[index].caller_addr == NULL) {
+            continue;
+        }
+
+        if (blocks[index].total_size > blocks[index].leak_snapshot_size) {
+            // Growth starts from previous snapshot
+            if (blocks[index].leak_growth_count == 0) {
+                blocks[index].leak_start_size = blocks[index].leak_snapshot_size;
+            }
+            if (blocks[index].leak_growth_count < UINT16_MAX) {
+                blocks[index].leak_growth_count++;
+            }
+        } else {
+            blocks[index].leak_growth_count = 0;
+        }
+        blocks[index].leak_snapshot_size = blocks[index].total_size;
+    }
+
+    conf->leak_snapshot_count++;
+
+    platform_exit_critical();
+}
+
+uint16_t ns_dyn_mem_tracker_lib_leak_allocators_update(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    platform_enter_critical();
+
+    ns_dyn_mem_tracker_lib_mem_blocks_t *blocks = conf->mem_blocks;
+    ns_dyn_mem_tracker_lib_leak_allocators_t *leak_allocators = conf->leak_allocators;
+
+    uint16_t leak_allocators_count = leak_allocators != NULL ? conf->leak_allocators_count : 0;
+    uint16_t leak_count = 0;
+    uint16_t found_count = 0;
+
+    if (leak_allocators_count > 0) {
+        memset(leak_allocators, 0, leak_allocators_count * sizeof(ns_dyn_mem_tracker_lib_leak_allocators_t));
+    }
+
+    uint16_t leak_snapshots_count = conf->leak_snapshots_count > 0 ? conf->leak_snapshots_count : 1;
+
+    for (uint32_t index = 0; blocks != NULL && index <= conf->last_mem_block_index; index++) {
+        if (blocks[index].caller_addr == NULL || blocks[index].leak_growth_count < leak_snapshots_count) {
+            continue;
+        }
+
+        if (found_count < UINT16_MAX) {
+            found_count++;
+        }
+
+        uint32_t growth = blocks[index].leak_snapshot_size - blocks[index].leak_start_size;
+
+        // Add to list if growth is larger than entry on the list
+        for (uint16_t list_index = 0; list_index < leak_allocators_count; list_index++) {
+            if (list_index >= leak_count || growth > leak_allocators[list_index].growth) {
+                if (list_index != (leak_allocators_count - 1)) {
+                    uint16_t index_count = (leak_allocators_count - list_index - 1);
+                    uint32_t size = index_count * sizeof(ns_dyn_mem_tracker_lib_leak_allocators_t);
+                    memmove(&leak_allocators[list_index + 1], &leak_allocators[list_index], size);
+                }
+                leak_allocators[list_index].caller_addr = blocks[index].caller_addr;
+                leak_allocators[list_index].alloc_count = ns_dyn_mem_tracker_lib_alloc_count(conf, &blocks[index]);
+                leak_allocators[list_index].total_memory = blocks[index].total_size;
+                leak_allocators[list_index].growth = growth;
+                leak_allocators[list_index].growth_count = blocks[index].leak_growth_count;
+                leak_allocators[list_index].function = blocks[index].function;
+                leak_allocators[list_index].line = blocks[index].line;
+                leak_allocators[list_index].stack_id = blocks[index].stack_id;
+                if (leak_count < leak_allocators_count) {
+                    leak_count++;
+                }
+                break;
+            }
+        }
+    }
+
+    platform_exit_critical();
+
+    return found_count;
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_random(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    // xorshift32
+    uint32_t x = conf->sample_seed;
+    if (x == 0) {
+        x = 0x2545f491;
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    conf->sample_seed = x;
+    return x;
+}
+
+static bool ns_dyn_mem_tracker_lib_sampling(const ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    // Interval of one byte samples every allocation, tracks all allocations
+    return conf->sample_interval > 1;
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_sample_interval(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    // Uniformly distributed in range 1 ... 2 * sample_interval - 1, mean is sample_interval
+    uint32_t range = conf->sample_interval > 0x7fffffff ? 0xffffffff : conf->sample_interval * 2 - 1;
+    return 1 + ns_dyn_mem_tracker_lib_random(conf) % range;
+}
+
+static uint16_t ns_dyn_mem_tracker_lib_sample(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t alloc_size)
+{
+    if (!ns_dyn_mem_tracker_lib_sampling(conf)) {
+        // Tracks all allocations
+        return 1;
+    }
+
+    if (conf->sample_bytes_left == 0) {
+        conf->sample_bytes_left = ns_dyn_mem_tracker_lib_sample_interval(conf);
+    }
+
+    // No sample point within allocated bytes
+    if (alloc_size < conf->sample_bytes_left) {
+        conf->sample_bytes_left -= alloc_size;
+        return 0;
+    }
+
+    // Counts all sample points that hit the allocation
+    uint32_t remaining = alloc_size - conf->sample_bytes_left;
+    uint32_t samples = 1;
+    if (remaining / conf->sample_interval >= SAMPLE_POINTS_DRAWN_MAX) {
+        // Large allocation, expected number of sample points is counted by division
+        samples += remaining / conf->sample_interval;
+        remaining %= conf->sample_interval;
+    }
+    uint32_t interval = ns_dyn_mem_tracker_lib_sample_interval(conf);
+    while (interval <= remaining) {
+        remaining -= interval;
+        samples++;
+        interval = ns_dyn_mem_tracker_lib_sample_interval(conf);
+    }
+    conf->sample_bytes_left = interval - remaining;
+
+    return samples > UINT16_MAX ? UINT16_MAX : (uint16_t) samples;
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_sampled_size(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t size, uint16_t samples)
+{
+    if (!ns_dyn_mem_tracker_lib_sampling(conf)) {
+        return size;
+    }
+
+    // Each sample point represents sample interval amount of bytes
+    uint64_t sampled_size = (uint64_t) samples * conf->sample_interval;
+    return sampled_size > UINT32_MAX ? UINT32_MAX : (uint32_t) sampled_size;
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_count_weight(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t size, uint16_t samples)
+{
+    if (!ns_dyn_mem_tracker_lib_sampling(conf) || size == 0) {
+        return COUNT_WEIGHT_ONE;
+    }
+
+    // Expected number of sample points is size / sample interval, so this is unbiased count estimate
+    uint64_t weight = (((uint64_t) samples * conf->sample_interval) << COUNT_WEIGHT_SHIFT) / size;
+    return weight > COUNT_WEIGHT_MAX ? COUNT_WEIGHT_MAX : (uint32_t) weight;
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_alloc_count(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_mem_blocks_t *block)
+{
+    if (!ns_dyn_mem_tracker_lib_sampling(conf)) {
+        return block->ref_count;
+    }
+
+    return (block->alloc_count_scaled + COUNT_WEIGHT_ONE / 2) >> COUNT_WEIGHT_SHIFT;
+}
+
+static void ns_dyn_mem_tracker_lib_lifetime_update(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_mem_blocks_t *caller, uint32_t alloc_step)
+{
+    if (conf->lifetime_histograms == NULL) {
+        return;
+    }
+
+    ns_dyn_mem_tracker_lib_lifetime_histogram_t *histogram = NULL;
+    for (uint16_t index = 0; index < conf->lifetime_histograms_count; index++) {
+        if (conf->lifetime_histograms[index].caller_addr == caller->caller_addr) {
+            histogram = &conf->lifetime_histograms[index];
+            break;
+        }
+        if (histogram == NULL && conf->lifetime_histograms[index].caller_addr == NULL) {
+            histogram = &conf->lifetime_histograms[index];
+        }
+    }
+
+    // Histograms array full
+    if (histogram == NULL) {
+        return;
+    }
+
+    if (histogram->caller_addr == NULL) {
+        memset(histogram, 0, sizeof(ns_dyn_mem_tracker_lib_lifetime_histogram_t));
+        histogram->caller_addr = caller->caller_addr;
+        histogram->function = caller->function;
+        histogram->line = caller->line;
+    }
+
+    // Log2 scale bucket
+    uint32_t lifetime = conf->current_step - alloc_step;
+    uint8_t bucket = 0;
+    while (lifetime != 0 && bucket < NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS - 1) {
+        lifetime >>= 1;
+        bucket++;
+    }
+
+    histogram->buckets[bucket]++;
+}
+
+static void ns_dyn_mem_tracker_lib_allocator_set(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_allocators_t *allocator, ns_dyn_mem_tracker_lib_mem_blocks_t *block)
+{
+    allocator->caller_addr = block->caller_addr;
+    allocator->alloc_count = ns_dyn_mem_tracker_lib_alloc_count(conf, block);
+    allocator->total_memory = block->total_size;
+    allocator->sampled_count = block->ref_count;
+    allocator->min_lifetime = conf->current_step - block->change_step;
+    allocator->function = block->function;
+    allocator->line = block->line;
+    allocator->stack_id = block->stack_id;
+}
+
+void **ns_dyn_mem_tracker_lib_stack_frames_get(ns_dyn_mem_tracker_lib_conf_t *conf, uint16_t stack_id, uint8_t *depth)
+{
+    if (stack_id == 0 || stack_id > conf->stacks_count || conf->stacks[stack_id - 1].depth == 0) {
+        *depth = 0;
+        return NULL;
+    }
+
+    *depth = conf->stacks[stack_id - 1].depth;
+    return &conf->stack_frames[(uint32_t)(stack_id - 1) * conf->stack_depth];
+}
+
+int8_t ns_dyn_mem_tracker_lib_export_collapsed(ns_dyn_mem_tracker_lib_conf_t *conf, ns_dyn_mem_tracker_lib_export_value_t value, ns_dyn_mem_tracker_lib_writer *writer, void *context)
+{
+    if (writer == NULL) {
+        return -1;
+    }
+
+    ns_dyn_mem_tracker_lib_export_t export;
+    export.writer = writer;
+    export.context = context;
+    export.status = 0;
+    export.len = 0;
+
+    for (uint32_t index = 0; index <= conf->last_mem_block_index && export.status >= 0; index++) {
+        void *frames[NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX];
+        uint8_t depth = 0;
+
+        // Copies the entry so that writer is not called from critical section
+        platform_enter_critical();
+
+        if (conf->mem_blocks == NULL || conf->mem_blocks[index].caller_addr == NULL) {
+            platform_exit_critical();
+            continue;
+        }
+
+        ns_dyn_mem_tracker_lib_allocators_t allocator;
+        ns_dyn_mem_tracker_lib_allocator_set(conf, &allocator, &conf->mem_blocks[index]);
+
+        void **stack_frames = ns_dyn_mem_tracker_lib_stack_frames_get(conf, allocator.stack_id, &depth);
+        if (depth > NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX) {
+            depth = NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX;
+        }
+        if (stack_frames != NULL) {
+            memcpy(frames, stack_frames, depth * sizeof(void *));
+        }
+
+        platform_exit_critical();
+
+        uint32_t export_value = value == NS_DYN_MEM_TRACKER_LIB_EXPORT_COUNT ? allocator.alloc_count : allocator.total_memory;
+        if (export_value == 0) {
+            continue;
+        }
+
+        // Frames from outermost to innermost, allocation site is the leaf
+        while (depth > 0) {
+            depth--;
+            ns_dyn_mem_tracker_lib_export_string(&export, "0x");
+            ns_dyn_mem_tracker_lib_export_number(&export, (uintptr_t) frames[depth], 16);
+            ns_dyn_mem_tracker_lib_export_string(&export, ";");
+        }
+        if (allocator.function != NULL) {
+            ns_dyn_mem_tracker_lib_export_string(&export, allocator.function);
+            ns_dyn_mem_tracker_lib_export_string(&export, ":");
+            ns_dyn_mem_tracker_lib_export_number(&export, allocator.line, 10);
+        } else {
+            ns_dyn_mem_tracker_lib_export_string(&export, "0x");
+            ns_dyn_mem_tracker_lib_export_number(&export, (uintptr_t) allocator.caller_addr, 16);
+        }
+        ns_dyn_mem_tracker_lib_export_string(&export, " ");
+        ns_dyn_mem_tracker_lib_export_number(&export, export_value, 10);
+        ns_dyn_mem_tracker_lib_export_string(&export, "\n");
+    }
+
+    ns_dyn_mem_tracker_lib_export_flush(&export);
+
+    return export.status;
+}
+
+static void ns_dyn_mem_tracker_lib_export_flush(ns_dyn_mem_tracker_lib_export_t *export)
+{
+    if (export->len > 0 && export->status >= 0) {
+        export->status = export->writer(export->buf, export->len, export->context);
+    }
+    export->len = 0;
+}
+
+static void ns_dyn_mem_tracker_lib_export_string(ns_dyn_mem_tracker_lib_export_t *export, const char *str)
+{
+    while (*str != '\0') {
+        if (export->len == sizeof(export->buf)) {
+            ns_dyn_mem_tracker_lib_export_flush(export);
+        }
+        export->buf[export->len++] = *str++;
+    }
+}
+
+static void ns_dyn_mem_tracker_lib_export_number(ns_dyn_mem_tracker_lib_export_t *export, uintptr_t value, uint8_t base)
+{
+    char str[sizeof(uintptr_t) * 3 + 1];
+    uint8_t pos = sizeof(str) - 1;
+
+    str[pos] = '\0';
+    do {
+        str[--pos] = "0123456789abcdef"[value % base];
+        value /= base;
+    } while (value != 0);
+
+    ns_dyn_mem_tracker_lib_export_string(export, &str[pos]);
+}
+
+static uint16_t ns_dyn_mem_tracker_lib_stack_intern(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    if (conf->stack_capture == NULL || conf->stacks == NULL || conf->stacks_count == 0) {
+        return 0;
+    }
+
+    void *frames[NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX];
+    uint8_t max_depth = conf->stack_depth;
+    if (max_depth > NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX) {
+        max_depth = NS_DYN_MEM_TRACKER_LIB_STACK_DEPTH_MAX;
+    }
+
+    uint8_t depth = conf->stack_capture(frames, max_depth);
+    if (depth == 0) {
+        return 0;
+    }
+    if (depth > max_depth) {
+        depth = max_depth;
+    }
+
+    // FNV-1a hash of the frame addresses
+    uint32_t hash = 2166136261u;
+    for (uint8_t frame = 0; frame < depth; frame++) {
+        hash ^= (uint32_t)(uintptr_t) frames[frame];
+        hash *= 16777619u;
+    }
+
+    /* Open addressing with linear probing. Entries are never set back to unused,
+       so probe sequences stay valid; entries without references are reused */
+    uint16_t reuse_index = conf->stacks_count;
+    uint16_t index = hash % conf->stacks_count;
+    for (uint16_t probe = 0; probe < conf->stacks_count; probe++) {
+        ns_dyn_mem_tracker_lib_stack_t *stack = &conf->stacks[index];
+        if (stack->depth == 0) {
+            if (reuse_index == conf->stacks_count) {
+                reuse_index = index;
+            }
+            break;
+        }
+        if (stack->hash == hash && stack->depth == depth &&
+                memcmp(&conf->stack_frames[(uint32_t) index * conf->stack_depth], frames, depth * sizeof(void *)) == 0) {
+            return index + 1;
+        }
+        if (stack->ref_count == 0 && reuse_index == conf->stacks_count) {
+            reuse_index = index;
+        }
+        index++;
+        if (index == conf->stacks_count) {
+            index = 0;
+        }
+    }
+
+    // Stack table full
+    if (reuse_index == conf->stacks_count) {
+        return 0;
+    }
+
+    conf->stacks[reuse_index].hash = hash;
+    conf->stacks[reuse_index].ref_count = 0;
+    conf->stacks[reuse_index].depth = depth;
+    memcpy(&conf->stack_frames[(uint32_t) reuse_index * conf->stack_depth], frames, depth * sizeof(void *));
+
+    return reuse_index + 1;
+}
+
+static void ns_dyn_mem_tracker_lib_stack_ref_update(ns_dyn_mem_tracker_lib_conf_t *conf, uint16_t stack_id, bool add)
+{
+    if (stack_id == 0) {
+        return;
+    }
+
+    if (add) {
+        conf->stacks[stack_id - 1].ref_count++;
+    } else if (conf->stacks[stack_id - 1].ref_count > 0) {
+        conf->stacks[stack_id - 1].ref_count--;
+    }
+}
+
 static void ns_dyn_mem_tracker_lib_permanent_printed_value_set(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, bool new_value)
 {
     /* Search for all the references to the caller address from the allocation info and
@@ -410,10 +892,10 @@ static int8_t ns_dyn_mem_tracker_lib_find_free_index(ns_dyn_mem_tracker_lib_conf
     return -1;
 }
 
-static int8_t ns_dyn_mem_tracker_lib_find_caller_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, uint16_t *caller_index)
+static int8_t ns_dyn_mem_tracker_lib_find_caller_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *caller_addr, uint16_t stack_id, uint16_t *caller_index)
 {
     for (uint16_t index = 0; index <= conf->last_mem_block_index; index++) {
-        if (conf->mem_blocks[index].caller_addr == caller_addr) {
+        if (conf->mem_blocks[index].caller_addr == caller_addr && conf->mem_blocks[index].stack_id == stack_id) {
             *caller_index = index;
             return 0;
         }
@@ -432,49 +914,171 @@ static int8_t ns_dyn_mem_tracker_lib_find_block_index(ns_dyn_mem_tracker_lib_con
     return -1;
 }
 
-static int8_t ns_dyn_mem_tracker_lib_ext_find_free_index(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t start_index, uint32_t *free_index)
+uint32_t ns_dyn_mem_tracker_lib_default_block_index_hash(void *block, uint32_t ext_mem_blocks_count)
 {
-    for (uint32_t index = start_index; index < conf->ext_mem_blocks_count; index++) {
-        if (conf->ext_mem_blocks[index].caller_addr == NULL) {
-            *free_index = index;
-            return 0;
+    // Discards alignment bits, mixes address using Fibonacci hashing and maps
+    // result to array range using multiply and shift instead of division
+    uint32_t value = (uint32_t)((uintptr_t) block >> 2);
+#if UINTPTR_MAX > 0xffffffff
+    value ^= (uint32_t)((uint64_t)(uintptr_t) block >> 32);
+#endif
+    value *= 0x9e3779b1;
+    return (uint32_t)(((uint64_t) value * ext_mem_blocks_count) >> 32);
+}
+
+static uint32_t ns_dyn_mem_tracker_lib_ext_start_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block)
+{
+    uint32_t start_index;
+    if (conf->block_index_hash != NULL) {
+        start_index = conf->block_index_hash(block, conf->ext_mem_blocks_count);
+        if (start_index >= conf->ext_mem_blocks_count) {
+            start_index %= conf->ext_mem_blocks_count;
         }
+    } else {
+        start_index = ns_dyn_mem_tracker_lib_default_block_index_hash(block, conf->ext_mem_blocks_count);
     }
+    return start_index;
+}
 
-    if (start_index == 0) {
-        return -1;
+static int8_t ns_dyn_mem_tracker_lib_ext_reserve(ns_dyn_mem_tracker_lib_conf_t *conf)
+{
+    if (conf->ext_mem_blocks == NULL) {
+        conf->ext_mem_blocks_used = 0;
+        conf->ext_mem_blocks_deleted = 0;
+        conf->ext_mem_blocks = conf->ext_alloc_mem_blocks(conf->ext_mem_blocks, &conf->ext_mem_blocks_count);
+        if (conf->ext_mem_blocks == NULL || conf->ext_mem_blocks_count == 0) {
+            return -1;
+        }
+        memset(conf->ext_mem_blocks, 0, conf->ext_mem_blocks_count * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
     }
 
-    for (uint32_t index = 0; index < start_index; index++) {
-        if (conf->ext_mem_blocks[index].caller_addr == NULL) {
-            *free_index = index;
-            return 0;
+    // Load factor below 3/4 including deleted entries
+    uint32_t count = conf->ext_mem_blocks_count;
+    if ((uint64_t)(conf->ext_mem_blocks_used + conf->ext_mem_blocks_deleted + 1) * 4 <= (uint64_t) count * 3) {
+        return 0;
+    }
+
+    // Grows the table if more than half of it would still be in use after
+    // removing deleted entries, otherwise rehashes in place
+    if ((uint64_t)(conf->ext_mem_blocks_used + 1) * 2 > count) {
+        uint32_t new_count = count;
+        ns_dyn_mem_tracker_lib_mem_blocks_ext_t *ext_mem_blocks = conf->ext_alloc_mem_blocks(conf->ext_mem_blocks, &new_count);
+        if (ext_mem_blocks == NULL) {
+            // Keeps using old array until it is full
+            if (conf->ext_mem_blocks_deleted > 0) {
+                ns_dyn_mem_tracker_lib_ext_rehash(conf);
+            }
+            return conf->ext_mem_blocks_used < count ? 0 : -1;
         }
+        conf->ext_mem_blocks = ext_mem_blocks;
+        if (new_count > count) {
+            memset(&conf->ext_mem_blocks[count], 0, (new_count - count) * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+        }
+        conf->ext_mem_blocks_count = new_count;
     }
 
-    return -1;
+    ns_dyn_mem_tracker_lib_ext_rehash(conf);
+
+    return 0;
 }
 
-static int8_t ns_dyn_mem_tracker_lib_ext_find_block_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block, uint32_t start_index, uint32_t *block_index)
+static void ns_dyn_mem_tracker_lib_ext_rehash(ns_dyn_mem_tracker_lib_conf_t *conf)
 {
-    for (uint32_t index = start_index; index < conf->ext_mem_blocks_count; index++) {
-        if (conf->ext_mem_blocks[index].block == block) {
-            *block_index = index;
-            return 0;
+    uint32_t count = conf->ext_mem_blocks_count;
+
+    // Removes deleted entries
+    for (uint32_t index = 0; index < count; index++) {
+        if (conf->ext_mem_blocks[index].caller_addr == EXT_BLOCK_DELETED) {
+            conf->ext_mem_blocks[index].caller_addr = NULL;
         }
     }
+    conf->ext_mem_blocks_deleted = 0;
 
-    if (start_index == 0) {
-        return -1;
+    // Marks live entries to be rehashed by setting the lowest bit of the
+    // block address (memory blocks are always at least 2 byte aligned)
+    for (uint32_t index = 0; index < count; index++) {
+        if (conf->ext_mem_blocks[index].caller_addr != NULL) {
+            conf->ext_mem_blocks[index].block = (void *)((uintptr_t) conf->ext_mem_blocks[index].block | 1);
+        }
+    }
+
+    // Takes each marked entry and places it to first empty or marked entry on
+    // its probe sequence. If entry was marked, continues with that entry.
+    // Placed entries are not moved again so each entry is placed only once.
+    for (uint32_t index = 0; index < count; index++) {
+        if (conf->ext_mem_blocks[index].caller_addr == NULL || !((uintptr_t) conf->ext_mem_blocks[index].block & 1)) {
+            continue;
+        }
+        ns_dyn_mem_tracker_lib_mem_blocks_ext_t entry = conf->ext_mem_blocks[index];
+        memset(&conf->ext_mem_blocks[index], 0, sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+
+        while (entry.caller_addr != NULL) {
+            entry.block = (void *)((uintptr_t) entry.block & ~(uintptr_t) 1);
+            uint32_t probe_index = ns_dyn_mem_tracker_lib_ext_start_index(conf, entry.block);
+            while (conf->ext_mem_blocks[probe_index].caller_addr != NULL && !((uintptr_t) conf->ext_mem_blocks[probe_index].block & 1)) {
+                if (++probe_index >= count) {
+                    probe_index = 0;
+                }
+            }
+            ns_dyn_mem_tracker_lib_mem_blocks_ext_t displaced = conf->ext_mem_blocks[probe_index];
+            conf->ext_mem_blocks[probe_index] = entry;
+            entry = displaced;
+        }
+    }
+
+    conf->ext_rehash_count++;
+}
+
+static void ns_dyn_mem_tracker_lib_ext_probe_stats_update(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t probes)
+{
+    conf->ext_lookups++;
+    conf->ext_probes += probes;
+    if (probes > conf->ext_max_probe_length) {
+        conf->ext_max_probe_length = probes;
+    }
+}
+
+static int8_t ns_dyn_mem_tracker_lib_ext_find_free_index(ns_dyn_mem_tracker_lib_conf_t *conf, uint32_t start_index, uint32_t *free_index)
+{
+    uint32_t index = start_index;
+
+    // Empty and deleted entries are free
+    for (uint32_t probes = 1; probes <= conf->ext_mem_blocks_count; probes++) {
+        if (conf->ext_mem_blocks[index].block == NULL) {
+            ns_dyn_mem_tracker_lib_ext_probe_stats_update(conf, probes);
+            *free_index = index;
+            return 0;
+        }
+        if (++index >= conf->ext_mem_blocks_count) {
+            index = 0;
+        }
     }
 
-    for (uint32_t index = 0; index < start_index; index++) {
+    ns_dyn_mem_tracker_lib_ext_probe_stats_update(conf, conf->ext_mem_blocks_count);
+    return -1;
+}
+
+static int8_t ns_dyn_mem_tracker_lib_ext_find_block_index(ns_dyn_mem_tracker_lib_conf_t *conf, void *block, uint32_t start_index, uint32_t *block_index)
+{
+    uint32_t index = start_index;
+
+    // Probe sequence ends on empty entry, deleted entries are skipped
+    for (uint32_t probes = 1; probes <= conf->ext_mem_blocks_count; probes++) {
         if (conf->ext_mem_blocks[index].block == block) {
+            ns_dyn_mem_tracker_lib_ext_probe_stats_update(conf, probes);
             *block_index = index;
             return 0;
         }
+        if (conf->ext_mem_blocks[index].caller_addr == NULL) {
+            ns_dyn_mem_tracker_lib_ext_probe_stats_update(conf, probes);
+            return -1;
+        }
+        if (++index >= conf->ext_mem_blocks_count) {
+            index = 0;
+        }
     }
 
+    ns_dyn_mem_tracker_lib_ext_probe_stats_update(conf, conf->ext_mem_blocks_count);
     return -1;
 }
 
@@ -32,27 +32,126 @@
 #define NS_NVM_KEY_WRITE    0x04
 #define NS_NVM_FLUSH        0x05
 #define NS_NVM_KEY_DELETE   0x06
+#define NS_NVM_SYNC         0x07
+#define NS_NVM_BATCH_COMMIT 0x08
+#define NS_NVM_KEY_UPDATE   0x09    /* Write to a key known to exist, without create */
 
-typedef struct {
+/* Default number of created keys remembered, 0 disables the index */
+#ifndef NS_NVM_HELPER_KEY_INDEX_SIZE
+#define NS_NVM_HELPER_KEY_INDEX_SIZE 8
+#endif
+
+/* Number of higher priority requests started before a waiting request is raised one priority level */
+#ifndef NS_NVM_HELPER_PRIORITY_AGING
+#define NS_NVM_HELPER_PRIORITY_AGING 4
+#endif
+
+typedef struct ns_nvm_request {
     ns_nvm_callback *callback;
     const char *client_key_name;
     void *client_context;
     int operation;
     uint8_t *buffer;
     uint16_t *buffer_len;
+    uint16_t buffer_size;
+    uint16_t read_cache_generation;
+    int status;
+    bool batch;
+    uint8_t priority;   /* Raised while waiting, see NS_NVM_HELPER_PRIORITY_AGING */
+    uint8_t age;
+    struct ns_nvm_request *superseded;  /* Pending write or delete replaced by this request, completed with it */
     void *original_request;
     ns_list_link_t link;
 } ns_nvm_request_t;
 
+/* Read cache entry, allocated together with the data and the key name */
+typedef struct {
+    const char *key_name;
+    uint16_t len;
+    bool complete;      /* Data is known to be complete, not limited by read buffer length */
+    ns_list_link_t link;
+    uint8_t data[];
+} ns_nvm_read_cache_t;
+
+/* Key created by this module, allocated together with the key name */
+typedef struct {
+    uint16_t len;       /* Value length the key was created with */
+    ns_list_link_t link;
+    char key_name[];
+} ns_nvm_key_index_t;
+
+struct ns_nvm_write_back;
+
+/* Cached data, allocated together with the data */
+typedef struct {
+    struct ns_nvm_write_back *entry;
+    uint16_t len;
+    uint8_t data[];
+} ns_nvm_write_back_data_t;
+
+/* Write-back cache entry, allocated together with the key name */
+typedef struct ns_nvm_write_back {
+    ns_nvm_write_back_data_t *data;         /* Data waiting to be written, NULL if none */
+    ns_nvm_write_back_data_t *flush_data;   /* Latest data being written, NULL if none */
+    uint32_t delay_left;
+    uint8_t flush_count;
+    ns_list_link_t link;
+    char key_name[];
+} ns_nvm_write_back_t;
+
 static bool ns_nvm_initialized = false;
-static bool ns_nvm_operation_in_progress = false;
+static ns_nvm_request_t *ns_nvm_request_pool = NULL;
+static uint8_t ns_nvm_request_pool_size = 0;
+static bool ns_nvm_pending_processing = false;
+static uint8_t ns_nvm_operations_in_flight = 0;
+static uint8_t ns_nvm_in_flight_depth = 1;
+static bool ns_nvm_batch_open = false;
+
+static uint32_t ns_nvm_write_back_delay = 0;
+static uint8_t ns_nvm_write_back_max_entries = 0;
+static uint8_t ns_nvm_write_back_entries = 0;
+static int ns_nvm_write_back_status = NS_NVM_OK;
+
+static uint8_t ns_nvm_key_index_max_entries = NS_NVM_HELPER_KEY_INDEX_SIZE;
+static uint8_t ns_nvm_key_index_entries = 0;
+
+static uint8_t ns_nvm_read_cache_max_entries = 0;
+static uint8_t ns_nvm_read_cache_entries = 0;
+static uint16_t ns_nvm_read_cache_generation = 0;
+static ns_nvm_read_cache_statistics_t ns_nvm_read_cache_stats = {0, 0};
 
 static ns_nvm_request_t *ns_nvm_create_request(ns_nvm_callback *callback, void *context, const char *key_name, uint8_t *buf, uint16_t *buf_len, uint8_t operation);
+static void ns_nvm_request_free(ns_nvm_request_t *request);
 static int ns_nvm_operation_start(ns_nvm_request_t *request);
 static int ns_nvm_operation_continue(ns_nvm_request_t *request, bool free_request);
 static void ns_nvm_operation_end(ns_nvm_request_t *ns_nvm_request_ptr, int client_retval);
+static bool ns_nvm_operation_can_start(const ns_nvm_request_t *request);
+static void ns_nvm_pending_requests_process(void);
+static void ns_nvm_pending_requests_supersede(ns_nvm_request_t *request);
+static void ns_nvm_superseded_requests_end(ns_nvm_request_t *request, int client_retval);
+static ns_nvm_write_back_t *ns_nvm_write_back_find(const char *key_name);
+static int ns_nvm_write_back_store(const char *key_name, const uint8_t *buf, uint16_t len);
+static void ns_nvm_write_back_drop(ns_nvm_write_back_t *entry);
+static void ns_nvm_write_back_release(ns_nvm_write_back_t *entry);
+static void ns_nvm_write_back_flush(ns_nvm_write_back_t *entry);
+static void ns_nvm_write_back_callback(int status, void *context);
+static ns_nvm_read_cache_t *ns_nvm_read_cache_find(const char *key_name);
+static void ns_nvm_read_cache_store(ns_nvm_request_t *request);
+static void ns_nvm_read_cache_invalidate(const char *key_name);
+static void ns_nvm_read_cache_remove(ns_nvm_read_cache_t *entry);
+static void ns_nvm_batch_end(ns_nvm_request_t *commit_request, int flush_status);
+static ns_nvm_key_index_t *ns_nvm_key_index_find(const char *key_name);
+static void ns_nvm_key_index_store(const char *key_name, uint16_t len);
+static void ns_nvm_key_index_remove(const char *key_name);
+static void ns_nvm_key_index_entry_remove(ns_nvm_key_index_t *entry);
 
 static NS_LIST_DEFINE(ns_nvm_request_list, ns_nvm_request_t, link);
+static NS_LIST_DEFINE(ns_nvm_request_pool_list, ns_nvm_request_t, link);
+static NS_LIST_DEFINE(ns_nvm_in_flight_list, ns_nvm_request_t, link);
+static NS_LIST_DEFINE(ns_nvm_batch_list, ns_nvm_request_t, link);
+static NS_LIST_DEFINE(ns_nvm_write_back_list, ns_nvm_write_back_t, link);
+static NS_LIST_DEFINE(ns_nvm_read_cache_list, ns_nvm_read_cache_t, link);
+static NS_LIST_DEFINE(ns_nvm_key_index_list, ns_nvm_key_index_t, link);
 
 /*
  * Callback from platform NVM adaptation
@@ -70,29 +169,59 @@ void ns_nvm_callback_func(platform_nvm_status status, void *args)
 
     switch (ns_nvm_request_ptr->operation) {
         case NS_NVM_INIT:
+            ns_list_remove(&ns_nvm_in_flight_list, ns_nvm_request_ptr);
+            ns_nvm_operations_in_flight--;
             ns_nvm_operation_continue(ns_nvm_request_ptr->original_request, true);
-            ns_dyn_mem_free(ns_nvm_request_ptr);
+            ns_nvm_request_free(ns_nvm_request_ptr);
+            ns_nvm_pending_requests_process();
             break;
-        case NS_NVM_FLUSH:
         case NS_NVM_KEY_READ:
+            if (status == PLATFORM_NVM_OK) {
+                ns_nvm_read_cache_store(ns_nvm_request_ptr);
+            } else if (status == PLATFORM_NVM_KEY_NOT_FOUND) {
+                ns_nvm_key_index_remove(ns_nvm_request_ptr->client_key_name);
+            }
+            ns_nvm_operation_end(ns_nvm_request_ptr, client_retval);
+            break;
+        case NS_NVM_FLUSH:
             ns_nvm_operation_end(ns_nvm_request_ptr, client_retval);
             break;
+        case NS_NVM_BATCH_COMMIT:
+            ns_nvm_batch_end(ns_nvm_request_ptr, client_retval);
+            break;
         case NS_NVM_KEY_CREATE:
             if (status == PLATFORM_NVM_OK) {
+                ns_nvm_key_index_store(ns_nvm_request_ptr->client_key_name, *ns_nvm_request_ptr->buffer_len);
                 ns_nvm_request_ptr->operation = NS_NVM_KEY_WRITE;
                 platform_nvm_write(ns_nvm_callback_func, ns_nvm_request_ptr->client_key_name, ns_nvm_request_ptr->buffer, ns_nvm_request_ptr->buffer_len, ns_nvm_request_ptr);
             } else {
                 ns_nvm_operation_end(ns_nvm_request_ptr, client_retval);
             }
             break;
+        case NS_NVM_KEY_UPDATE:
+            if (status == PLATFORM_NVM_KEY_NOT_FOUND) {
+                // key has been removed outside of this module, create it again
+                ns_nvm_key_index_remove(ns_nvm_request_ptr->client_key_name);
+                ns_nvm_request_ptr->operation = NS_NVM_KEY_CREATE;
+                if (platform_nvm_key_create(ns_nvm_callback_func, ns_nvm_request_ptr->client_key_name, *ns_nvm_request_ptr->buffer_len, 0, ns_nvm_request_ptr) != PLATFORM_NVM_OK) {
+                    ns_nvm_operation_end(ns_nvm_request_ptr, NS_NVM_ERROR);
+                }
+                break;
+            }
+        /* fall through */
         case NS_NVM_KEY_DELETE:
         case NS_NVM_KEY_WRITE:
-            if (status == PLATFORM_NVM_OK) {
+            if (status != PLATFORM_NVM_OK || ns_nvm_request_ptr->operation == NS_NVM_KEY_DELETE) {
+                // key is deleted, or key state is not known after failed write. Key may
+                // have been stored to the index by a write completed after the delete request.
+                ns_nvm_key_index_remove(ns_nvm_request_ptr->client_key_name);
+            }
+            if (status == PLATFORM_NVM_OK && !ns_nvm_request_ptr->batch) {
                 // write ok, flush the changes
                 ns_nvm_request_ptr->operation = NS_NVM_FLUSH;
                 platform_nvm_flush(ns_nvm_callback_func, ns_nvm_request_ptr);
             } else {
-                // write failed, inform client
+                // write failed or batch member flushed on commit, inform client
                 ns_nvm_operation_end(ns_nvm_request_ptr, client_retval);
             }
             break;
@@ -101,31 +230,448 @@ void ns_nvm_callback_func(platform_nvm_status status, void *args)
 
 int ns_nvm_key_delete(ns_nvm_callback *callback, const char *key_name, void *context)
 {
-    if (!callback || !key_name) {
+    return ns_nvm_key_delete_prio(callback, key_name, context, NS_NVM_PRIORITY_NORMAL);
+}
+
+int ns_nvm_key_delete_prio(ns_nvm_callback *callback, const char *key_name, void *context, ns_nvm_priority_t priority)
+{
+    if ((!callback && !ns_nvm_batch_open) || !key_name) {
         return NS_NVM_ERROR;
     }
+    ns_nvm_read_cache_invalidate(key_name);
+    ns_nvm_key_index_remove(key_name);
+    ns_nvm_write_back_t *entry = ns_nvm_write_back_find(key_name);
+    if (entry) {
+        // cached data is superseded by the delete
+        ns_nvm_write_back_drop(entry);
+    }
     ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(callback, context, key_name, NULL, NULL, NS_NVM_KEY_DELETE);
+    if (ns_nvm_request_ptr) {
+        ns_nvm_request_ptr->batch = ns_nvm_batch_open;
+        ns_nvm_request_ptr->priority = priority;
+    }
     return ns_nvm_operation_start(ns_nvm_request_ptr);
 }
 
 int ns_nvm_data_read(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context)
+{
+    return ns_nvm_data_read_prio(callback, key_name, buf, buf_len, context, NS_NVM_PRIORITY_NORMAL);
+}
+
+int ns_nvm_data_read_prio(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context, ns_nvm_priority_t priority)
 {
     if (!callback || !key_name || !buf || !buf_len) {
         return NS_NVM_ERROR;
     }
+    ns_nvm_write_back_t *entry = ns_nvm_write_back_find(key_name);
+    if (entry) {
+        ns_nvm_write_back_data_t *wb_data = entry->data ? entry->data : entry->flush_data;
+        if (wb_data) {
+            // latest data is in cache
+            if (*buf_len > wb_data->len) {
+                *buf_len = wb_data->len;
+            }
+            memcpy(buf, wb_data->data, *buf_len);
+            callback(NS_NVM_OK, context);
+            return NS_NVM_OK;
+        }
+    }
+    if (ns_nvm_read_cache_max_entries > 0) {
+        ns_nvm_read_cache_t *cache_entry = ns_nvm_read_cache_find(key_name);
+        if (cache_entry && (cache_entry->complete || *buf_len <= cache_entry->len)) {
+            // most recently used entry first
+            ns_list_remove(&ns_nvm_read_cache_list, cache_entry);
+            ns_list_add_to_start(&ns_nvm_read_cache_list, cache_entry);
+            ns_nvm_read_cache_stats.hits++;
+            if (*buf_len > cache_entry->len) {
+                *buf_len = cache_entry->len;
+            }
+            memcpy(buf, cache_entry->data, *buf_len);
+            callback(NS_NVM_OK, context);
+            return NS_NVM_OK;
+        }
+        ns_nvm_read_cache_stats.misses++;
+    }
     ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(callback, context, key_name, buf, buf_len, NS_NVM_KEY_READ);
+    if (ns_nvm_request_ptr) {
+        ns_nvm_request_ptr->buffer_size = *buf_len;
+        ns_nvm_request_ptr->priority = priority;
+    }
     return ns_nvm_operation_start(ns_nvm_request_ptr);
 }
 
 int ns_nvm_data_write(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context)
 {
-    if (!callback || !key_name || !buf || !buf_len) {
+    return ns_nvm_data_write_prio(callback, key_name, buf, buf_len, context, NS_NVM_PRIORITY_NORMAL);
+}
+
+int ns_nvm_data_write_prio(ns_nvm_callback *callback, const char *key_name, uint8_t *buf, uint16_t *buf_len, void *context, ns_nvm_priority_t priority)
+{
+    if ((!callback && !ns_nvm_batch_open) || !key_name || !buf || !buf_len) {
         return NS_NVM_ERROR;
     }
+    ns_nvm_read_cache_invalidate(key_name);
+    if (ns_nvm_batch_open) {
+        // batch members are written directly, cached data is superseded
+        ns_nvm_write_back_t *entry = ns_nvm_write_back_find(key_name);
+        if (entry) {
+            ns_nvm_write_back_drop(entry);
+        }
+    } else if (ns_nvm_write_back_max_entries > 0 || !ns_list_is_empty(&ns_nvm_write_back_list)) {
+        if (ns_nvm_write_back_store(key_name, buf, *buf_len) == NS_NVM_OK) {
+            callback(NS_NVM_OK, context);
+            return NS_NVM_OK;
+        }
+        // cache full or disabled, write directly to NVM
+    }
     ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(callback, context, key_name, buf, buf_len, NS_NVM_KEY_WRITE);
+    if (ns_nvm_request_ptr) {
+        ns_nvm_request_ptr->batch = ns_nvm_batch_open;
+        ns_nvm_request_ptr->priority = priority;
+    }
+    return ns_nvm_operation_start(ns_nvm_request_ptr);
+}
+
+int ns_nvm_batch_begin(void)
+{
+    if (ns_nvm_batch_open) {
+        return NS_NVM_ERROR;
+    }
+    ns_nvm_batch_open = true;
+    return NS_NVM_OK;
+}
+
+int ns_nvm_batch_commit(ns_nvm_callback *callback, void *context)
+{
+    if (!callback || !ns_nvm_batch_open) {
+        return NS_NVM_ERROR;
+    }
+    ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(callback, context, NULL, NULL, NULL, NS_NVM_BATCH_COMMIT);
+    if (!ns_nvm_request_ptr) {
+        // batch stays open, commit can be retried
+        return NS_NVM_MEMORY;
+    }
+    ns_nvm_batch_open = false;
+    // flush is made after all batch members queued before the commit
+    int ret = ns_nvm_operation_start(ns_nvm_request_ptr);
+    if (ret != NS_NVM_OK) {
+        ns_nvm_batch_open = true;
+    }
+    return ret;
+}
+
+static void ns_nvm_batch_end(ns_nvm_request_t *commit_request, int flush_status)
+{
+    int batch_status = flush_status;
+
+    ns_list_foreach_safe(ns_nvm_request_t, member, &ns_nvm_batch_list) {
+        ns_list_remove(&ns_nvm_batch_list, member);
+        int member_status = member->status;
+        if (member_status == NS_NVM_OK) {
+            // written data is not persistent if flush failed
+            member_status = flush_status;
+        } else if (batch_status == NS_NVM_OK) {
+            batch_status = member_status;
+        }
+        if (member->callback) {
+            member->callback(member_status, member->client_context);
+        }
+        ns_nvm_request_free(member);
+    }
+
+    ns_nvm_operation_end(commit_request, batch_status);
+}
+
+void ns_nvm_in_flight_depth_set(uint8_t depth)
+{
+    ns_nvm_in_flight_depth = depth ? depth : 1;
+    if (ns_nvm_initialized) {
+        ns_nvm_pending_requests_process();
+    }
+}
+
+void ns_nvm_write_back_set(uint32_t delay, uint8_t max_entries)
+{
+    ns_nvm_write_back_delay = delay;
+    ns_nvm_write_back_max_entries = max_entries;
+}
+
+void ns_nvm_write_back_timer(uint32_t ticks)
+{
+    ns_list_foreach_safe(ns_nvm_write_back_t, entry, &ns_nvm_write_back_list) {
+        if (!entry->data) {
+            continue;
+        }
+        if (entry->delay_left > ticks) {
+            entry->delay_left -= ticks;
+            continue;
+        }
+        entry->delay_left = 0;
+        ns_nvm_write_back_flush(entry);
+    }
+}
+
+int ns_nvm_sync(ns_nvm_callback *callback, void *context)
+{
+    if (!callback) {
+        return NS_NVM_ERROR;
+    }
+    ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(callback, context, NULL, NULL, NULL, NS_NVM_SYNC);
+    if (!ns_nvm_request_ptr) {
+        return NS_NVM_MEMORY;
+    }
+    ns_list_foreach_safe(ns_nvm_write_back_t, entry, &ns_nvm_write_back_list) {
+        if (entry->data) {
+            ns_nvm_write_back_flush(entry);
+        }
+    }
+    // completes when the flushes queued above have been completed
     return ns_nvm_operation_start(ns_nvm_request_ptr);
 }
 
+static ns_nvm_write_back_t *ns_nvm_write_back_find(const char *key_name)
+{
+    ns_list_foreach(ns_nvm_write_back_t, entry, &ns_nvm_write_back_list) {
+        if (strcmp(entry->key_name, key_name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int ns_nvm_write_back_store(const char *key_name, const uint8_t *buf, uint16_t len)
+{
+    ns_nvm_write_back_t *entry = ns_nvm_write_back_find(key_name);
+    if (!entry) {
+        if (ns_nvm_write_back_entries >= ns_nvm_write_back_max_entries) {
+            return NS_NVM_ERROR;
+        }
+        size_t key_len = strlen(key_name) + 1;
+        entry = ns_dyn_mem_alloc(sizeof(ns_nvm_write_back_t) + key_len);
+        if (!entry) {
+            return NS_NVM_MEMORY;
+        }
+        memset(entry, 0, sizeof(ns_nvm_write_back_t));
+        memcpy(entry->key_name, key_name, key_len);
+        ns_list_add_to_end(&ns_nvm_write_back_list, entry);
+        ns_nvm_write_back_entries++;
+    } else if (ns_nvm_write_back_max_entries == 0) {
+        // cache disabled, data is written directly so cached data is superseded
+        ns_nvm_write_back_drop(entry);
+        return NS_NVM_ERROR;
+    }
+
+    ns_nvm_write_back_data_t *wb_data = entry->data;
+    if (!wb_data || wb_data->len != len) {
+        wb_data = ns_dyn_mem_alloc(sizeof(ns_nvm_write_back_data_t) + len);
+        if (!wb_data) {
+            ns_nvm_write_back_drop(entry);
+            return NS_NVM_MEMORY;
+        }
+        wb_data->entry = entry;
+        wb_data->len = len;
+        if (entry->data) {
+            ns_dyn_mem_free(entry->data);
+        } else {
+            // delay is counted from the first write after previous flush
+            entry->delay_left = ns_nvm_write_back_delay;
+        }
+        entry->data = wb_data;
+    }
+    memcpy(wb_data->data, buf, len);
+
+    return NS_NVM_OK;
+}
+
+static void ns_nvm_write_back_drop(ns_nvm_write_back_t *entry)
+{
+    if (entry->data) {
+        ns_dyn_mem_free(entry->data);
+        entry->data = NULL;
+    }
+    // data being written is not retried or read from cache anymore
+    entry->flush_data = NULL;
+    ns_nvm_write_back_release(entry);
+}
+
+static void ns_nvm_write_back_release(ns_nvm_write_back_t *entry)
+{
+    if (!entry->data && entry->flush_count == 0) {
+        ns_list_remove(&ns_nvm_write_back_list, entry);
+        ns_dyn_mem_free(entry);
+        ns_nvm_write_back_entries--;
+    }
+}
+
+static void ns_nvm_write_back_flush(ns_nvm_write_back_t *entry)
+{
+    ns_nvm_write_back_data_t *wb_data = entry->data;
+    ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(ns_nvm_write_back_callback, wb_data, entry->key_name, wb_data->data, &wb_data->len, NS_NVM_KEY_WRITE);
+
+    entry->data = NULL;
+    entry->flush_data = wb_data;
+    entry->flush_count++;
+    if (ns_nvm_operation_start(ns_nvm_request_ptr) != NS_NVM_OK) {
+        // keep data, write is retried on next timer or sync
+        entry->data = wb_data;
+        entry->flush_data = NULL;
+        entry->flush_count--;
+        ns_nvm_write_back_status = NS_NVM_ERROR;
+    }
+}
+
+static void ns_nvm_write_back_callback(int status, void *context)
+{
+    ns_nvm_write_back_data_t *wb_data = context;
+    ns_nvm_write_back_t *entry = wb_data->entry;
+
+    entry->flush_count--;
+    if (status != NS_NVM_OK) {
+        ns_nvm_write_back_status = NS_NVM_ERROR;
+        if (!entry->data && entry->flush_data == wb_data) {
+            // no newer data, retry later
+            entry->data = wb_data;
+            entry->flush_data = NULL;
+            entry->delay_left = ns_nvm_write_back_delay;
+            return;
+        }
+    }
+    if (entry->flush_data == wb_data) {
+        entry->flush_data = NULL;
+    }
+    ns_dyn_mem_free(wb_data);
+    ns_nvm_write_back_release(entry);
+}
+
+void ns_nvm_read_cache_set(uint8_t max_entries)
+{
+    ns_nvm_read_cache_max_entries = max_entries;
+    while (ns_nvm_read_cache_entries > max_entries) {
+        ns_nvm_read_cache_remove(ns_list_get_last(&ns_nvm_read_cache_list));
+    }
+}
+
+void ns_nvm_read_cache_statistics_get(ns_nvm_read_cache_statistics_t *statistics)
+{
+    *statistics = ns_nvm_read_cache_stats;
+}
+
+static ns_nvm_read_cache_t *ns_nvm_read_cache_find(const char *key_name)
+{
+    ns_list_foreach(ns_nvm_read_cache_t, entry, &ns_nvm_read_cache_list) {
+        if (strcmp(entry->key_name, key_name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void ns_nvm_read_cache_store(ns_nvm_request_t *request)
+{
+    // key may have been written or deleted while reading
+    if (ns_nvm_read_cache_max_entries == 0 || request->read_cache_generation != ns_nvm_read_cache_generation) {
+        return;
+    }
+
+    ns_nvm_read_cache_t *entry = ns_nvm_read_cache_find(request->client_key_name);
+    if (entry) {
+        ns_nvm_read_cache_remove(entry);
+    }
+
+    uint16_t len = *request->buffer_len;
+    size_t key_len = strlen(request->client_key_name) + 1;
+    entry = ns_dyn_mem_alloc(sizeof(ns_nvm_read_cache_t) + len + key_len);
+    if (!entry) {
+        return;
+    }
+    entry->key_name = (char *) &entry->data[len];
+    memcpy((char *) entry->key_name, request->client_key_name, key_len);
+    memcpy(entry->data, request->buffer, len);
+    entry->len = len;
+    entry->complete = len < request->buffer_size;
+
+    // evict least recently used entry
+    if (ns_nvm_read_cache_entries >= ns_nvm_read_cache_max_entries) {
+        ns_nvm_read_cache_remove(ns_list_get_last(&ns_nvm_read_cache_list));
+    }
+    ns_list_add_to_start(&ns_nvm_read_cache_list, entry);
+    ns_nvm_read_cache_entries++;
+}
+
+static void ns_nvm_read_cache_invalidate(const char *key_name)
+{
+    ns_nvm_read_cache_generation++;
+    ns_nvm_read_cache_t *entry = ns_nvm_read_cache_find(key_name);
+    if (entry) {
+        ns_nvm_read_cache_remove(entry);
+    }
+}
+
+static void ns_nvm_read_cache_remove(ns_nvm_read_cache_t *entry)
+{
+    ns_list_remove(&ns_nvm_read_cache_list, entry);
+    ns_dyn_mem_free(entry);
+    ns_nvm_read_cache_entries--;
+}
+
+void ns_nvm_key_index_set(uint8_t max_entries)
+{
+    ns_nvm_key_index_max_entries = max_entries;
+    while (ns_nvm_key_index_entries > max_entries) {
+        ns_nvm_key_index_entry_remove(ns_list_get_last(&ns_nvm_key_index_list));
+    }
+}
+
+static ns_nvm_key_index_t *ns_nvm_key_index_find(const char *key_name)
+{
+    ns_list_foreach(ns_nvm_key_index_t, entry, &ns_nvm_key_index_list) {
+        if (strcmp(entry->key_name, key_name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void ns_nvm_key_index_store(const char *key_name, uint16_t len)
+{
+    ns_nvm_key_index_t *entry = ns_nvm_key_index_find(key_name);
+    if (entry) {
+        ns_list_remove(&ns_nvm_key_index_list, entry);
+    } else {
+        if (ns_nvm_key_index_max_entries == 0) {
+            return;
+        }
+        size_t key_len = strlen(key_name) + 1;
+        entry = ns_dyn_mem_alloc(sizeof(ns_nvm_key_index_t) + key_len);
+        if (!entry) {
+            return;
+        }
+        memcpy(entry->key_name, key_name, key_len);
+        // forget least recently written key
+        if (ns_nvm_key_index_entries >= ns_nvm_key_index_max_entries) {
+            ns_nvm_key_index_entry_remove(ns_list_get_last(&ns_nvm_key_index_list));
+        }
+        ns_nvm_key_index_entries++;
+    }
+    entry->len = len;
+    ns_list_add_to_start(&ns_nvm_key_index_list, entry);
+}
+
+static void ns_nvm_key_index_remove(const char *key_name)
+{
+    ns_nvm_key_index_t *entry = ns_nvm_key_index_find(key_name);
+    if (entry) {
+        ns_nvm_key_index_entry_remove(entry);
+    }
+}
+
+static void ns_nvm_key_index_entry_remove(ns_nvm_key_index_t *entry)
+{
+    ns_list_remove(&ns_nvm_key_index_list, entry);
+    ns_dyn_mem_free(entry);
+    ns_nvm_key_index_entries--;
+}
+
 static int ns_nvm_operation_start(ns_nvm_request_t *nvm_request)
 {
     int ret = NS_NVM_OK;
@@ -135,39 +681,81 @@ static int ns_nvm_operation_start(ns_nvm_request_t *nvm_request)
         return NS_NVM_MEMORY;
     }
     if (ns_nvm_initialized == true) {
-        // NVM already initialized, continue directly
-        if (!ns_nvm_operation_in_progress) {
+        // NVM already initialized, continue directly if no other request is waiting
+        if (!ns_nvm_pending_processing && ns_list_is_empty(&ns_nvm_request_list) && ns_nvm_operation_can_start(nvm_request)) {
             ret = ns_nvm_operation_continue(nvm_request, true);
         } else {
-            // add request to list and handle when existing calls has been handled.
+            // add request to list, pending requests are started in priority order
+            // also when the request is made from a completion callback
+            ns_nvm_pending_requests_supersede(nvm_request);
             ns_list_add_to_end(&ns_nvm_request_list, nvm_request);
+            ns_nvm_pending_requests_process();
         }
     } else {
         ns_nvm_request_t *ns_nvm_request_ptr = ns_nvm_create_request(NULL, NULL, NULL, NULL, NULL, NS_NVM_INIT);
         if (!ns_nvm_request_ptr) {
-            ns_dyn_mem_free(nvm_request);
-            ns_dyn_mem_free(ns_nvm_request_ptr);
+            ns_nvm_request_free(nvm_request);
+            ns_nvm_request_free(ns_nvm_request_ptr);
             return NS_NVM_MEMORY;
         }
         ns_nvm_request_ptr->original_request = nvm_request;
+        ns_list_init(&ns_nvm_request_list);
+        ns_nvm_initialized = true;
+        // initialization blocks other requests until original request has been started,
+        // added before the call as platform may complete the initialization synchronously
+        ns_list_add_to_end(&ns_nvm_in_flight_list, ns_nvm_request_ptr);
+        ns_nvm_operations_in_flight++;
         pnvm_status = platform_nvm_init(ns_nvm_callback_func, ns_nvm_request_ptr);
         if (pnvm_status != PLATFORM_NVM_OK) {
-            ns_dyn_mem_free(nvm_request);
-            ns_dyn_mem_free(ns_nvm_request_ptr);
+            ns_list_remove(&ns_nvm_in_flight_list, ns_nvm_request_ptr);
+            ns_nvm_operations_in_flight--;
+            ns_nvm_initialized = false;
+            ns_nvm_request_free(nvm_request);
+            ns_nvm_request_free(ns_nvm_request_ptr);
             return NS_NVM_ERROR;
         }
-        ns_list_init(&ns_nvm_request_list);
-        ns_nvm_initialized = true;
-        ns_nvm_operation_in_progress = true;
     }
     return ret;
 }
 
+int ns_nvm_request_pool_init(uint8_t count)
+{
+    if (count == 0) {
+        // pool can be released when all requests have been returned
+        if (ns_list_count(&ns_nvm_request_pool_list) != ns_nvm_request_pool_size) {
+            return NS_NVM_ERROR;
+        }
+        ns_list_init(&ns_nvm_request_pool_list);
+        ns_dyn_mem_free(ns_nvm_request_pool);
+        ns_nvm_request_pool = NULL;
+        ns_nvm_request_pool_size = 0;
+        return NS_NVM_OK;
+    }
+    if (ns_nvm_request_pool) {
+        return NS_NVM_ERROR;
+    }
+    ns_nvm_request_pool = ns_dyn_mem_alloc(count * sizeof(ns_nvm_request_t));
+    if (!ns_nvm_request_pool) {
+        return NS_NVM_MEMORY;
+    }
+    ns_nvm_request_pool_size = count;
+    for (uint8_t i = 0; i < count; i++) {
+        ns_list_add_to_end(&ns_nvm_request_pool_list, &ns_nvm_request_pool[i]);
+    }
+    return NS_NVM_OK;
+}
+
 static ns_nvm_request_t *ns_nvm_create_request(ns_nvm_callback *callback, void *context, const char *key_name, uint8_t *buf, uint16_t *buf_len, uint8_t operation)
 {
-    ns_nvm_request_t *ns_nvm_request_ptr = ns_dyn_mem_temporary_alloc(sizeof(ns_nvm_request_t));
-    if (!ns_nvm_request_ptr) {
-        return NULL;
+    ns_nvm_request_t *ns_nvm_request_ptr = ns_list_get_first(&ns_nvm_request_pool_list);
+    if (ns_nvm_request_ptr) {
+        ns_list_remove(&ns_nvm_request_pool_list, ns_nvm_request_ptr);
+    } else {
+        // pool not initialized or exhausted
+        ns_nvm_request_ptr = ns_dyn_mem_temporary_alloc(sizeof(ns_nvm_request_t));
+        if (!ns_nvm_request_ptr) {
+            return NULL;
+        }
     }
     ns_nvm_request_ptr->client_context = context;
     ns_nvm_request_ptr->callback = callback;
@@ -175,34 +763,86 @@ static ns_nvm_request_t *ns_nvm_create_request(ns_nvm_callback *callback, void *
     ns_nvm_request_ptr->operation = operation;
     ns_nvm_request_ptr->buffer = buf;
     ns_nvm_request_ptr->buffer_len = buf_len;
+    ns_nvm_request_ptr->buffer_size = 0;
+    ns_nvm_request_ptr->read_cache_generation = ns_nvm_read_cache_generation;
+    ns_nvm_request_ptr->status = NS_NVM_OK;
+    ns_nvm_request_ptr->batch = false;
+    ns_nvm_request_ptr->priority = NS_NVM_PRIORITY_NORMAL;
+    ns_nvm_request_ptr->age = 0;
+    ns_nvm_request_ptr->superseded = NULL;
 
     return ns_nvm_request_ptr;
 }
 
+static void ns_nvm_request_free(ns_nvm_request_t *request)
+{
+    if (ns_nvm_request_pool && request >= ns_nvm_request_pool && request < ns_nvm_request_pool + ns_nvm_request_pool_size) {
+        ns_list_add_to_start(&ns_nvm_request_pool_list, request);
+    } else {
+        ns_dyn_mem_free(request);
+    }
+}
+
 static int ns_nvm_operation_continue(ns_nvm_request_t *request, bool free_request)
 {
     platform_nvm_status ret = PLATFORM_NVM_OK;
 
-    ns_nvm_operation_in_progress = true;
+    ns_list_add_to_end(&ns_nvm_in_flight_list, request);
+    ns_nvm_operations_in_flight++;
     switch (request->operation) {
-        case NS_NVM_KEY_WRITE:
+        case NS_NVM_KEY_WRITE: {
+            ns_nvm_key_index_t *entry = ns_nvm_key_index_find(request->client_key_name);
+            if (entry && entry->len == *request->buffer_len) {
+                // key exists with the same length, no need to create it
+                ns_list_remove(&ns_nvm_key_index_list, entry);
+                ns_list_add_to_start(&ns_nvm_key_index_list, entry);
+                request->operation = NS_NVM_KEY_UPDATE;
+                ret = platform_nvm_write(ns_nvm_callback_func, request->client_key_name, request->buffer, request->buffer_len, request);
+                if (ret == PLATFORM_NVM_OK) {
+                    break;
+                }
+                // key may have been removed, create it again
+                ns_nvm_key_index_entry_remove(entry);
+            }
             request->operation = NS_NVM_KEY_CREATE;
             ret = platform_nvm_key_create(ns_nvm_callback_func, request->client_key_name, *request->buffer_len, 0, request);
             break;
+        }
         case NS_NVM_KEY_READ:
             ret = platform_nvm_read(ns_nvm_callback_func, request->client_key_name, request->buffer, request->buffer_len, request);
             break;
         case NS_NVM_KEY_DELETE:
             ret = platform_nvm_key_delete(ns_nvm_callback_func, request->client_key_name, request);
             break;
+        case NS_NVM_BATCH_COMMIT:
+            if (ns_list_is_empty(&ns_nvm_batch_list)) {
+                // nothing to flush
+                ns_nvm_batch_end(request, NS_NVM_OK);
+                return NS_NVM_OK;
+            }
+            ret = platform_nvm_flush(ns_nvm_callback_func, request);
+            if (ret != PLATFORM_NVM_OK) {
+                // batch members are waiting for the commit, complete with error
+                ns_nvm_batch_end(request, NS_NVM_ERROR);
+                return NS_NVM_OK;
+            }
+            break;
+        case NS_NVM_SYNC: {
+            // all earlier requests have been completed
+            int client_retval = ns_nvm_write_back_status;
+            ns_nvm_write_back_status = NS_NVM_OK;
+            ns_nvm_operation_end(request, client_retval);
+            return NS_NVM_OK;
+        }
     }
 
     if (ret != PLATFORM_NVM_OK) {
         if (free_request == true) {
-            // free request if requested
-            ns_dyn_mem_free(request);
+            // free request if requested, otherwise caller ends the operation
+            ns_list_remove(&ns_nvm_in_flight_list, request);
+            ns_nvm_operations_in_flight--;
+            ns_nvm_request_free(request);
         }
-        ns_nvm_operation_in_progress = false;
         return NS_NVM_ERROR;
     }
 
@@ -211,18 +851,151 @@ static int ns_nvm_operation_continue(ns_nvm_request_t *request, bool free_reques
 
 static void ns_nvm_operation_end(ns_nvm_request_t *ns_nvm_request_ptr, int client_retval)
 {
-    ns_nvm_request_ptr->callback(client_retval, ns_nvm_request_ptr->client_context);
-    ns_dyn_mem_free(ns_nvm_request_ptr);
-    ns_nvm_operation_in_progress = false;
+    ns_list_remove(&ns_nvm_in_flight_list, ns_nvm_request_ptr);
+    ns_nvm_operations_in_flight--;
 
-    ns_list_foreach_safe(ns_nvm_request_t, pending_req, &ns_nvm_request_list) {
-        // there are pending requests to be processed
-        ns_list_remove(&ns_nvm_request_list, pending_req);
-        int ret = ns_nvm_operation_continue(pending_req, false);
-        if (ret != NS_NVM_OK) {
-            ns_nvm_operation_end(pending_req, ret);
-        } else {
+    if (ns_nvm_request_ptr->batch) {
+        // batch member is completed when batch is committed
+        ns_nvm_request_ptr->status = client_retval;
+        ns_list_add_to_end(&ns_nvm_batch_list, ns_nvm_request_ptr);
+    } else {
+        ns_nvm_superseded_requests_end(ns_nvm_request_ptr, client_retval);
+        ns_nvm_request_ptr->callback(client_retval, ns_nvm_request_ptr->client_context);
+        ns_nvm_request_free(ns_nvm_request_ptr);
+    }
+
+    ns_nvm_pending_requests_process();
+}
+
+static bool ns_nvm_request_supersedable(const ns_nvm_request_t *request)
+{
+    // write-back flushes are coalesced by the write-back cache
+    return (request->operation == NS_NVM_KEY_WRITE || request->operation == NS_NVM_KEY_DELETE) &&
+           !request->batch && request->callback != ns_nvm_write_back_callback;
+}
+
+/*
+ * Pending write or delete of the same key is not executed if the new write or delete
+ * replaces it. Replaced request is completed with the status of the new request.
+ * Requests are not replaced over a read of the same key or a barrier.
+ */
+static void ns_nvm_pending_requests_supersede(ns_nvm_request_t *request)
+{
+    if (!ns_nvm_request_supersedable(request)) {
+        return;
+    }
+
+    ns_list_foreach_reverse(ns_nvm_request_t, pending_req, &ns_nvm_request_list) {
+        if (!pending_req->client_key_name) {
+            return;
+        }
+        if (strcmp(pending_req->client_key_name, request->client_key_name) != 0) {
+            continue;
+        }
+        if (ns_nvm_request_supersedable(pending_req)) {
+            ns_list_remove(&ns_nvm_request_list, pending_req);
+            request->superseded = pending_req;
+            if (pending_req->priority > request->priority) {
+                request->priority = pending_req->priority;
+            }
+        }
+        // earlier requests of the key have been superseded already or can't be
+        return;
+    }
+}
+
+static void ns_nvm_superseded_requests_end(ns_nvm_request_t *request, int client_retval)
+{
+    ns_nvm_request_t *superseded_req = request->superseded;
+    ns_nvm_request_t *oldest_req = NULL;
+
+    // reverse the chain to complete the oldest request first
+    while (superseded_req) {
+        ns_nvm_request_t *next_req = superseded_req->superseded;
+        superseded_req->superseded = oldest_req;
+        oldest_req = superseded_req;
+        superseded_req = next_req;
+    }
+    request->superseded = NULL;
+
+    while (oldest_req) {
+        ns_nvm_request_t *next_req = oldest_req->superseded;
+        oldest_req->callback(client_retval, oldest_req->client_context);
+        ns_nvm_request_free(oldest_req);
+        oldest_req = next_req;
+    }
+}
+
+/*
+ * Requests without a key (initialization, sync and batch commit) are barriers,
+ * they are started alone after all earlier requests have been completed.
+ * Requests to the same key are started in the order they were made.
+ */
+static bool ns_nvm_operation_can_start(const ns_nvm_request_t *request)
+{
+    if (ns_nvm_operations_in_flight >= ns_nvm_in_flight_depth) {
+        return false;
+    }
+
+    if (!request->client_key_name) {
+        const ns_nvm_request_t *first_pending = ns_list_get_first(&ns_nvm_request_list);
+        return ns_nvm_operations_in_flight == 0 && (!first_pending || first_pending == request);
+    }
+
+    ns_list_foreach(const ns_nvm_request_t, in_flight_req, &ns_nvm_in_flight_list) {
+        if (!in_flight_req->client_key_name || strcmp(in_flight_req->client_key_name, request->client_key_name) == 0) {
+            return false;
+        }
+    }
+
+    // new request has not been added to pending list, all pending requests are earlier
+    ns_list_foreach(const ns_nvm_request_t, pending_req, &ns_nvm_request_list) {
+        if (pending_req == request) {
             break;
         }
+        if (!pending_req->client_key_name || strcmp(pending_req->client_key_name, request->client_key_name) == 0) {
+            return false;
+        }
     }
+
+    return true;
+}
+
+/*
+ * Pending requests are kept in the order they were made, which is needed for same key
+ * ordering. The highest priority request that can be started is started first, and
+ * requests passed over are aged so that low priority requests are not starved.
+ */
+static void ns_nvm_pending_requests_process(void)
+{
+    if (ns_nvm_pending_processing) {
+        // called from a callback made below, list is processed again by the caller
+        return;
+    }
+    ns_nvm_pending_processing = true;
+
+    while (ns_nvm_operations_in_flight < ns_nvm_in_flight_depth) {
+        ns_nvm_request_t *selected_req = NULL;
+        ns_list_foreach(ns_nvm_request_t, pending_req, &ns_nvm_request_list) {
+            if ((!selected_req || pending_req->priority > selected_req->priority) && ns_nvm_operation_can_start(pending_req)) {
+                selected_req = pending_req;
+            }
+        }
+        if (!selected_req) {
+            break;
+        }
+        ns_list_foreach(ns_nvm_request_t, pending_req, &ns_nvm_request_list) {
+            if (pending_req->priority < selected_req->priority && ++pending_req->age >= NS_NVM_HELPER_PRIORITY_AGING) {
+                pending_req->priority++;
+                pending_req->age = 0;
+            }
+        }
+        ns_list_remove(&ns_nvm_request_list, selected_req);
+        int ret = ns_nvm_operation_continue(selected_req, false);
+        if (ret != NS_NVM_OK) {
+            ns_nvm_operation_end(selected_req, ret);
+        }
+    }
+
+    ns_nvm_pending_processing = false;
 }
@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "ns_types.h"
+#include "ns_list.h"
+#include "platform/arm_hal_nvm.h"
+#include "platform/arm_hal_nvm_file.h"
+
+/* Operations */
+#define NVM_FILE_INIT       0x01
+#define NVM_FILE_FINALIZE   0x02
+#define NVM_FILE_KEY_CREATE 0x03
+#define NVM_FILE_KEY_DELETE 0x04
+#define NVM_FILE_WRITE      0x05
+#define NVM_FILE_READ       0x06
+#define NVM_FILE_FLUSH      0x07
+
+#define NVM_FILE_MAGIC      0x314d564e  /* "NVM1" */
+#define NVM_FILE_KEY_SUFFIX ".key"
+#define NVM_FILE_TMP_SUFFIX ".tmp"
+
+/* Longest encoded key name, leaves room for the suffix */
+#define NVM_FILE_NAME_MAX   (NAME_MAX - (sizeof(NVM_FILE_KEY_SUFFIX) - 1))
+
+/* Stored in the beginning of each key file, followed by the data */
+typedef struct {
+    uint32_t magic;
+    uint16_t value_len;     /* Length reserved when key was created */
+    uint16_t data_len;      /* Length of the data written */
+} nvm_file_header_t;
+
+/* Requested operation, allocated together with the encoded key name */
+typedef struct {
+    int operation;
+    nvm_callback *callback;
+    void *context;
+    const void *data;
+    void *buf;
+    uint16_t *len;
+    uint16_t value_len;
+    platform_nvm_status status;
+    ns_list_link_t link;
+    char name[];
+} nvm_file_op_t;
+
+static char nvm_file_directory[PATH_MAX] = "nvm";
+static platform_nvm_file_notify *nvm_file_notify = NULL;
+static bool nvm_file_initialized = false;
+static bool nvm_file_thread_running = false;
+static int nvm_file_dir_fd = -1;
+static pthread_t nvm_file_thread;
+
+/* Protects the lists and the outstanding count, which are shared with the worker thread */
+static pthread_mutex_t nvm_file_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t nvm_file_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t nvm_file_done_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t nvm_file_outstanding = 0;
+static NS_LIST_DEFINE(nvm_file_work_list, nvm_file_op_t, link);
+static NS_LIST_DEFINE(nvm_file_done_list, nvm_file_op_t, link);
+
+static void *nvm_file_worker(void *arg);
+
+/*
+ * Key names are encoded to file names: characters other than letters, digits,
+ * '_', '-' and '.' (except a leading '.') are escaped as %XX.
+ */
+static bool nvm_file_name_encode(const char *key_name, char *name, size_t name_size)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t pos = 0;
+
+    if (!*key_name) {
+        return false;
+    }
+    for (const char *c = key_name; *c; c++) {
+        unsigned char ch = (unsigned char) *c;
+        bool plain = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                     ch == '_' || ch == '-' || (ch == '.' && c != key_name);
+        if (pos + (plain ? 1 : 3) >= name_size) {
+            return false;
+        }
+        if (plain) {
+            name[pos++] = ch;
+        } else {
+            name[pos++] = '%';
+            name[pos++] = hex[ch >> 4];
+            name[pos++] = hex[ch & 0x0f];
+        }
+    }
+    name[pos] = '\0';
+    return true;
+}
+
+static nvm_file_op_t *nvm_file_op_create(int operation, nvm_callback *callback, void *context, const char *key_name)
+{
+    char name[NVM_FILE_NAME_MAX + 1] = "";
+
+    if (!callback) {
+        return NULL;
+    }
+    if (operation != NVM_FILE_INIT && operation != NVM_FILE_FINALIZE && operation != NVM_FILE_FLUSH) {
+        if (!key_name || !nvm_file_name_encode(key_name, name, sizeof(name))) {
+            return NULL;
+        }
+    }
+
+    size_t name_len = strlen(name) + 1;
+    nvm_file_op_t *op = malloc(sizeof(nvm_file_op_t) + name_len);
+    if (!op) {
+        return NULL;
+    }
+    memset(op, 0, sizeof(nvm_file_op_t));
+    memcpy(op->name, name, name_len);
+    op->operation = operation;
+    op->callback = callback;
+    op->context = context;
+    op->status = PLATFORM_NVM_OK;
+    return op;
+}
+
+static void nvm_file_op_queue(nvm_file_op_t *op)
+{
+    pthread_mutex_lock(&nvm_file_mutex);
+    ns_list_add_to_end(&nvm_file_work_list, op);
+    nvm_file_outstanding++;
+    pthread_cond_signal(&nvm_file_work_cond);
+    pthread_mutex_unlock(&nvm_file_mutex);
+}
+
+static void nvm_file_worker_stop(void)
+{
+    pthread_mutex_lock(&nvm_file_mutex);
+    nvm_file_thread_running = false;
+    pthread_cond_signal(&nvm_file_work_cond);
+    pthread_mutex_unlock(&nvm_file_mutex);
+    pthread_join(nvm_file_thread, NULL);
+    close(nvm_file_dir_fd);
+    nvm_file_dir_fd = -1;
+}
+
+platform_nvm_status platform_nvm_file_configure(const char *directory, platform_nvm_file_notify *notify)
+{
+    if (nvm_file_initialized || nvm_file_thread_running) {
+        return PLATFORM_NVM_ERROR;
+    }
+    if (directory) {
+        if (strlen(directory) >= sizeof(nvm_file_directory)) {
+            return PLATFORM_NVM_ERROR;
+        }
+        strcpy(nvm_file_directory, directory);
+    }
+    nvm_file_notify = notify;
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_init(nvm_callback *callback, void *context)
+{
+    if (nvm_file_initialized || nvm_file_thread_running) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_INIT, callback, context, NULL);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    if (mkdir(nvm_file_directory, 0700) != 0 && errno != EEXIST) {
+        free(op);
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_dir_fd = open(nvm_file_directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (nvm_file_dir_fd < 0) {
+        free(op);
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_thread_running = true;
+    if (pthread_create(&nvm_file_thread, NULL, nvm_file_worker, NULL) != 0) {
+        nvm_file_thread_running = false;
+        close(nvm_file_dir_fd);
+        nvm_file_dir_fd = -1;
+        free(op);
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_initialized = true;
+    // worker removes files of interrupted writes before completing initialization
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_finalize(nvm_callback *callback, void *context)
+{
+    if (!nvm_file_initialized) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_FINALIZE, callback, context, NULL);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    // earlier operations are completed first, worker is stopped when this is dispatched
+    nvm_file_initialized = false;
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_key_create(nvm_callback *callback, const char *key_name, uint16_t value_len, uint32_t flags, void *context)
+{
+    (void) flags;
+    if (!nvm_file_initialized) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_KEY_CREATE, callback, context, key_name);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    op->value_len = value_len;
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_key_delete(nvm_callback *callback, const char *key_name, void *context)
+{
+    if (!nvm_file_initialized) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_KEY_DELETE, callback, context, key_name);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_write(nvm_callback *callback, const char *key_name, const void *data, uint16_t *data_len, void *context)
+{
+    if (!nvm_file_initialized || !data || !data_len) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_WRITE, callback, context, key_name);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    op->data = data;
+    op->len = data_len;
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_read(nvm_callback *callback, const char *key_name, void *buf, uint16_t *buf_len, void *context)
+{
+    if (!nvm_file_initialized || !buf || !buf_len) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_READ, callback, context, key_name);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    op->buf = buf;
+    op->len = buf_len;
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+platform_nvm_status platform_nvm_flush(nvm_callback *callback, void *context)
+{
+    if (!nvm_file_initialized) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_t *op = nvm_file_op_create(NVM_FILE_FLUSH, callback, context, NULL);
+    if (!op) {
+        return PLATFORM_NVM_ERROR;
+    }
+    nvm_file_op_queue(op);
+    return PLATFORM_NVM_OK;
+}
+
+int platform_nvm_file_dispatch(void)
+{
+    int count = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&nvm_file_mutex);
+        nvm_file_op_t *op = ns_list_get_first(&nvm_file_done_list);
+        if (op) {
+            ns_list_remove(&nvm_file_done_list, op);
+            nvm_file_outstanding--;
+        }
+        pthread_mutex_unlock(&nvm_file_mutex);
+        if (!op) {
+            break;
+        }
+        if (op->operation == NVM_FILE_FINALIZE) {
+            nvm_file_worker_stop();
+        }
+        op->callback(op->status, op->context);
+        free(op);
+        count++;
+    }
+
+    return count;
+}
+
+void platform_nvm_file_wait(void)
+{
+    pthread_mutex_lock(&nvm_file_mutex);
+    while (ns_list_is_empty(&nvm_file_done_list) && nvm_file_outstanding > 0) {
+        pthread_cond_wait(&nvm_file_done_cond, &nvm_file_mutex);
+    }
+    pthread_mutex_unlock(&nvm_file_mutex);
+}
+
+static bool nvm_file_write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *ptr = data;
+    while (len > 0) {
+        ssize_t ret = write(fd, ptr, len);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        ptr += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+static ssize_t nvm_file_read_all(int fd, void *buf, size_t len)
+{
+    uint8_t *ptr = buf;
+    size_t total = 0;
+    while (total < len) {
+        ssize_t ret = read(fd, ptr + total, len - total);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (ret == 0) {
+            break;
+        }
+        total += ret;
+    }
+    return total;
+}
+
+static void nvm_file_path(char *path, const char *name, const char *suffix)
+{
+    // name length has been checked when encoding
+    strcpy(path, name);
+    strcat(path, suffix);
+}
+
+/* Opens key file and reads the header */
+static platform_nvm_status nvm_file_open(const char *name, nvm_file_header_t *header, int *fd_out)
+{
+    char path[NAME_MAX + 1];
+
+    nvm_file_path(path, name, NVM_FILE_KEY_SUFFIX);
+    int fd = openat(nvm_file_dir_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? PLATFORM_NVM_KEY_NOT_FOUND : PLATFORM_NVM_ERROR;
+    }
+    if (nvm_file_read_all(fd, header, sizeof(*header)) != sizeof(*header) || header->magic != NVM_FILE_MAGIC) {
+        close(fd);
+        return PLATFORM_NVM_ERROR;
+    }
+    *fd_out = fd;
+    return PLATFORM_NVM_OK;
+}
+
+/* Replaces key file atomically */
+static platform_nvm_status nvm_file_store(const char *name, uint16_t value_len, const void *data, uint16_t data_len)
+{
+    char tmp_path[NAME_MAX + 1];
+    char path[NAME_MAX + 1];
+    nvm_file_header_t header = {NVM_FILE_MAGIC, value_len, data_len};
+
+    nvm_file_path(tmp_path, name, NVM_FILE_TMP_SUFFIX);
+    nvm_file_path(path, name, NVM_FILE_KEY_SUFFIX);
+    int fd = openat(nvm_file_dir_fd, tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return PLATFORM_NVM_ERROR;
+    }
+    // data must reach the disk before the rename, or a crash can leave an empty key file
+    bool ok = nvm_file_write_all(fd, &header, sizeof(header)) && nvm_file_write_all(fd, data, data_len) && fsync(fd) == 0;
+    if (close(fd) != 0 || !ok || renameat(nvm_file_dir_fd, tmp_path, nvm_file_dir_fd, path) != 0) {
+        unlinkat(nvm_file_dir_fd, tmp_path, 0);
+        return PLATFORM_NVM_ERROR;
+    }
+    return PLATFORM_NVM_OK;
+}
+
+static platform_nvm_status nvm_file_init(void)
+{
+    int fd = dup(nvm_file_dir_fd);
+    if (fd < 0) {
+        return PLATFORM_NVM_ERROR;
+    }
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return PLATFORM_NVM_ERROR;
+    }
+    const size_t suffix_len = sizeof(NVM_FILE_TMP_SUFFIX) - 1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len > suffix_len && strcmp(entry->d_name + len - suffix_len, NVM_FILE_TMP_SUFFIX) == 0) {
+            // write was interrupted, key file still has the previous data
+            unlinkat(nvm_file_dir_fd, entry->d_name, 0);
+        }
+    }
+    closedir(dir);
+    return PLATFORM_NVM_OK;
+}
+
+static platform_nvm_status nvm_file_write(const char *name, const void *data, uint16_t *data_len)
+{
+    nvm_file_header_t header;
+    int fd;
+
+    platform_nvm_status status = nvm_file_open(name, &header, &fd);
+    if (status != PLATFORM_NVM_OK) {
+        return status;
+    }
+    close(fd);
+    // data is truncated to the length reserved for the key
+    if (*data_len > header.value_len) {
+        *data_len = header.value_len;
+    }
+    return nvm_file_store(name, header.value_len, data, *data_len);
+}
+
+static platform_nvm_status nvm_file_read(const char *name, void *buf, uint16_t *buf_len)
+{
+    nvm_file_header_t header;
+    int fd;
+
+    platform_nvm_status status = nvm_file_open(name, &header, &fd);
+    if (status != PLATFORM_NVM_OK) {
+        return status;
+    }
+    uint16_t len = *buf_len < header.data_len ? *buf_len : header.data_len;
+    if (nvm_file_read_all(fd, buf, len) != len) {
+        status = PLATFORM_NVM_ERROR;
+    } else {
+        *buf_len = len;
+    }
+    close(fd);
+    return status;
+}
+
+static platform_nvm_status nvm_file_delete(const char *name)
+{
+    char path[NAME_MAX + 1];
+
+    nvm_file_path(path, name, NVM_FILE_KEY_SUFFIX);
+    if (unlinkat(nvm_file_dir_fd, path, 0) != 0) {
+        return errno == ENOENT ? PLATFORM_NVM_KEY_NOT_FOUND : PLATFORM_NVM_ERROR;
+    }
+    return PLATFORM_NVM_OK;
+}
+
+static platform_nvm_status nvm_file_flush(void)
+{
+    // key file data is synced when stored, make renames and deletes durable
+    if (fsync(nvm_file_dir_fd) != 0) {
+        return PLATFORM_NVM_ERROR;
+    }
+    return PLATFORM_NVM_OK;
+}
+
+static void *nvm_file_worker(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        pthread_mutex_lock(&nvm_file_mutex);
+        while (ns_list_is_empty(&nvm_file_work_list) && nvm_file_thread_running) {
+            pthread_cond_wait(&nvm_file_work_cond, &nvm_file_mutex);
+        }
+        nvm_file_op_t *op = ns_list_get_first(&nvm_file_work_list);
+        if (!op) {
+            pthread_mutex_unlock(&nvm_file_mutex);
+            break;
+        }
+        ns_list_remove(&nvm_file_work_list, op);
+        pthread_mutex_unlock(&nvm_file_mutex);
+
+        switch (op->operation) {
+            case NVM_FILE_INIT:
+                op->status = nvm_file_init();
+                break;
+            case NVM_FILE_KEY_CREATE:
+                op->status = nvm_file_store(op->name, op->value_len, NULL, 0);
+                break;
+            case NVM_FILE_KEY_DELETE:
+                op->status = nvm_file_delete(op->name);
+                break;
+            case NVM_FILE_WRITE:
+                op->status = nvm_file_write(op->name, op->data, op->len);
+                break;
+            case NVM_FILE_READ:
+                op->status = nvm_file_read(op->name, op->buf, op->len);
+                break;
+            case NVM_FILE_FLUSH:
+                op->status = nvm_file_flush();
+                break;
+            case NVM_FILE_FINALIZE:
+                break;
+        }
+
+        pthread_mutex_lock(&nvm_file_mutex);
+        ns_list_add_to_end(&nvm_file_done_list, op);
+        pthread_cond_broadcast(&nvm_file_done_cond);
+        pthread_mutex_unlock(&nvm_file_mutex);
+        if (nvm_file_notify) {
+            nvm_file_notify();
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of dynamic memory tracker overhead.
+ *
+ * Compares ns_dyn_mem_alloc()/ns_dyn_mem_free() throughput with and without
+ * the tracker at different amounts of live blocks. Tracked calls go through
+ * the same wrapper functions that nsdynmem_tracker.h macros map the API to.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "nsdynmemLIB.h"
+#include "nsdynmem_tracker_lib.h"
+
+// Heap functions are hidden by the tracker macros
+#undef ns_dyn_mem_alloc
+#undef ns_dyn_mem_free
+extern "C" void *ns_dyn_mem_alloc(ns_mem_block_size_t alloc_size);
+extern "C" void ns_dyn_mem_free(void *block);
+
+#define BENCH_BLOCK_SIZE 32
+#define BENCH_ROUNDS 3
+
+static ns_dyn_mem_tracker_lib_conf_t bench_conf;
+
+static ns_dyn_mem_tracker_lib_mem_blocks_t *bench_alloc_mem_blocks(ns_dyn_mem_tracker_lib_mem_blocks_t *blocks, uint16_t *mem_blocks_count)
+{
+    uint16_t new_count = *mem_blocks_count ? *mem_blocks_count * 2 : 16;
+    blocks = (ns_dyn_mem_tracker_lib_mem_blocks_t *) realloc(blocks, new_count * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_t));
+    memset(&blocks[*mem_blocks_count], 0, (new_count - *mem_blocks_count) * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_t));
+    *mem_blocks_count = new_count;
+    return blocks;
+}
+
+static ns_dyn_mem_tracker_lib_mem_blocks_ext_t *bench_alloc_mem_blocks_ext(ns_dyn_mem_tracker_lib_mem_blocks_ext_t *blocks, uint32_t *mem_blocks_count)
+{
+    uint32_t new_count = *mem_blocks_count ? *mem_blocks_count * 2 : 16;
+    blocks = (ns_dyn_mem_tracker_lib_mem_blocks_ext_t *) realloc(blocks, new_count * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+    memset(&blocks[*mem_blocks_count], 0, (new_count - *mem_blocks_count) * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+    *mem_blocks_count = new_count;
+    return blocks;
+}
+
+extern "C" void *ns_dyn_mem_tracker_dyn_mem_alloc(ns_mem_heap_size_t alloc_size, const char *function, uint32_t line)
+{
+    void *block = ns_dyn_mem_alloc(alloc_size);
+    ns_dyn_mem_tracker_lib_alloc(&bench_conf, __builtin_return_address(0), function, line, block, alloc_size);
+    return block;
+}
+
+extern "C" void *ns_dyn_mem_tracker_dyn_mem_temporary_alloc(ns_mem_heap_size_t alloc_size, const char *function, uint32_t line)
+{
+    return ns_dyn_mem_tracker_dyn_mem_alloc(alloc_size, function, line);
+}
+
+extern "C" void ns_dyn_mem_tracker_dyn_mem_free(void *block, const char *function, uint32_t line)
+{
+    ns_dyn_mem_tracker_lib_free(&bench_conf, __builtin_return_address(0), function, line, block);
+    ns_dyn_mem_free(block);
+}
+
+static void bench_tracker_init(void)
+{
+    free(bench_conf.mem_blocks);
+    free(bench_conf.ext_mem_blocks);
+    memset(&bench_conf, 0, sizeof(bench_conf));
+    bench_conf.alloc_mem_blocks = bench_alloc_mem_blocks;
+    bench_conf.ext_alloc_mem_blocks = bench_alloc_mem_blocks_ext;
+}
+
+static void bench_run(uint32_t live_blocks, bool tracked, double *alloc_ns, double *free_ns)
+{
+    size_t heap_size = (size_t) live_blocks * (BENCH_BLOCK_SIZE + 4 * sizeof(int)) + 4096;
+    void *heap = malloc(heap_size);
+    void **blocks = (void **) malloc(live_blocks * sizeof(void *));
+
+    *alloc_ns = 0;
+    *free_ns = 0;
+
+    // Tracker arrays grow on first round and are reused on later rounds
+    bench_tracker_init();
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        ns_dyn_mem_init(heap, heap_size, NULL, NULL);
+
+        auto start = std::chrono::steady_clock::now();
+        if (tracked) {
+            for (uint32_t i = 0; i < live_blocks; i++) {
+                blocks[i] = ns_dyn_mem_tracker_dyn_mem_alloc(BENCH_BLOCK_SIZE, __func__, __LINE__);
+            }
+        } else {
+            for (uint32_t i = 0; i < live_blocks; i++) {
+                blocks[i] = ns_dyn_mem_alloc(BENCH_BLOCK_SIZE);
+            }
+        }
+        auto allocated = std::chrono::steady_clock::now();
+        if (tracked) {
+            for (uint32_t i = 0; i < live_blocks; i++) {
+                ns_dyn_mem_tracker_dyn_mem_free(blocks[i], __func__, __LINE__);
+            }
+        } else {
+            for (uint32_t i = 0; i < live_blocks; i++) {
+                ns_dyn_mem_free(blocks[i]);
+            }
+        }
+        auto freed = std::chrono::steady_clock::now();
+
+        double round_alloc_ns = std::chrono::duration<double, std::nano>(allocated - start).count() / live_blocks;
+        double round_free_ns = std::chrono::duration<double, std::nano>(freed - allocated).count() / live_blocks;
+        if (round == 0 || round_alloc_ns < *alloc_ns) {
+            *alloc_ns = round_alloc_ns;
+        }
+        if (round == 0 || round_free_ns < *free_ns) {
+            *free_ns = round_free_ns;
+        }
+    }
+
+    free(blocks);
+    free(heap);
+}
+
+int main(int argc, char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    const uint32_t live_blocks[] = {1000, 10000, 100000};
+
+    printf("%10s %14s %14s %14s %14s %10s\n", "blocks", "alloc ns/op", "tracked", "free ns/op", "tracked", "overhead");
+    for (unsigned int i = 0; i < sizeof(live_blocks) / sizeof(live_blocks[0]); i++) {
+        double alloc_ns, free_ns, tracked_alloc_ns, tracked_free_ns;
+        bench_run(live_blocks[i], false, &alloc_ns, &free_ns);
+        bench_run(live_blocks[i], true, &tracked_alloc_ns, &tracked_free_ns);
+        double overhead = 100.0 * ((tracked_alloc_ns + tracked_free_ns) / (alloc_ns + free_ns) - 1.0);
+        printf("%10u %14.1f %14.1f %14.1f %14.1f %9.0f%%\n", live_blocks[i], alloc_ns, tracked_alloc_ns, free_ns, tracked_free_ns, overhead);
+    }
+
+    free(bench_conf.mem_blocks);
+    free(bench_conf.ext_mem_blocks);
+
+    return 0;
+}
@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include "ns_types.h"
+#include "nsdynmem_tracker_lib.h"
+
+#define TEST_TOP_ALLOCATORS_COUNT 5
+#define TEST_STACKS_COUNT 8
+#define TEST_STACK_DEPTH 4
+
+static ns_dyn_mem_tracker_lib_mem_blocks_t *test_alloc_mem_blocks(ns_dyn_mem_tracker_lib_mem_blocks_t *blocks, uint16_t *mem_blocks_count)
+{
+    uint16_t new_count = *mem_blocks_count ? *mem_blocks_count * 2 : 4;
+    blocks = (ns_dyn_mem_tracker_lib_mem_blocks_t *) realloc(blocks, new_count * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_t));
+    memset(&blocks[*mem_blocks_count], 0, (new_count - *mem_blocks_count) * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_t));
+    *mem_blocks_count = new_count;
+    return blocks;
+}
+
+static ns_dyn_mem_tracker_lib_mem_blocks_ext_t *test_alloc_mem_blocks_ext(ns_dyn_mem_tracker_lib_mem_blocks_ext_t *blocks, uint32_t *mem_blocks_count)
+{
+    uint32_t new_count = *mem_blocks_count ? *mem_blocks_count * 2 : 4;
+    blocks = (ns_dyn_mem_tracker_lib_mem_blocks_ext_t *) realloc(blocks, new_count * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+    memset(&blocks[*mem_blocks_count], 0, (new_count - *mem_blocks_count) * sizeof(ns_dyn_mem_tracker_lib_mem_blocks_ext_t));
+    *mem_blocks_count = new_count;
+    return blocks;
+}
+
+static uint8_t test_stack_id;
+
+static uint8_t test_stack_capture(void **frames, uint8_t max_depth)
+{
+    uint8_t depth = max_depth < 3 ? max_depth : 3;
+    for (uint8_t frame = 0; frame < depth; frame++) {
+        frames[frame] = (void *)(uintptr_t)(0x1000 * (test_stack_id + 1) + frame);
+    }
+    return depth;
+}
+
+static std::string test_export_output;
+
+static int8_t test_export_writer(const char *data, uint16_t data_len, void *context)
+{
+    (void) context;
+    test_export_output.append(data, data_len);
+    return 0;
+}
+
+#define CALLER_1 ((void *) 0x100)
+#define CALLER_2 ((void *) 0x200)
+#define CALLER_3 ((void *) 0x300)
+
+class nsdynmem_tracker_test : public testing::Test {
+protected:
+    void SetUp()
+    {
+        memset(&conf, 0, sizeof(conf));
+        memset(top_allocators, 0, sizeof(top_allocators));
+        memset(permanent_allocators, 0, sizeof(permanent_allocators));
+        memset(to_permanent_allocators, 0, sizeof(to_permanent_allocators));
+        memset(max_snap_shot_allocators, 0, sizeof(max_snap_shot_allocators));
+        conf.alloc_mem_blocks = test_alloc_mem_blocks;
+        conf.ext_alloc_mem_blocks = test_alloc_mem_blocks_ext;
+        conf.top_allocators = top_allocators;
+        conf.top_allocators_count = TEST_TOP_ALLOCATORS_COUNT;
+        conf.permanent_allocators = permanent_allocators;
+        conf.permanent_allocators_count = TEST_TOP_ALLOCATORS_COUNT;
+        conf.to_permanent_allocators = to_permanent_allocators;
+        conf.to_permanent_allocators_count = TEST_TOP_ALLOCATORS_COUNT;
+        conf.max_snap_shot_allocators = max_snap_shot_allocators;
+        conf.max_snap_shot_allocators_count = TEST_TOP_ALLOCATORS_COUNT;
+        conf.to_permanent_steps_count = 10;
+        test_stack_id = 0;
+        test_export_output.clear();
+    }
+
+    void TearDown()
+    {
+        free(conf.mem_blocks);
+        free(conf.ext_mem_blocks);
+    }
+
+    ns_dyn_mem_tracker_lib_conf_t conf;
+    ns_dyn_mem_tracker_lib_allocators_t top_allocators[TEST_TOP_ALLOCATORS_COUNT];
+    ns_dyn_mem_tracker_lib_allocators_t permanent_allocators[TEST_TOP_ALLOCATORS_COUNT];
+    ns_dyn_mem_tracker_lib_allocators_t to_permanent_allocators[TEST_TOP_ALLOCATORS_COUNT];
+    ns_dyn_mem_tracker_lib_allocators_t max_snap_shot_allocators[TEST_TOP_ALLOCATORS_COUNT];
+    uint8_t blocks[64][16];
+};
+
+TEST_F(nsdynmem_tracker_test, alloc_and_free)
+{
+    // Failed allocation is not tracked
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, NULL, 16));
+    ASSERT_EQ(0u, conf.allocated_memory);
+
+    // First allocation of the caller is stored to memory blocks, rest to extended blocks
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, blocks[i], 16));
+    }
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 20, blocks[10], 100));
+    ASSERT_EQ(260u, conf.allocated_memory);
+    ASSERT_TRUE(conf.mem_blocks != NULL);
+    ASSERT_TRUE(conf.ext_mem_blocks != NULL);
+
+    // Unknown block
+    ASSERT_EQ(-1, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, blocks[20]));
+    // NULL free
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, NULL));
+
+    // Frees the first block, caller remains while it has other blocks
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, blocks[0]));
+    ASSERT_EQ(244u, conf.allocated_memory);
+
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(CALLER_1, top_allocators[0].caller_addr);
+    ASSERT_EQ(9u, top_allocators[0].alloc_count);
+    ASSERT_EQ(144u, top_allocators[0].total_memory);
+    ASSERT_STREQ("func1", top_allocators[0].function);
+    ASSERT_EQ(10, top_allocators[0].line);
+    ASSERT_EQ(CALLER_2, top_allocators[1].caller_addr);
+    ASSERT_EQ(1u, top_allocators[1].alloc_count);
+
+    for (int i = 1; i < 11; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, blocks[i]));
+    }
+    ASSERT_EQ(0u, conf.allocated_memory);
+
+    // Double free
+    ASSERT_EQ(-1, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, blocks[1]));
+
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_TRUE(top_allocators[0].caller_addr == NULL);
+}
+
+TEST_F(nsdynmem_tracker_test, many_callers)
+{
+    // Memory blocks array grows when callers are added
+    for (int i = 0; i < 40; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, (void *)(uintptr_t)(0x1000 + i), "func", i, blocks[i], i + 1));
+    }
+    ASSERT_GE(conf.mem_blocks_count, 40);
+    ASSERT_EQ(39, conf.last_mem_block_index);
+    ASSERT_EQ(820u, conf.allocated_memory);
+
+    ns_dyn_mem_tracker_lib_max_snap_shot_update(&conf);
+    for (int i = 0; i < TEST_TOP_ALLOCATORS_COUNT; i++) {
+        ASSERT_EQ(40u - i, max_snap_shot_allocators[i].total_memory);
+    }
+
+    for (int i = 0; i < 40; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[i]));
+    }
+    ASSERT_EQ(0u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, top_allocators)
+{
+    int block = 0;
+    for (int i = 0; i < 3; i++) {
+        ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 1, blocks[block++], 10);
+    }
+    for (int i = 0; i < 5; i++) {
+        ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 2, blocks[block++], 10);
+    }
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_3, "func3", 3, blocks[block++], 500);
+
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(CALLER_2, top_allocators[0].caller_addr);
+    ASSERT_EQ(5u, top_allocators[0].alloc_count);
+    ASSERT_EQ(CALLER_1, top_allocators[1].caller_addr);
+    ASSERT_EQ(3u, top_allocators[1].alloc_count);
+    ASSERT_EQ(CALLER_3, top_allocators[2].caller_addr);
+
+    ns_dyn_mem_tracker_lib_max_snap_shot_update(&conf);
+    ASSERT_EQ(CALLER_3, max_snap_shot_allocators[0].caller_addr);
+    ASSERT_EQ(500u, max_snap_shot_allocators[0].total_memory);
+    ASSERT_EQ(CALLER_2, max_snap_shot_allocators[1].caller_addr);
+    ASSERT_EQ(50u, max_snap_shot_allocators[1].total_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, step_and_permanent)
+{
+    conf.to_permanent_steps_count = 2;
+
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 1, blocks[0], 10);
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 1, blocks[1], 10);
+    ns_dyn_mem_tracker_lib_step(&conf);
+    ns_dyn_mem_tracker_lib_step(&conf);
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 2, blocks[2], 10);
+
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(2u, top_allocators[0].min_lifetime);
+    ASSERT_EQ(0u, top_allocators[1].min_lifetime);
+    ASSERT_TRUE(to_permanent_allocators[0].caller_addr == NULL);
+
+    ns_dyn_mem_tracker_lib_step(&conf);
+
+    // Lifetime threshold exceeded, moves to permanent
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(CALLER_1, to_permanent_allocators[0].caller_addr);
+    ASSERT_EQ(3u, to_permanent_allocators[0].min_lifetime);
+    ASSERT_EQ(CALLER_2, top_allocators[0].caller_addr);
+
+    // Reported once on permanent list
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_TRUE(to_permanent_allocators[0].caller_addr == NULL);
+    ASSERT_EQ(CALLER_1, permanent_allocators[0].caller_addr);
+    ASSERT_EQ(2u, permanent_allocators[0].alloc_count);
+
+    // Free resets the lifetime
+    ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 1, blocks[1]);
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_TRUE(permanent_allocators[0].caller_addr == NULL);
+    ASSERT_TRUE(to_permanent_allocators[0].caller_addr == NULL);
+    bool found = false;
+    for (int i = 0; i < TEST_TOP_ALLOCATORS_COUNT; i++) {
+        if (top_allocators[i].caller_addr == CALLER_1) {
+            ASSERT_EQ(1u, top_allocators[i].alloc_count);
+            ASSERT_EQ(0u, top_allocators[i].min_lifetime);
+            found = true;
+        }
+    }
+    ASSERT_TRUE(found);
+}
+
+TEST_F(nsdynmem_tracker_test, sampling)
+{
+    conf.sample_interval = 256;
+
+    uint32_t real_size = 0;
+    uint8_t *heap = (uint8_t *) malloc(20000 * 64);
+    for (int i = 0; i < 20000; i++) {
+        uint32_t size = 1 + (i * 7) % 64;
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, i % 2 ? CALLER_1 : CALLER_2, "func", 1, heap + i * 64, size));
+        real_size += size;
+    }
+
+    // Estimates are within 10% of real values
+    ASSERT_NEAR(real_size, conf.allocated_memory, real_size / 10);
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_NEAR(10000, top_allocators[0].alloc_count, 1000);
+    ASSERT_NEAR(10000, top_allocators[1].alloc_count, 1000);
+    ASSERT_LT(top_allocators[0].sampled_count, 2000u);
+
+    // Frees of blocks that were not sampled are ignored
+    for (int i = 0; i < 20000; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, heap + i * 64));
+    }
+    ASSERT_EQ(0u, conf.allocated_memory);
+    free(heap);
+}
+
+TEST_F(nsdynmem_tracker_test, sampling_interval_one)
+{
+    // Interval of one byte tracks all allocations
+    conf.sample_interval = 1;
+
+    for (int i = 0; i < 9; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func", 1, blocks[i], 10));
+    }
+    ASSERT_EQ(90u, conf.allocated_memory);
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(9u, top_allocators[0].alloc_count);
+
+    for (int i = 0; i < 9; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[i]));
+    }
+    ASSERT_EQ(0u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, sampling_large_allocation)
+{
+    conf.sample_interval = 256;
+
+    // Sample points of large allocation are counted, not drawn one by one
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func", 1, blocks[0], 0x100000));
+    ASSERT_NEAR(0x100000, conf.allocated_memory, 0x100000 / 100);
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    ASSERT_EQ(1u, top_allocators[0].alloc_count);
+
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[0]));
+    ASSERT_EQ(0u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, stack_capture)
+{
+    ns_dyn_mem_tracker_lib_stack_t stacks[TEST_STACKS_COUNT];
+    void *stack_frames[TEST_STACKS_COUNT * TEST_STACK_DEPTH];
+    memset(stacks, 0, sizeof(stacks));
+    conf.stack_capture = test_stack_capture;
+    conf.stacks = stacks;
+    conf.stack_frames = stack_frames;
+    conf.stacks_count = TEST_STACKS_COUNT;
+    conf.stack_depth = TEST_STACK_DEPTH;
+
+    // Same caller, different call stacks
+    for (int i = 0; i < 9; i++) {
+        test_stack_id = i % 3;
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 1, blocks[i], 10 + test_stack_id));
+    }
+
+    ns_dyn_mem_tracker_lib_allocator_lists_update(&conf);
+    uint16_t stack_ids = 0;
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(CALLER_1, top_allocators[i].caller_addr);
+        ASSERT_EQ(3u, top_allocators[i].alloc_count);
+        ASSERT_NE(0, top_allocators[i].stack_id);
+
+        uint8_t depth;
+        void **frames = ns_dyn_mem_tracker_lib_stack_frames_get(&conf, top_allocators[i].stack_id, &depth);
+        ASSERT_EQ(3, depth);
+        uint32_t stack = (uintptr_t) frames[0] / 0x1000 - 1;
+        ASSERT_EQ(3 * (10 + stack), top_allocators[i].total_memory);
+        stack_ids |= 1 << stack;
+    }
+    ASSERT_EQ(7, stack_ids);
+    ASSERT_TRUE(top_allocators[3].caller_addr == NULL);
+
+    for (int i = 0; i < 9; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[i]));
+    }
+    for (int i = 0; i < TEST_STACKS_COUNT; i++) {
+        ASSERT_EQ(0u, stacks[i].ref_count);
+    }
+
+    uint8_t depth;
+    ASSERT_TRUE(ns_dyn_mem_tracker_lib_stack_frames_get(&conf, 0, &depth) == NULL);
+    ASSERT_EQ(0, depth);
+}
+
+TEST_F(nsdynmem_tracker_test, lifetime_histogram)
+{
+    ns_dyn_mem_tracker_lib_lifetime_histogram_t histograms[2];
+    memset(histograms, 0, sizeof(histograms));
+    conf.lifetime_histograms = histograms;
+    conf.lifetime_histograms_count = 2;
+
+    for (int i = 0; i < 10; i++) {
+        ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 1, blocks[i], 10);
+    }
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 2, blocks[10], 10);
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_3, "func3", 3, blocks[11], 10);
+
+    // Lifetimes 0, 1, 3, 6, 10, 15, 21, 28, 36, 45
+    for (int i = 0; i < 10; i++) {
+        ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[i]);
+        for (int step = 0; step <= i; step++) {
+            ns_dyn_mem_tracker_lib_step(&conf);
+        }
+    }
+    ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[10]);
+    // No free histogram entries
+    ns_dyn_mem_tracker_lib_free(&conf, NULL, NULL, 0, blocks[11]);
+
+    ASSERT_EQ(CALLER_1, histograms[0].caller_addr);
+    ASSERT_STREQ("func1", histograms[0].function);
+    uint32_t expected[NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS] = {1, 1, 1, 1, 2, 2, 2};
+    for (int i = 0; i < NS_DYN_MEM_TRACKER_LIB_LIFETIME_BUCKETS; i++) {
+        ASSERT_EQ(expected[i], histograms[0].buckets[i]);
+    }
+    ASSERT_EQ(CALLER_2, histograms[1].caller_addr);
+    ASSERT_EQ(1u, histograms[1].buckets[6]);
+}
+
+TEST_F(nsdynmem_tracker_test, export_collapsed)
+{
+    ns_dyn_mem_tracker_lib_stack_t stacks[TEST_STACKS_COUNT];
+    void *stack_frames[TEST_STACKS_COUNT * TEST_STACK_DEPTH];
+    memset(stacks, 0, sizeof(stacks));
+
+    ASSERT_EQ(-1, ns_dyn_mem_tracker_lib_export_collapsed(&conf, NS_DYN_MEM_TRACKER_LIB_EXPORT_BYTES, NULL, NULL));
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_export_collapsed(&conf, NS_DYN_MEM_TRACKER_LIB_EXPORT_BYTES, test_export_writer, NULL));
+    ASSERT_EQ("", test_export_output);
+
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 12, blocks[0], 10);
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 12, blocks[1], 20);
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, NULL, 0, blocks[2], 5);
+
+    conf.stack_capture = test_stack_capture;
+    conf.stacks = stacks;
+    conf.stack_frames = stack_frames;
+    conf.stacks_count = TEST_STACKS_COUNT;
+    conf.stack_depth = TEST_STACK_DEPTH;
+    test_stack_id = 1;
+    ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_3, "func3", 345, blocks[3], 7);
+
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_export_collapsed(&conf, NS_DYN_MEM_TRACKER_LIB_EXPORT_BYTES, test_export_writer, NULL));
+    ASSERT_EQ("func1:12 30\n0x200 5\n0x2002;0x2001;0x2000;func3:345 7\n", test_export_output);
+
+    test_export_output.clear();
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_export_collapsed(&conf, NS_DYN_MEM_TRACKER_LIB_EXPORT_COUNT, test_export_writer, NULL));
+    ASSERT_EQ("func1:12 2\n0x200 1\n0x2002;0x2001;0x2000;func3:345 1\n", test_export_output);
+}
+
+#define TEST_BLOCK(i) ((void *)(uintptr_t)(0x10000 + (i) * 16))
+
+static uint32_t test_block_index_hash_zero(void *block, uint32_t ext_mem_blocks_count)
+{
+    (void) block;
+    (void) ext_mem_blocks_count;
+    return 0;
+}
+
+TEST_F(nsdynmem_tracker_test, ext_table_growth)
+{
+    const uint32_t count = 1000;
+
+    for (uint32_t i = 0; i <= count; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, TEST_BLOCK(i), 16));
+    }
+    ASSERT_EQ(count, conf.ext_mem_blocks_used);
+    ASSERT_LE(conf.ext_mem_blocks_used * 4, conf.ext_mem_blocks_count * 3);
+    ASSERT_GT(conf.ext_rehash_count, 0u);
+
+    // Built-in hash keeps probe sequences short
+    ASSERT_LT(conf.ext_probes, conf.ext_lookups * 2);
+
+    ASSERT_EQ(-1, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(count + 1)));
+
+    // Frees every other block first, leaving deleted entries between live ones
+    for (uint32_t i = 1; i <= count; i += 2) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i)));
+    }
+    for (uint32_t i = 2; i <= count; i += 2) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i)));
+    }
+    ASSERT_EQ(0u, conf.ext_mem_blocks_used);
+    ASSERT_EQ(16u, conf.allocated_memory);
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(0)));
+    ASSERT_EQ(0u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, ext_table_deleted_entries)
+{
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, blocks[0], 16));
+
+    // Long running allocate and free cycle with few live blocks does not grow the table
+    for (uint32_t i = 1; i <= 10000; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, TEST_BLOCK(i), 16));
+        if (i > 8) {
+            ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i - 8)));
+        }
+        ASSERT_LE((conf.ext_mem_blocks_used + conf.ext_mem_blocks_deleted) * 4, conf.ext_mem_blocks_count * 3);
+    }
+    ASSERT_EQ(8u, conf.ext_mem_blocks_used);
+    ASSERT_LE(conf.ext_mem_blocks_count, 32u);
+
+    for (uint32_t i = 10000 - 7; i <= 10000; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i)));
+    }
+    ASSERT_EQ(0u, conf.ext_mem_blocks_used);
+    ASSERT_EQ(16u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, ext_table_custom_hash)
+{
+    // All blocks collide on the same start index
+    conf.block_index_hash = test_block_index_hash_zero;
+
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, blocks[0], 16));
+    for (uint32_t i = 1; i <= 100; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, TEST_BLOCK(i), 16));
+    }
+    ASSERT_GE(conf.ext_max_probe_length, 100u);
+
+    for (int i = 100; i >= 1; i -= 3) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i)));
+    }
+    for (uint32_t i = 1; i <= 100; i++) {
+        if ((100 - i) % 3 != 0) {
+            ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, TEST_BLOCK(i)));
+        }
+    }
+    ASSERT_EQ(0u, conf.ext_mem_blocks_used);
+    ASSERT_EQ(16u, conf.allocated_memory);
+}
+
+TEST_F(nsdynmem_tracker_test, leak_snapshots)
+{
+    ns_dyn_mem_tracker_lib_leak_allocators_t leak_allocators[2];
+    conf.leak_allocators = leak_allocators;
+    conf.leak_allocators_count = 2;
+    conf.leak_snapshots_count = 3;
+
+    // No allocations
+    ns_dyn_mem_tracker_lib_leak_snapshot_update(&conf);
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_leak_allocators_update(&conf));
+
+    // Stable caller allocates and frees, leaking callers only allocate
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, blocks[0], 100));
+    ns_dyn_mem_tracker_lib_leak_snapshot_update(&conf);
+    for (int i = 1; i <= 4; i++) {
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_1, "func1", 10, blocks[i], 100));
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 20, blocks[10 + i], 10));
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_3, "func3", 30, blocks[20 + i], 20));
+        ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_1, "func1", 11, blocks[i - 1]));
+        ns_dyn_mem_tracker_lib_leak_snapshot_update(&conf);
+        if (i < 3) {
+            ASSERT_EQ(0, ns_dyn_mem_tracker_lib_leak_allocators_update(&conf));
+        }
+    }
+    ASSERT_EQ(6u, conf.leak_snapshot_count);
+
+    ASSERT_EQ(2, ns_dyn_mem_tracker_lib_leak_allocators_update(&conf));
+    ASSERT_EQ(CALLER_3, leak_allocators[0].caller_addr);
+    ASSERT_EQ(80u, leak_allocators[0].growth);
+    ASSERT_EQ(80u, leak_allocators[0].total_memory);
+    ASSERT_EQ(4u, leak_allocators[0].alloc_count);
+    ASSERT_EQ(4, leak_allocators[0].growth_count);
+    ASSERT_STREQ("func3", leak_allocators[0].function);
+    ASSERT_EQ(CALLER_2, leak_allocators[1].caller_addr);
+    ASSERT_EQ(40u, leak_allocators[1].growth);
+
+    // Snapshot without growth resets the count
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_free(&conf, CALLER_3, "func3", 31, blocks[21]));
+    ASSERT_EQ(0, ns_dyn_mem_tracker_lib_alloc(&conf, CALLER_2, "func2", 20, blocks[15], 10));
+    ns_dyn_mem_tracker_lib_leak_snapshot_update(&conf);
+    ASSERT_EQ(1, ns_dyn_mem_tracker_lib_leak_allocators_update(&conf));
+    ASSERT_EQ(CALLER_2, leak_allocators[0].caller_addr);
+    ASSERT_EQ(50u, leak_allocators[0].growth);
+    ASSERT_EQ(5, leak_allocators[0].growth_count);
+    ASSERT_EQ(NULL, leak_allocators[1].caller_addr);
+
+    // Listing is limited to array size but all leaking callers are counted
+    conf.leak_allocators_count = 0;
+    ASSERT_EQ(1, ns_dyn_mem_tracker_lib_leak_allocators_update(&conf));
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_hash.h"
+#include "nsdynmemLIB.h"
+
+#define TEST_ENTRIES 2000
+
+typedef struct test_item {
+    uint32_t id;
+    int visits;
+    ns_hash_link_t link;
+} test_item_t;
+
+typedef NS_HASH_HEAD(test_item_t, link) test_table_t;
+
+static bool test_item_match(const void *key, const void *entry)
+{
+    return *(const uint32_t *) key == ((const test_item_t *) entry)->id;
+}
+
+static uint32_t test_item_hash(uint32_t id)
+{
+    return ns_hash_bytes(&id, sizeof(id));
+}
+
+static int test_failing_alloc_budget;
+
+static void *test_failing_alloc(void *context, size_t size)
+{
+    if (test_failing_alloc_budget == 0) {
+        return NULL;
+    }
+    test_failing_alloc_budget--;
+    return ns_hash_mem_book_alloc(context, size);
+}
+
+class nshash_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        book = ns_mem_init(heap, sizeof(heap), NULL, &mem_stat);
+        ASSERT_TRUE(book != NULL);
+        allocator.alloc = ns_hash_mem_book_alloc;
+        allocator.free = ns_hash_mem_book_free;
+        allocator.context = book;
+        ns_hash_init(&table, &allocator);
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            items[i].id = i * 7919;
+            items[i].visits = 0;
+        }
+    }
+
+    void TearDown(void)
+    {
+        ns_hash_deinit(&table);
+        EXPECT_EQ(0U, mem_stat.heap_sector_allocated_bytes);
+    }
+
+    // Every entry on the table is visited once by iteration and can be found
+    void check_table(int first, int last)
+    {
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            items[i].visits = 0;
+        }
+        ns_hash_foreach(test_item_t, item, &table) {
+            item->visits++;
+        }
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            bool on_table = i >= first && i < last;
+            ASSERT_EQ(on_table ? 1 : 0, items[i].visits);
+            test_item_t *found = ns_hash_find(&table, test_item_hash(items[i].id), &items[i].id, test_item_match);
+            ASSERT_EQ(on_table ? &items[i] : NULL, found);
+        }
+        ASSERT_EQ((uint_fast16_t)(last - first), ns_hash_count(&table));
+    }
+
+    uint8_t heap[32 * 1024];
+    mem_stat_t mem_stat;
+    ns_mem_book_t *book;
+    ns_hash_allocator_t allocator;
+    ns_hash_allocator_t failing_allocator;
+    test_table_t table;
+    test_item_t items[TEST_ENTRIES];
+};
+
+TEST_F(nshash_test, Empty)
+{
+    static const ns_hash_allocator_t default_allocator = NS_HASH_MEM_BOOK_ALLOCATOR(NULL);
+    static NS_HASH_DEFINE(defined_table, test_item_t, link, &default_allocator);
+    uint32_t key = 0;
+
+    EXPECT_TRUE(ns_hash_is_empty(&defined_table));
+    EXPECT_EQ(NULL, ns_hash_get_first(&defined_table));
+    EXPECT_EQ(NULL, ns_hash_find(&defined_table, test_item_hash(key), &key, test_item_match));
+    EXPECT_TRUE(ns_hash_is_empty(&table));
+    EXPECT_EQ(NULL, ns_hash_get_first(&table));
+    // no memory is allocated before first insertion
+    EXPECT_EQ(0U, mem_stat.heap_sector_allocated_bytes);
+}
+
+TEST_F(nshash_test, InsertFindRemove)
+{
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        ASSERT_EQ(0, ns_hash_insert(&table, &items[i], test_item_hash(items[i].id)));
+        if (i % 251 == 0) {
+            check_table(0, i + 1);
+        }
+    }
+    check_table(0, TEST_ENTRIES);
+
+    for (int i = 0; i < TEST_ENTRIES / 2; i++) {
+        ns_hash_remove(&table, &items[i]);
+    }
+    check_table(TEST_ENTRIES / 2, TEST_ENTRIES);
+
+    ns_hash_foreach_safe(test_item_t, item, &table) {
+        ns_hash_remove(&table, item);
+    }
+    EXPECT_TRUE(ns_hash_is_empty(&table));
+    EXPECT_EQ(NULL, ns_hash_get_first(&table));
+}
+
+TEST_F(nshash_test, IncrementalGrowth)
+{
+    int growing_inserts = 0;
+    int longest_growth = 0;
+
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        ASSERT_EQ(0, ns_hash_insert(&table, &items[i], test_item_hash(items[i].id)));
+        if (table.shash.old_buckets) {
+            // table is usable while buckets are being moved
+            growing_inserts++;
+            if (growing_inserts > longest_growth) {
+                longest_growth = growing_inserts;
+            }
+            if (i % 3 == 0) {
+                check_table(0, i + 1);
+            }
+            if (i % 5 == 0) {
+                ns_hash_remove(&table, &items[i]);
+                ns_hash_insert(&table, &items[i], test_item_hash(items[i].id));
+            }
+        } else {
+            growing_inserts = 0;
+        }
+    }
+    check_table(0, TEST_ENTRIES);
+
+    // buckets of the largest table were moved over several insertions
+    EXPECT_GT(longest_growth, 100);
+    // load stays bounded
+    EXPECT_LE(ns_hash_count(&table), (uint_fast16_t) table.shash.bucket_count * 2);
+}
+
+TEST_F(nshash_test, AllocationFailure)
+{
+    failing_allocator = allocator;
+    failing_allocator.alloc = test_failing_alloc;
+    ns_hash_deinit(&table);
+    ns_hash_init(&table, &failing_allocator);
+
+    // no memory for the first bucket array
+    test_failing_alloc_budget = 0;
+    EXPECT_EQ(-1, ns_hash_insert(&table, &items[0], test_item_hash(items[0].id)));
+    EXPECT_TRUE(ns_hash_is_empty(&table));
+
+    // table cannot grow, entries are still inserted
+    test_failing_alloc_budget = 1;
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(0, ns_hash_insert(&table, &items[i], test_item_hash(items[i].id)));
+    }
+    check_table(0, 100);
+
+    // table grows when memory is available
+    test_failing_alloc_budget = 1;
+    ASSERT_EQ(0, ns_hash_insert(&table, &items[100], test_item_hash(items[100].id)));
+    EXPECT_TRUE(table.shash.old_buckets != NULL);
+    check_table(0, 101);
+}
+
+TEST_F(nshash_test, HashBytes)
+{
+    // FNV-1a test vectors
+    EXPECT_EQ(0x811c9dc5U, ns_hash_bytes("", 0));
+    EXPECT_EQ(0xe40c292cU, ns_hash_bytes("a", 1));
+    EXPECT_EQ(0xbf9cf968U, ns_hash_bytes("foobar", 6));
+}
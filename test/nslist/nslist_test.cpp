@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_list.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+typedef struct test_entry {
+    int value;
+    ns_list_link_t link;
+} test_entry_t;
+
+typedef NS_LIST_HEAD(test_entry_t, link) test_list_t;
+typedef NS_LIST_HEAD_COUNTED(test_entry_t, link) test_counted_list_t;
+
+static NS_LIST_COUNTED_DEFINE(test_defined_list, test_entry_t, link);
+
+static int test_entry_compare(const void *a, const void *b)
+{
+    return ((const test_entry_t *) a)->value - ((const test_entry_t *) b)->value;
+}
+
+// Compare only low bits of value, to have many equal entries
+static int test_entry_compare_low(const void *a, const void *b)
+{
+    return (((const test_entry_t *) a)->value & 15) - (((const test_entry_t *) b)->value & 15);
+}
+
+class nslist_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        ns_list_init(&list);
+        ns_list_init(&counted_list);
+        for (int i = 0; i < 8; i++) {
+            entries[i].value = i;
+            ns_list_link_init(&entries[i], link);
+        }
+    }
+
+    // Check the list contents against expected values, walking both directions
+    void check_values(const test_counted_list_t *l, const int *values, int count)
+    {
+        int i = 0;
+        ns_list_foreach(const test_entry_t, entry, l) {
+            ASSERT_LT(i, count);
+            EXPECT_EQ(values[i], entry->value);
+            i++;
+        }
+        ASSERT_EQ(count, i);
+        ns_list_foreach_reverse(const test_entry_t, entry, l) {
+            i--;
+            EXPECT_EQ(values[i], entry->value);
+        }
+        EXPECT_EQ(0, i);
+        EXPECT_EQ((uint_fast16_t) count, ns_list_count(l));
+    }
+
+    test_list_t list;
+    test_counted_list_t counted_list;
+    test_entry_t entries[8];
+};
+
+TEST_F(nslist_test, CountedHeadLayout)
+{
+    // plain list head is not grown by the counted variant
+    EXPECT_EQ(sizeof(ns_list_t), sizeof(test_list_t));
+    EXPECT_EQ(sizeof(ns_list_counted_t), sizeof(test_counted_list_t));
+    EXPECT_TRUE(ns_list_is_empty(&test_defined_list));
+    EXPECT_EQ(0U, ns_list_count(&test_defined_list));
+    ns_list_add_to_end(&test_defined_list, &entries[0]);
+    EXPECT_EQ(1U, ns_list_count(&test_defined_list));
+    ns_list_remove(&test_defined_list, &entries[0]);
+    EXPECT_EQ(0U, ns_list_count(&test_defined_list));
+}
+
+TEST_F(nslist_test, CountedAddRemove)
+{
+    EXPECT_EQ(0U, ns_list_count(&counted_list));
+
+    ns_list_add_to_end(&counted_list, &entries[2]);
+    ns_list_add_to_start(&counted_list, &entries[0]);
+    ns_list_add_after(&counted_list, &entries[2], &entries[4]);
+    ns_list_add_before(&counted_list, &entries[2], &entries[1]);
+    ns_list_add_after(&counted_list, &entries[2], &entries[3]);
+    const int added[] = {0, 1, 2, 3, 4};
+    check_values(&counted_list, added, 5);
+
+    ns_list_replace(&counted_list, &entries[3], &entries[5]);
+    const int replaced[] = {0, 1, 2, 5, 4};
+    check_values(&counted_list, replaced, 5);
+
+    ns_list_remove(&counted_list, &entries[0]);
+    ns_list_remove(&counted_list, &entries[4]);
+    const int removed[] = {1, 2, 5};
+    check_values(&counted_list, removed, 3);
+
+    ns_list_foreach_safe(test_entry_t, entry, &counted_list) {
+        ns_list_remove(&counted_list, entry);
+    }
+    EXPECT_TRUE(ns_list_is_empty(&counted_list));
+    EXPECT_EQ(0U, ns_list_count(&counted_list));
+
+    // init discards the entries and the count
+    ns_list_add_to_end(&counted_list, &entries[0]);
+    ns_list_init(&counted_list);
+    EXPECT_EQ(0U, ns_list_count(&counted_list));
+}
+
+TEST_F(nslist_test, CountedConcatenate)
+{
+    test_counted_list_t other_list = NS_LIST_COUNTED_INIT(other_list);
+
+    ns_list_add_to_end(&counted_list, &entries[0]);
+    ns_list_add_to_end(&other_list, &entries[1]);
+    ns_list_add_to_end(&other_list, &entries[2]);
+
+    ns_list_concatenate(&counted_list, &other_list);
+    const int values[] = {0, 1, 2};
+    check_values(&counted_list, values, 3);
+    EXPECT_TRUE(ns_list_is_empty(&other_list));
+    EXPECT_EQ(0U, ns_list_count(&other_list));
+
+    // concatenating an empty list
+    ns_list_concatenate(&counted_list, &other_list);
+    EXPECT_EQ(3U, ns_list_count(&counted_list));
+    ns_list_concatenate(&other_list, &counted_list);
+    EXPECT_EQ(3U, ns_list_count(&other_list));
+    EXPECT_EQ(0U, ns_list_count(&counted_list));
+}
+
+TEST_F(nslist_test, PlainListCount)
+{
+    EXPECT_EQ(0U, ns_list_count(&list));
+    ns_list_add_to_end(&list, &entries[0]);
+    ns_list_add_to_start(&list, &entries[1]);
+    ns_list_add_after(&list, &entries[0], &entries[2]);
+    ns_list_add_before(&list, &entries[0], &entries[3]);
+    EXPECT_EQ(4U, ns_list_count(&list));
+    ns_list_remove(&list, &entries[1]);
+    EXPECT_EQ(3U, ns_list_count(&list));
+    EXPECT_EQ(&entries[3], ns_list_get_first(&list));
+    EXPECT_EQ(&entries[2], ns_list_get_last(&list));
+}
+
+TEST_F(nslist_test, SortSmall)
+{
+    ns_list_sort(&list, test_entry_compare);
+    EXPECT_TRUE(ns_list_is_empty(&list));
+
+    ns_list_add_to_end(&counted_list, &entries[3]);
+    ns_list_sort(&counted_list, test_entry_compare);
+    const int single[] = {3};
+    check_values(&counted_list, single, 1);
+
+    ns_list_add_to_start(&counted_list, &entries[5]);
+    ns_list_add_to_end(&counted_list, &entries[0]);
+    ns_list_add_to_end(&counted_list, &entries[4]);
+    ns_list_add_to_start(&counted_list, &entries[1]);
+    ns_list_sort(&counted_list, test_entry_compare);
+    const int sorted[] = {0, 1, 3, 4, 5};
+    check_values(&counted_list, sorted, 5);
+
+    // list is usable after sorting
+    ns_list_add_to_end(&counted_list, &entries[7]);
+    ns_list_remove(&counted_list, &entries[0]);
+    ns_list_add_before(&counted_list, &entries[7], &entries[6]);
+    const int modified[] = {1, 3, 4, 5, 6, 7};
+    check_values(&counted_list, modified, 6);
+}
+
+TEST_F(nslist_test, SortStable)
+{
+    for (int n = 2; n <= 300; n += 37) {
+        std::vector<test_entry_t> sort_entries(n);
+        ns_list_init(&list);
+        srand(n);
+        for (int i = 0; i < n; i++) {
+            sort_entries[i].value = rand() % 1000;
+            ns_list_add_to_end(&list, &sort_entries[i]);
+        }
+
+        ns_list_sort(&list, test_entry_compare_low);
+
+        // entries are in order, and equal entries in their original order
+        const test_entry_t *previous = NULL;
+        int count = 0;
+        ns_list_foreach(const test_entry_t, entry, &list) {
+            if (previous) {
+                ASSERT_LE(test_entry_compare_low(previous, entry), 0);
+                if (test_entry_compare_low(previous, entry) == 0) {
+                    ASSERT_LT(previous, entry);
+                }
+            }
+            previous = entry;
+            count++;
+        }
+        ASSERT_EQ(n, count);
+        ASSERT_EQ(previous, ns_list_get_last(&list));
+        ns_list_foreach_reverse(const test_entry_t, entry, &list) {
+            count--;
+        }
+        ASSERT_EQ(0, count);
+    }
+}
+
+TEST_F(nslist_test, Merge)
+{
+    test_list_t other_list = NS_LIST_INIT(other_list);
+
+    // merging into an empty list
+    ns_list_add_to_end(&other_list, &entries[1]);
+    ns_list_add_to_end(&other_list, &entries[4]);
+    ns_list_merge(&list, &other_list, test_entry_compare);
+    EXPECT_TRUE(ns_list_is_empty(&other_list));
+    EXPECT_EQ(&entries[1], ns_list_get_first(&list));
+    EXPECT_EQ(&entries[4], ns_list_get_last(&list));
+
+    // merging an empty list
+    ns_list_merge(&list, &other_list, test_entry_compare);
+    EXPECT_EQ(2U, ns_list_count(&list));
+
+    // source entries last
+    ns_list_add_to_end(&other_list, &entries[0]);
+    ns_list_add_to_end(&other_list, &entries[2]);
+    ns_list_add_to_end(&other_list, &entries[6]);
+    ns_list_add_to_end(&other_list, &entries[7]);
+    ns_list_merge(&list, &other_list, test_entry_compare);
+    EXPECT_TRUE(ns_list_is_empty(&other_list));
+    int i = 0;
+    const int values[] = {0, 1, 2, 4, 6, 7};
+    ns_list_foreach(const test_entry_t, entry, &list) {
+        EXPECT_EQ(values[i++], entry->value);
+    }
+    EXPECT_EQ(6, i);
+    EXPECT_EQ(&entries[7], ns_list_get_last(&list));
+    EXPECT_EQ(&entries[6], ns_list_get_previous(&list, &entries[7]));
+
+    // destination entries last
+    ns_list_remove(&list, &entries[7]);
+    ns_list_remove(&list, &entries[0]);
+    ns_list_add_to_end(&other_list, &entries[0]);
+    ns_list_merge(&list, &other_list, test_entry_compare);
+    EXPECT_EQ(&entries[0], ns_list_get_first(&list));
+    EXPECT_EQ(&entries[6], ns_list_get_last(&list));
+    EXPECT_EQ(5U, ns_list_count(&list));
+}
+
+TEST_F(nslist_test, CountedMergeStable)
+{
+    test_counted_list_t other_list = NS_LIST_COUNTED_INIT(other_list);
+
+    // 16 and 17 are equal to 0 and 1 in low bits
+    entries[5].value = 16;
+    entries[6].value = 17;
+    ns_list_add_to_end(&counted_list, &entries[0]);
+    ns_list_add_to_end(&counted_list, &entries[1]);
+    ns_list_add_to_end(&counted_list, &entries[3]);
+    ns_list_add_to_end(&other_list, &entries[5]);
+    ns_list_add_to_end(&other_list, &entries[6]);
+    ns_list_add_to_end(&other_list, &entries[2]);
+
+    ns_list_merge(&counted_list, &other_list, test_entry_compare_low);
+    const int values[] = {0, 16, 1, 17, 2, 3};
+    check_values(&counted_list, values, 6);
+    EXPECT_EQ(0U, ns_list_count(&other_list));
+}
+
+TEST_F(nslist_test, SpliceRange)
+{
+    test_counted_list_t other_list = NS_LIST_COUNTED_INIT(other_list);
+
+    for (int i = 0; i < 8; i++) {
+        ns_list_add_to_end(&counted_list, &entries[i]);
+    }
+
+    // middle range to an empty list
+    ns_list_splice_range(&other_list, NULL, &counted_list, &entries[2], &entries[4]);
+    const int remaining[] = {0, 1, 5, 6, 7};
+    check_values(&counted_list, remaining, 5);
+    const int moved[] = {2, 3, 4};
+    check_values(&other_list, moved, 3);
+
+    // single entry range from the end, before an entry
+    ns_list_splice_range(&other_list, &entries[3], &counted_list, &entries[7], &entries[7]);
+    const int remaining2[] = {0, 1, 5, 6};
+    check_values(&counted_list, remaining2, 4);
+    const int moved2[] = {2, 7, 3, 4};
+    check_values(&other_list, moved2, 4);
+
+    // range from the start, to the start
+    ns_list_splice_range(&other_list, &entries[2], &counted_list, &entries[0], &entries[1]);
+    const int remaining3[] = {5, 6};
+    check_values(&counted_list, remaining3, 2);
+    const int moved3[] = {0, 1, 2, 7, 3, 4};
+    check_values(&other_list, moved3, 6);
+
+    // within the same list
+    ns_list_splice_range(&other_list, NULL, &other_list, &entries[1], &entries[7]);
+    const int moved4[] = {0, 3, 4, 1, 2, 7};
+    check_values(&other_list, moved4, 6);
+    ns_list_splice_range(&other_list, &entries[0], &other_list, &entries[2], &entries[7]);
+    const int moved5[] = {2, 7, 0, 3, 4, 1};
+    check_values(&other_list, moved5, 6);
+
+    // whole list
+    ns_list_splice_range(&counted_list, &entries[6], &other_list, &entries[2], &entries[1]);
+    const int all[] = {5, 2, 7, 0, 3, 4, 1, 6};
+    check_values(&counted_list, all, 8);
+    EXPECT_TRUE(ns_list_is_empty(&other_list));
+    EXPECT_EQ(0U, ns_list_count(&other_list));
+}
+
+TEST_F(nslist_test, SplitAfter)
+{
+    test_list_t other_list = NS_LIST_INIT(other_list);
+
+    for (int i = 0; i < 5; i++) {
+        ns_list_add_to_end(&list, &entries[i]);
+    }
+
+    // splitting after last entry moves nothing
+    ns_list_split_after(&list, &entries[4], &other_list);
+    EXPECT_TRUE(ns_list_is_empty(&other_list));
+    EXPECT_EQ(5U, ns_list_count(&list));
+
+    ns_list_split_after(&list, &entries[1], &other_list);
+    EXPECT_EQ(2U, ns_list_count(&list));
+    EXPECT_EQ(&entries[1], ns_list_get_last(&list));
+    EXPECT_EQ(NULL, ns_list_get_next(&list, &entries[1]));
+    EXPECT_EQ(3U, ns_list_count(&other_list));
+    EXPECT_EQ(&entries[2], ns_list_get_first(&other_list));
+    EXPECT_EQ(&entries[4], ns_list_get_last(&other_list));
+    EXPECT_EQ(NULL, ns_list_get_previous(&other_list, &entries[2]));
+
+    // lists are usable after split
+    ns_list_add_to_end(&list, &entries[5]);
+    ns_list_add_to_start(&other_list, &entries[6]);
+    EXPECT_EQ(&entries[5], ns_list_get_next(&list, &entries[1]));
+    EXPECT_EQ(&entries[6], ns_list_get_previous(&other_list, &entries[2]));
+
+    // split appends to a non-empty destination
+    ns_list_split_after(&other_list, &entries[6], &list);
+    EXPECT_EQ(1U, ns_list_count(&other_list));
+    EXPECT_EQ(&entries[2], ns_list_get_next(&list, &entries[5]));
+    EXPECT_EQ(&entries[4], ns_list_get_last(&list));
+}
+
+TEST_F(nslist_test, CountedSplitAfter)
+{
+    test_counted_list_t other_list = NS_LIST_COUNTED_INIT(other_list);
+
+    for (int i = 0; i < 6; i++) {
+        ns_list_add_to_end(&counted_list, &entries[i]);
+    }
+    ns_list_split_after(&counted_list, &entries[0], &other_list);
+    const int first[] = {0};
+    check_values(&counted_list, first, 1);
+    const int rest[] = {1, 2, 3, 4, 5};
+    check_values(&other_list, rest, 5);
+}
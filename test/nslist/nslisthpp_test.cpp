@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_list.hpp"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+typedef struct test_entry {
+    int value;
+    ns_list_link_t link;
+} test_entry_t;
+
+typedef ns::intrusive_list<test_entry_t, offsetof(test_entry_t, link)> test_list_t;
+typedef ns::counted_intrusive_list<test_entry_t, offsetof(test_entry_t, link)> test_counted_list_t;
+
+// No overhead over the C list heads
+static_assert(sizeof(test_list_t) == sizeof(ns_list_t), "plain list head size");
+static_assert(sizeof(test_counted_list_t) == sizeof(ns_list_counted_t), "counted list head size");
+static_assert(test_list_t::link_offset == offsetof(test_entry_t, link), "constant link offset");
+static_assert(std::is_same<std::iterator_traits<test_list_t::iterator>::iterator_category, std::bidirectional_iterator_tag>::value,
+              "bidirectional iterator");
+
+static int test_entry_compare(const void *a, const void *b)
+{
+    return ((const test_entry_t *) a)->value - ((const test_entry_t *) b)->value;
+}
+
+class nslisthpp_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        for (int i = 0; i < 8; i++) {
+            entries[i].value = i;
+        }
+    }
+
+    template <typename L>
+    std::vector<int> values(const L &l)
+    {
+        std::vector<int> v;
+        for (const test_entry_t &entry : l) {
+            v.push_back(entry.value);
+        }
+        // reverse iteration gives the same entries
+        std::vector<int> r;
+        for (typename L::const_reverse_iterator it = l.rbegin(); it != l.rend(); ++it) {
+            r.insert(r.begin(), it->value);
+        }
+        EXPECT_TRUE(v == r);
+        EXPECT_EQ(v.size(), l.size());
+        return v;
+    }
+
+    test_list_t list;
+    test_counted_list_t counted_list;
+    test_entry_t entries[8];
+};
+
+TEST_F(nslisthpp_test, Empty)
+{
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(0U, list.size());
+    EXPECT_EQ(nullptr, list.get_first());
+    EXPECT_EQ(nullptr, list.get_last());
+    EXPECT_TRUE(list.begin() == list.end());
+    EXPECT_TRUE(list.rbegin() == list.rend());
+    EXPECT_TRUE(counted_list.empty());
+    EXPECT_EQ(0U, counted_list.size());
+}
+
+TEST_F(nslisthpp_test, AddRemove)
+{
+    list.add_to_end(&entries[2]);
+    list.add_to_start(&entries[0]);
+    list.add_after(&entries[2], &entries[4]);
+    list.add_before(&entries[2], &entries[1]);
+    list.insert(list.iterator_to(entries[4]), entries[3]);
+    list.insert(list.end(), entries[5]);
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5}), values(list));
+    EXPECT_EQ(&entries[0], list.get_first());
+    EXPECT_EQ(&entries[5], list.get_last());
+    EXPECT_EQ(&entries[3], list.get_next(&entries[2]));
+    EXPECT_EQ(&entries[1], list.get_previous(&entries[2]));
+    EXPECT_EQ(nullptr, list.get_previous(&entries[0]));
+
+    list.replace(&entries[3], &entries[7]);
+    list.remove(&entries[0]);
+    EXPECT_EQ(std::vector<int>({1, 2, 7, 4, 5}), values(list));
+
+    // erase while iterating
+    for (test_list_t::iterator it = list.begin(); it != list.end();) {
+        if (it->value % 2) {
+            it = list.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    EXPECT_EQ(std::vector<int>({2, 4}), values(list));
+}
+
+TEST_F(nslisthpp_test, Algorithms)
+{
+    for (int i = 0; i < 8; i++) {
+        counted_list.add_to_end(&entries[i]);
+    }
+
+    test_counted_list_t::iterator found = std::find_if(counted_list.begin(), counted_list.end(),
+                                                       [](const test_entry_t &e) {
+                                                           return e.value > 4;
+                                                       });
+    ASSERT_TRUE(found != counted_list.end());
+    EXPECT_EQ(&entries[5], &*found);
+    EXPECT_EQ(5, std::distance(counted_list.begin(), found));
+    EXPECT_EQ(4, std::count_if(counted_list.cbegin(), counted_list.cend(), [](const test_entry_t &e) {
+        return e.value % 2 == 0;
+    }));
+    EXPECT_TRUE(std::is_sorted(counted_list.begin(), counted_list.end(), [](const test_entry_t &a, const test_entry_t &b) {
+        return a.value < b.value;
+    }));
+
+    // end() can be decremented
+    test_counted_list_t::iterator last = counted_list.end();
+    --last;
+    EXPECT_EQ(&entries[7], &*last);
+
+    // entries can be modified through iterators
+    for (test_entry_t &e : counted_list) {
+        e.value = 7 - e.value;
+    }
+    EXPECT_EQ(std::vector<int>({7, 6, 5, 4, 3, 2, 1, 0}), values(counted_list));
+}
+
+TEST_F(nslisthpp_test, CountedOperations)
+{
+    test_counted_list_t other_list;
+
+    for (int i = 0; i < 8; i += 2) {
+        counted_list.add_to_start(&entries[i]);
+        other_list.add_to_end(&entries[i + 1]);
+    }
+    EXPECT_EQ(std::vector<int>({6, 4, 2, 0}), values(counted_list));
+
+    counted_list.sort(test_entry_compare);
+    counted_list.merge(other_list, test_entry_compare);
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}), values(counted_list));
+    EXPECT_TRUE(other_list.empty());
+
+    counted_list.split_after(&entries[3], other_list);
+    EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), values(counted_list));
+    EXPECT_EQ(std::vector<int>({4, 5, 6, 7}), values(other_list));
+
+    counted_list.splice_range(&entries[1], other_list, &entries[5], &entries[6]);
+    EXPECT_EQ(std::vector<int>({0, 5, 6, 1, 2, 3}), values(counted_list));
+    EXPECT_EQ(std::vector<int>({4, 7}), values(other_list));
+
+    counted_list.concatenate(other_list);
+    EXPECT_EQ(8U, counted_list.size());
+    EXPECT_EQ(0U, other_list.size());
+
+    counted_list.remove(&entries[0]);
+    EXPECT_EQ(7U, counted_list.size());
+    counted_list.init();
+    EXPECT_EQ(0U, counted_list.size());
+}
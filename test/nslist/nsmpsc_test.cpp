@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_mpsc.h"
+#include <thread>
+#include <vector>
+
+#define TEST_PRODUCERS 4
+#define TEST_ENTRIES_PER_PRODUCER 20000
+
+typedef struct test_event {
+    int producer;
+    int sequence;
+    ns_mpsc_link_t link;
+} test_event_t;
+
+typedef NS_MPSC_HEAD(test_event_t, link) test_mpsc_t;
+
+static NS_MPSC_DEFINE(test_defined_mpsc, test_event_t, link);
+
+class nsmpsc_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        ns_mpsc_init(&mpsc);
+        for (int i = 0; i < 10; i++) {
+            events[i].producer = 0;
+            events[i].sequence = i;
+        }
+    }
+
+    test_mpsc_t mpsc;
+    test_event_t events[10];
+};
+
+TEST_F(nsmpsc_test, Empty)
+{
+    EXPECT_TRUE(ns_mpsc_is_empty(&test_defined_mpsc));
+    EXPECT_EQ(NULL, ns_mpsc_pop(&test_defined_mpsc));
+    EXPECT_TRUE(ns_mpsc_is_empty(&mpsc));
+    EXPECT_EQ(NULL, ns_mpsc_pop(&mpsc));
+
+    ns_mpsc_push(&test_defined_mpsc, &events[0]);
+    EXPECT_FALSE(ns_mpsc_is_empty(&test_defined_mpsc));
+    EXPECT_EQ(&events[0], ns_mpsc_pop(&test_defined_mpsc));
+    EXPECT_TRUE(ns_mpsc_is_empty(&test_defined_mpsc));
+    EXPECT_EQ(NULL, ns_mpsc_pop(&test_defined_mpsc));
+}
+
+TEST_F(nsmpsc_test, Fifo)
+{
+    for (int i = 0; i < 10; i++) {
+        ns_mpsc_push(&mpsc, &events[i]);
+    }
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(&events[i], ns_mpsc_pop(&mpsc));
+    }
+    EXPECT_TRUE(ns_mpsc_is_empty(&mpsc));
+    EXPECT_EQ(NULL, ns_mpsc_pop(&mpsc));
+
+    // interleaved, queue repeatedly drained to the last entry
+    int pushed = 0;
+    int popped = 0;
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i <= round % 3; i++) {
+            ns_mpsc_push(&mpsc, &events[pushed++ % 10]);
+        }
+        test_event_t *event;
+        while ((event = ns_mpsc_pop(&mpsc)) != NULL) {
+            EXPECT_EQ(&events[popped++ % 10], event);
+        }
+        EXPECT_EQ(pushed, popped);
+        EXPECT_TRUE(ns_mpsc_is_empty(&mpsc));
+    }
+}
+
+static void test_producer(test_mpsc_t *mpsc, test_event_t *events, int producer)
+{
+    for (int i = 0; i < TEST_ENTRIES_PER_PRODUCER; i++) {
+        events[i].producer = producer;
+        events[i].sequence = i;
+        ns_mpsc_push(mpsc, &events[i]);
+    }
+}
+
+TEST_F(nsmpsc_test, Threads)
+{
+    std::vector<test_event_t> thread_events(TEST_PRODUCERS * TEST_ENTRIES_PER_PRODUCER);
+    std::vector<std::thread> producers;
+    int next_sequence[TEST_PRODUCERS] = { 0 };
+
+    for (int p = 0; p < TEST_PRODUCERS; p++) {
+        producers.push_back(std::thread(test_producer, &mpsc, &thread_events[p * TEST_ENTRIES_PER_PRODUCER], p));
+    }
+
+    // entries of each producer are popped in the order they were pushed
+    for (int received = 0; received < TEST_PRODUCERS * TEST_ENTRIES_PER_PRODUCER;) {
+        test_event_t *event = ns_mpsc_pop(&mpsc);
+        if (!event) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(next_sequence[event->producer], event->sequence);
+        next_sequence[event->producer]++;
+        received++;
+    }
+
+    for (size_t p = 0; p < producers.size(); p++) {
+        producers[p].join();
+    }
+    EXPECT_TRUE(ns_mpsc_is_empty(&mpsc));
+    EXPECT_EQ(NULL, ns_mpsc_pop(&mpsc));
+}
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_pqueue.h"
+#include <stdlib.h>
+#include <chrono>
+#include <set>
+#include <vector>
+
+#define TEST_ENTRIES 1000
+
+typedef struct test_event {
+    uint32_t expiry;
+    bool queued;
+    ns_pqueue_link_t link;
+    ns_list_link_t list_link;
+} test_event_t;
+
+typedef NS_PQUEUE_HEAD(test_event_t, link) test_pqueue_t;
+typedef NS_LIST_HEAD(test_event_t, list_link) test_list_t;
+
+static NS_PQUEUE_DEFINE(test_defined_pqueue, test_event_t, link);
+
+static unsigned test_compare_count;
+
+static int test_event_compare(const void *a, const void *b)
+{
+    uint32_t a_expiry = ((const test_event_t *) a)->expiry;
+    uint32_t b_expiry = ((const test_event_t *) b)->expiry;
+    test_compare_count++;
+    return a_expiry < b_expiry ? -1 : a_expiry > b_expiry;
+}
+
+// Sorted insertion, as used by list-based timer queues
+static void test_list_insert(test_list_t *list, test_event_t *event)
+{
+    ns_list_foreach(test_event_t, cur, list) {
+        if (test_event_compare(event, cur) < 0) {
+            ns_list_add_before(list, cur, event);
+            return;
+        }
+    }
+    ns_list_add_to_end(list, event);
+}
+
+class nspqueue_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        ns_pqueue_init(&pqueue);
+        srand(1);
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            events[i].expiry = rand() % (TEST_ENTRIES * 4);
+            events[i].queued = false;
+        }
+        test_compare_count = 0;
+    }
+
+    void insert(test_event_t *event)
+    {
+        ns_pqueue_insert(&pqueue, event, test_event_compare);
+        reference.insert(event->expiry);
+        event->queued = true;
+    }
+
+    void remove(test_event_t *event)
+    {
+        ns_pqueue_remove(&pqueue, event, test_event_compare);
+        reference.erase(reference.find(event->expiry));
+        event->queued = false;
+    }
+
+    // Drain the queue, checking entries come out in order
+    void check_drain(void)
+    {
+        test_event_t *event;
+        while ((event = ns_pqueue_remove_first(&pqueue, test_event_compare))) {
+            ASSERT_FALSE(reference.empty());
+            ASSERT_EQ(*reference.begin(), event->expiry);
+            reference.erase(reference.begin());
+            event->queued = false;
+            test_event_t *first = ns_pqueue_get_first(&pqueue);
+            ASSERT_TRUE(!first || first->expiry >= event->expiry);
+        }
+        ASSERT_TRUE(reference.empty());
+        ASSERT_TRUE(ns_pqueue_is_empty(&pqueue));
+    }
+
+    test_pqueue_t pqueue;
+    test_event_t events[TEST_ENTRIES];
+    std::multiset<uint32_t> reference;
+};
+
+TEST_F(nspqueue_test, Empty)
+{
+    EXPECT_TRUE(ns_pqueue_is_empty(&test_defined_pqueue));
+    EXPECT_TRUE(ns_pqueue_is_empty(&pqueue));
+    EXPECT_EQ(NULL, ns_pqueue_get_first(&pqueue));
+    EXPECT_EQ(NULL, ns_pqueue_remove_first(&pqueue, test_event_compare));
+
+    ns_pqueue_insert(&test_defined_pqueue, &events[0], test_event_compare);
+    EXPECT_FALSE(ns_pqueue_is_empty(&test_defined_pqueue));
+    EXPECT_EQ(&events[0], ns_pqueue_get_first(&test_defined_pqueue));
+    ns_pqueue_decrease_key(&test_defined_pqueue, &events[0], test_event_compare);
+    ns_pqueue_remove(&test_defined_pqueue, &events[0], test_event_compare);
+    EXPECT_TRUE(ns_pqueue_is_empty(&test_defined_pqueue));
+}
+
+TEST_F(nspqueue_test, InsertRemoveFirst)
+{
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        insert(&events[i]);
+        ASSERT_EQ(*reference.begin(), ns_pqueue_get_first(&pqueue)->expiry);
+    }
+    check_drain();
+}
+
+TEST_F(nspqueue_test, Interleaved)
+{
+    // timer-like usage, expiries of new entries are after the current time
+    int next = 0;
+    uint32_t now = 0;
+    while (next < TEST_ENTRIES || !reference.empty()) {
+        int inserts = rand() % 4;
+        for (int i = 0; i < inserts && next < TEST_ENTRIES; i++) {
+            events[next].expiry += now;
+            insert(&events[next++]);
+        }
+        test_event_t *event = ns_pqueue_remove_first(&pqueue, test_event_compare);
+        if (event) {
+            ASSERT_EQ(*reference.begin(), event->expiry);
+            reference.erase(reference.begin());
+            now = event->expiry;
+        }
+    }
+    EXPECT_TRUE(ns_pqueue_is_empty(&pqueue));
+}
+
+TEST_F(nspqueue_test, RemoveAndDecreaseKey)
+{
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        insert(&events[i]);
+    }
+    // make the heap deeper than a fresh one
+    for (int i = 0; i < TEST_ENTRIES / 10; i++) {
+        test_event_t *event = ns_pqueue_remove_first(&pqueue, test_event_compare);
+        reference.erase(reference.begin());
+        event->queued = false;
+    }
+
+    for (int i = 0; i < TEST_ENTRIES * 2; i++) {
+        test_event_t *event = &events[rand() % TEST_ENTRIES];
+        if (!event->queued) {
+            insert(event);
+        } else if (rand() % 2) {
+            remove(event);
+        } else {
+            reference.erase(reference.find(event->expiry));
+            event->expiry /= 2;
+            reference.insert(event->expiry);
+            ns_pqueue_decrease_key(&pqueue, event, test_event_compare);
+        }
+        ASSERT_EQ(*reference.begin(), ns_pqueue_get_first(&pqueue)->expiry);
+    }
+    check_drain();
+}
+
+TEST_F(nspqueue_test, BenchmarkAgainstList)
+{
+    // Same insert and remove-first pattern on a sorted list and on the queue.
+    // Comparison counts are deterministic, times are only reported.
+    test_list_t list = NS_LIST_INIT(list);
+    std::vector<uint32_t> list_order;
+    std::vector<uint32_t> pqueue_order;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        test_list_insert(&list, &events[i]);
+        if (i % 3 == 2) {
+            test_event_t *event = ns_list_get_first(&list);
+            ns_list_remove(&list, event);
+            list_order.push_back(event->expiry);
+        }
+    }
+    ns_list_foreach_safe(test_event_t, event, &list) {
+        ns_list_remove(&list, event);
+        list_order.push_back(event->expiry);
+    }
+    std::chrono::steady_clock::duration list_time = std::chrono::steady_clock::now() - start;
+    unsigned list_compares = test_compare_count;
+
+    test_compare_count = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        ns_pqueue_insert(&pqueue, &events[i], test_event_compare);
+        if (i % 3 == 2) {
+            pqueue_order.push_back(ns_pqueue_remove_first(&pqueue, test_event_compare)->expiry);
+        }
+    }
+    test_event_t *event;
+    while ((event = ns_pqueue_remove_first(&pqueue, test_event_compare))) {
+        pqueue_order.push_back(event->expiry);
+    }
+    std::chrono::steady_clock::duration pqueue_time = std::chrono::steady_clock::now() - start;
+    unsigned pqueue_compares = test_compare_count;
+
+    EXPECT_TRUE(list_order == pqueue_order);
+    EXPECT_LT(pqueue_compares * 10, list_compares);
+
+    RecordProperty("list_compares", list_compares);
+    RecordProperty("pqueue_compares", pqueue_compares);
+    RecordProperty("list_us", (int) std::chrono::duration_cast<std::chrono::microseconds>(list_time).count());
+    RecordProperty("pqueue_us", (int) std::chrono::duration_cast<std::chrono::microseconds>(pqueue_time).count());
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_slist.h"
+
+typedef struct test_sentry {
+    int value;
+    ns_slist_link_t link;
+} test_sentry_t;
+
+typedef NS_SLIST_HEAD(test_sentry_t, link) test_slist_t;
+
+static NS_SLIST_DEFINE(test_defined_slist, test_sentry_t, link);
+
+class nsslist_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        ns_slist_init(&list);
+        for (int i = 0; i < 8; i++) {
+            entries[i].value = i;
+            ns_slist_link_init(&entries[i], link);
+        }
+    }
+
+    void check_values(const test_slist_t *l, const int *values, int count)
+    {
+        int i = 0;
+        ns_slist_foreach(const test_sentry_t, entry, l) {
+            ASSERT_LT(i, count);
+            EXPECT_EQ(values[i], entry->value);
+            i++;
+        }
+        ASSERT_EQ(count, i);
+        EXPECT_EQ((uint_fast16_t) count, ns_slist_count(l));
+        if (count) {
+            EXPECT_EQ(values[count - 1], ns_slist_get_last(l)->value);
+        } else {
+            EXPECT_TRUE(ns_slist_is_empty(l));
+            EXPECT_EQ(NULL, ns_slist_get_last(l));
+        }
+    }
+
+    test_slist_t list;
+    test_sentry_t entries[8];
+};
+
+TEST_F(nsslist_test, OnePointerLink)
+{
+    EXPECT_EQ(sizeof(void *), sizeof(ns_slist_link_t));
+    EXPECT_TRUE(ns_slist_is_empty(&test_defined_slist));
+    ns_slist_add_to_end(&test_defined_slist, &entries[0]);
+    EXPECT_EQ(&entries[0], ns_slist_remove_first(&test_defined_slist));
+    EXPECT_TRUE(ns_slist_is_empty(&test_defined_slist));
+}
+
+TEST_F(nsslist_test, Queue)
+{
+    EXPECT_EQ(NULL, ns_slist_remove_first(&list));
+
+    for (int i = 0; i < 4; i++) {
+        ns_slist_add_to_end(&list, &entries[i]);
+    }
+    const int queued[] = {0, 1, 2, 3};
+    check_values(&list, queued, 4);
+
+    EXPECT_EQ(&entries[0], ns_slist_remove_first(&list));
+    EXPECT_EQ(&entries[1], ns_slist_remove_first(&list));
+    // queue can be refilled after the tail has been taken
+    ns_slist_add_to_end(&list, &entries[4]);
+    EXPECT_EQ(&entries[2], ns_slist_remove_first(&list));
+    EXPECT_EQ(&entries[3], ns_slist_remove_first(&list));
+    EXPECT_EQ(&entries[4], ns_slist_remove_first(&list));
+    check_values(&list, NULL, 0);
+
+    ns_slist_add_to_end(&list, &entries[5]);
+    const int refilled[] = {5};
+    check_values(&list, refilled, 1);
+}
+
+TEST_F(nsslist_test, Stack)
+{
+    ns_slist_add_to_start(&list, &entries[0]);
+    ns_slist_add_to_start(&list, &entries[1]);
+    ns_slist_add_to_start(&list, &entries[2]);
+    const int stacked[] = {2, 1, 0};
+    check_values(&list, stacked, 3);
+    EXPECT_EQ(&entries[2], ns_slist_remove_first(&list));
+    ns_slist_add_to_end(&list, &entries[3]);
+    const int appended[] = {1, 0, 3};
+    check_values(&list, appended, 3);
+}
+
+TEST_F(nsslist_test, InsertRemoveMiddle)
+{
+    ns_slist_add_to_end(&list, &entries[0]);
+    ns_slist_add_after(&list, &entries[0], &entries[2]);
+    ns_slist_add_after(&list, &entries[0], &entries[1]);
+    ns_slist_add_after(&list, &entries[2], &entries[3]);
+    const int added[] = {0, 1, 2, 3};
+    check_values(&list, added, 4);
+
+    EXPECT_EQ(&entries[1], ns_slist_remove_after(&list, &entries[0]));
+    const int removed_middle[] = {0, 2, 3};
+    check_values(&list, removed_middle, 3);
+
+    EXPECT_EQ(&entries[3], ns_slist_remove_after(&list, &entries[2]));
+    const int removed_last[] = {0, 2};
+    check_values(&list, removed_last, 2);
+    ns_slist_add_to_end(&list, &entries[4]);
+
+    ns_slist_remove(&list, &entries[2]);
+    ns_slist_remove(&list, &entries[4]);
+    const int removed[] = {0};
+    check_values(&list, removed, 1);
+    ns_slist_remove(&list, &entries[0]);
+    check_values(&list, NULL, 0);
+}
+
+TEST_F(nsslist_test, ConcatenateAndSafeIteration)
+{
+    test_slist_t other = NS_SLIST_INIT(other);
+
+    ns_slist_add_to_end(&list, &entries[0]);
+    ns_slist_add_to_end(&other, &entries[1]);
+    ns_slist_add_to_end(&other, &entries[2]);
+    ns_slist_concatenate(&list, &other);
+    const int values[] = {0, 1, 2};
+    check_values(&list, values, 3);
+    check_values(&other, NULL, 0);
+
+    // move all entries to the other list while iterating
+    ns_slist_foreach_safe(test_sentry_t, entry, &list) {
+        EXPECT_EQ(entry, ns_slist_remove_first(&list));
+        ns_slist_add_to_start(&other, entry);
+    }
+    check_values(&list, NULL, 0);
+    const int reversed[] = {2, 1, 0};
+    check_values(&other, reversed, 3);
+}
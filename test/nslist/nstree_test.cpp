@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include "ns_tree.h"
+#include <stdlib.h>
+#include <set>
+#include <vector>
+
+#define TEST_ENTRIES 1000
+
+typedef struct test_node {
+    uint32_t key;
+    int id;
+    ns_tree_link_t link;
+} test_node_t;
+
+typedef NS_TREE_HEAD(test_node_t, link) test_tree_t;
+
+static NS_TREE_DEFINE(test_defined_tree, test_node_t, link);
+
+static int test_node_compare(const void *key, const void *entry)
+{
+    uint32_t a = *(const uint32_t *) key;
+    uint32_t b = ((const test_node_t *) entry)->key;
+    return a < b ? -1 : a > b;
+}
+
+// Check red-black properties of a subtree, return its black height or -1 if invalid
+static int test_tree_check(const ns_tree_link_t *link, const ns_tree_link_t *parent)
+{
+    if (!link) {
+        return 1;
+    }
+    if (link->parent != parent) {
+        return -1;
+    }
+    if (link->red && ((link->left && link->left->red) || (link->right && link->right->red))) {
+        return -1;
+    }
+    int left_height = test_tree_check(link->left, link);
+    int right_height = test_tree_check(link->right, link);
+    if (left_height < 0 || left_height != right_height) {
+        return -1;
+    }
+    return left_height + (link->red ? 0 : 1);
+}
+
+class nstree_test : public testing::Test
+{
+protected:
+    void SetUp(void)
+    {
+        ns_tree_init(&tree);
+        srand(1);
+        for (int i = 0; i < TEST_ENTRIES; i++) {
+            nodes[i].key = rand() % (TEST_ENTRIES / 2);
+            nodes[i].id = i;
+        }
+    }
+
+    // Compare the tree against the reference, in both directions
+    void check_tree(void)
+    {
+        ASSERT_TRUE(!tree.stree.root || !tree.stree.root->red);
+        ASSERT_GT(test_tree_check(tree.stree.root, NULL), 0);
+        std::multiset<uint32_t>::const_iterator it = reference.begin();
+        const test_node_t *previous = NULL;
+        ns_tree_foreach(const test_node_t, node, &tree) {
+            ASSERT_TRUE(it != reference.end());
+            ASSERT_EQ(*it, node->key);
+            if (previous && previous->key == node->key) {
+                // equal keys in insertion order
+                ASSERT_LT(previous->id, node->id);
+            }
+            previous = node;
+            ++it;
+        }
+        ASSERT_TRUE(it == reference.end());
+        std::multiset<uint32_t>::const_reverse_iterator rit = reference.rbegin();
+        ns_tree_foreach_reverse(const test_node_t, node, &tree) {
+            ASSERT_TRUE(rit != reference.rend());
+            ASSERT_EQ(*rit, node->key);
+            ++rit;
+        }
+        ASSERT_TRUE(rit == reference.rend());
+    }
+
+    test_tree_t tree;
+    test_node_t nodes[TEST_ENTRIES];
+    std::multiset<uint32_t> reference;
+};
+
+TEST_F(nstree_test, Empty)
+{
+    uint32_t key = 0;
+    EXPECT_TRUE(ns_tree_is_empty(&test_defined_tree));
+    EXPECT_TRUE(ns_tree_is_empty(&tree));
+    EXPECT_EQ(NULL, ns_tree_get_first(&tree));
+    EXPECT_EQ(NULL, ns_tree_get_last(&tree));
+    EXPECT_EQ(NULL, ns_tree_lower_bound(&tree, &key, test_node_compare));
+    EXPECT_EQ(NULL, ns_tree_find(&tree, &key, test_node_compare));
+
+    ns_tree_insert(&test_defined_tree, &nodes[0], test_node_compare);
+    EXPECT_EQ(&nodes[0], ns_tree_get_first(&test_defined_tree));
+    EXPECT_EQ(&nodes[0], ns_tree_get_last(&test_defined_tree));
+    EXPECT_EQ(NULL, ns_tree_get_next(&test_defined_tree, &nodes[0]));
+    EXPECT_EQ(NULL, ns_tree_get_previous(&test_defined_tree, &nodes[0]));
+    ns_tree_remove(&test_defined_tree, &nodes[0]);
+    EXPECT_TRUE(ns_tree_is_empty(&test_defined_tree));
+}
+
+TEST_F(nstree_test, InsertRemoveRandom)
+{
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        ns_tree_insert(&tree, &nodes[i], test_node_compare);
+        reference.insert(nodes[i].key);
+        if (i % 97 == 0) {
+            check_tree();
+        }
+    }
+    check_tree();
+
+    // remove in random order
+    std::vector<int> order;
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        order.push_back(i);
+    }
+    for (int i = TEST_ENTRIES - 1; i > 0; i--) {
+        std::swap(order[i], order[rand() % (i + 1)]);
+    }
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        test_node_t *node = &nodes[order[i]];
+        ns_tree_remove(&tree, node);
+        reference.erase(reference.find(node->key));
+        if (i % 97 == 0) {
+            check_tree();
+        }
+    }
+    check_tree();
+    EXPECT_TRUE(ns_tree_is_empty(&tree));
+}
+
+TEST_F(nstree_test, InsertSorted)
+{
+    // ascending and descending inserts must stay balanced
+    for (int i = 0; i < TEST_ENTRIES / 2; i++) {
+        nodes[i].key = i;
+        ns_tree_insert(&tree, &nodes[i], test_node_compare);
+        reference.insert(i);
+    }
+    for (int i = TEST_ENTRIES - 1; i >= TEST_ENTRIES / 2; i--) {
+        nodes[i].key = i;
+        ns_tree_insert(&tree, &nodes[i], test_node_compare);
+        reference.insert(i);
+    }
+    check_tree();
+    // black height of a red-black tree of n entries is at most log2(n + 1) + 1
+    EXPECT_LE(test_tree_check(tree.stree.root, NULL), 11);
+
+    ns_tree_foreach_safe(test_node_t, node, &tree) {
+        if (node->key % 2) {
+            ns_tree_remove(&tree, node);
+            reference.erase(node->key);
+        }
+    }
+    check_tree();
+}
+
+TEST_F(nstree_test, Search)
+{
+    for (int i = 0; i < TEST_ENTRIES; i++) {
+        ns_tree_insert(&tree, &nodes[i], test_node_compare);
+        reference.insert(nodes[i].key);
+    }
+
+    for (uint32_t key = 0; key <= TEST_ENTRIES / 2; key++) {
+        std::multiset<uint32_t>::const_iterator lower = reference.lower_bound(key);
+        std::multiset<uint32_t>::const_iterator upper = reference.upper_bound(key);
+        test_node_t *lower_node = ns_tree_lower_bound(&tree, &key, test_node_compare);
+        test_node_t *upper_node = ns_tree_upper_bound(&tree, &key, test_node_compare);
+        test_node_t *found = ns_tree_find(&tree, &key, test_node_compare);
+
+        if (lower == reference.end()) {
+            ASSERT_EQ(NULL, lower_node);
+        } else {
+            ASSERT_TRUE(lower_node != NULL);
+            ASSERT_EQ(*lower, lower_node->key);
+            // first of equal entries
+            test_node_t *previous = ns_tree_get_previous(&tree, lower_node);
+            ASSERT_TRUE(!previous || previous->key < key);
+        }
+        if (upper == reference.end()) {
+            ASSERT_EQ(NULL, upper_node);
+        } else {
+            ASSERT_TRUE(upper_node != NULL);
+            ASSERT_EQ(*upper, upper_node->key);
+        }
+        if (reference.count(key)) {
+            ASSERT_EQ(lower_node, found);
+        } else {
+            ASSERT_EQ(NULL, found);
+        }
+    }
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Benchmark of NVM helper throughput and latency on the file-backed platform NVM.
+ *
+ * Keeps a window of requests outstanding and measures the time from the helper
+ * call to the callback. Keys are written round-robin, so the requests in the
+ * window are to different keys and can be executed concurrently.
+ *
+ * Usage: nsnvmhelper_bench [directory], directory defaults to a new one in /tmp.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "nsdynmemLIB.h"
+#include "platform/arm_hal_nvm_file.h"
+
+extern "C" {
+#include "ns_nvm_helper.h"
+}
+
+#define BENCH_KEYS 8
+#define BENCH_VALUE_LEN 64
+#define BENCH_WINDOW 8
+#define BENCH_OPERATIONS 400
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct bench_request {
+    bench_clock::time_point start;
+    uint8_t buf[BENCH_VALUE_LEN];
+    uint16_t len;
+    bool busy;
+};
+
+static bench_request bench_requests[BENCH_WINDOW];
+static std::vector<double> bench_latencies_us;
+static int bench_outstanding;
+static int bench_errors;
+static char bench_key_names[BENCH_KEYS][16];
+static uint8_t bench_heap[64 * 1024];
+
+static void bench_callback(int status, void *context)
+{
+    bench_request *request = (bench_request *) context;
+    bench_latencies_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - request->start).count());
+    request->busy = false;
+    if (status != NS_NVM_OK) {
+        bench_errors++;
+    }
+    bench_outstanding--;
+}
+
+static void bench_run(const char *name, bool write, uint8_t depth, uint8_t key_index_size)
+{
+    ns_nvm_in_flight_depth_set(depth);
+    ns_nvm_key_index_set(key_index_size);
+    bench_latencies_us.clear();
+    bench_errors = 0;
+    bench_outstanding = 0;
+
+    auto start = bench_clock::now();
+    for (int i = 0; i < BENCH_OPERATIONS; i++) {
+        while (bench_outstanding == BENCH_WINDOW) {
+            platform_nvm_file_wait();
+            platform_nvm_file_dispatch();
+        }
+        bench_request *request = bench_requests;
+        while (request->busy) {
+            request++;
+        }
+        request->busy = true;
+        const char *key = bench_key_names[i % BENCH_KEYS];
+        request->len = BENCH_VALUE_LEN;
+        request->start = bench_clock::now();
+        bench_outstanding++;
+        int ret;
+        if (write) {
+            memset(request->buf, i, sizeof(request->buf));
+            ret = ns_nvm_data_write(bench_callback, key, request->buf, &request->len, request);
+        } else {
+            ret = ns_nvm_data_read(bench_callback, key, request->buf, &request->len, request);
+        }
+        if (ret != NS_NVM_OK) {
+            request->busy = false;
+            bench_outstanding--;
+            bench_errors++;
+        }
+    }
+    while (bench_outstanding > 0) {
+        platform_nvm_file_wait();
+        platform_nvm_file_dispatch();
+    }
+    double elapsed_s = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+    std::sort(bench_latencies_us.begin(), bench_latencies_us.end());
+    double sum = 0;
+    for (double latency : bench_latencies_us) {
+        sum += latency;
+    }
+    size_t count = bench_latencies_us.size();
+    double mean = count ? sum / count : 0;
+    double p99 = count ? bench_latencies_us[(count * 99) / 100] : 0;
+    printf("%-24s %6u %10.0f %12.1f %12.1f %8d\n", name, depth, BENCH_OPERATIONS / elapsed_s, mean, p99, bench_errors);
+}
+
+static void bench_remove_directory(const char *path)
+{
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unlinkat(dirfd(dir), entry->d_name, 0);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
+int main(int argc, char *argv[])
+{
+    char dir[PATH_MAX];
+    bool remove_dir = false;
+
+    if (argc > 1) {
+        snprintf(dir, sizeof(dir), "%s", argv[1]);
+    } else {
+        strcpy(dir, "/tmp/nsnvmhelper_bench_XXXXXX");
+        if (!mkdtemp(dir)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        remove_dir = true;
+    }
+
+    ns_dyn_mem_init(bench_heap, sizeof(bench_heap), NULL, NULL);
+    platform_nvm_file_configure(dir, NULL);
+    for (int i = 0; i < BENCH_KEYS; i++) {
+        snprintf(bench_key_names[i], sizeof(bench_key_names[i]), "bench_key_%d", i);
+    }
+
+    printf("%d operations, %d keys, %d byte values, %d requests outstanding, directory %s\n",
+           BENCH_OPERATIONS, BENCH_KEYS, BENCH_VALUE_LEN, BENCH_WINDOW, dir);
+    printf("%-24s %6s %10s %12s %12s %8s\n", "operation", "depth", "ops/s", "mean us", "p99 us", "errors");
+    bench_run("write, key create", true, 1, 0);
+    bench_run("write", true, 1, BENCH_KEYS);
+    bench_run("write", true, 4, BENCH_KEYS);
+    bench_run("read", false, 1, BENCH_KEYS);
+    bench_run("read", false, 4, BENCH_KEYS);
+
+    if (remove_dir) {
+        bench_remove_directory(dir);
+    }
+
+    return 0;
+}
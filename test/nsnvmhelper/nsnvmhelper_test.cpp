@@ -36,5 +36,14 @@ TEST_F(nsnvmhelper_test, test_ns_nvm_helper)
     ASSERT_EQ(true, test_ns_nvm_helper_concurrent_requests());
     ASSERT_EQ(true, test_ns_nvm_helper_platform_error());
     ASSERT_EQ(true, test_ns_nvm_helper_platform_error_in_write());
+    ASSERT_EQ(true, test_ns_nvm_helper_write_back());
+    ASSERT_EQ(true, test_ns_nvm_helper_read_cache());
+    ASSERT_EQ(true, test_ns_nvm_helper_batch());
+    ASSERT_EQ(true, test_ns_nvm_helper_in_flight_depth());
+    ASSERT_EQ(true, test_ns_nvm_helper_key_index());
+    ASSERT_EQ(true, test_ns_nvm_helper_request_pool());
+    ASSERT_EQ(true, test_ns_nvm_helper_priority());
+    ASSERT_EQ(true, test_ns_nvm_helper_coalesce());
+    ASSERT_EQ(true, test_ns_nvm_helper_callback_request());
 }
 
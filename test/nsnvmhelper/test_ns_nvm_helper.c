@@ -17,6 +17,7 @@
 
 #include <inttypes.h>
 #include <stddef.h>
+#include <string.h>
 #include "test_ns_nvm_helper.h"
 #include "ns_nvm_helper.h"
 #include "nsdynmemLIB_stub.h"
@@ -35,17 +36,33 @@ static int read_callback_status = 0;
 static void *read_callback_context = NULL;
 static int write_callback_status = 0;
 static void *write_callback_context = NULL;
+static int write_callback_count = 0;
 static int delete_callback_status = 0;
 static void *delete_callback_context = NULL;
+static int sync_callback_status = 0;
+static void *sync_callback_context = NULL;
 
 extern void test_platform_nvm_api_callback();
 
+extern void test_platform_nvm_api_callback_with_status(platform_nvm_status status);
+
 extern void test_platform_nvm_api_set_retval(platform_nvm_status return_value);
 
+extern void test_platform_nvm_api_fail_writes(int count);
+
+extern void test_platform_nvm_api_outstanding_clear(void);
+
+extern int test_platform_nvm_api_outstanding_count(void);
+
+extern const char *test_platform_nvm_api_outstanding_key(int index);
+
+extern void test_platform_nvm_api_outstanding_callback(int index);
+
 void test_ns_nvm_helper_write_callback(int status, void *context)
 {
     write_callback_status = status;
     write_callback_context = context;
+    write_callback_count++;
 }
 
 void test_ns_nvm_helper_read_callback(int status, void *context)
@@ -54,16 +71,40 @@ void test_ns_nvm_helper_read_callback(int status, void *context)
     read_callback_context = context;
 }
 
+static int chain_read_count = 0;
+
+void test_ns_nvm_helper_chain_read_callback(int status, void *context)
+{
+    static uint16_t chain_read_len;
+
+    read_callback_status = status;
+    read_callback_context = context;
+    // next read is requested from the completion callback
+    if (++chain_read_count < 3) {
+        chain_read_len = BUF_LEN;
+        ns_nvm_data_read(test_ns_nvm_helper_chain_read_callback, "ns_nvm_test_key3", buf, &chain_read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    }
+}
+
 void test_ns_nvm_helper_delete_callback(int status, void *context)
 {
     delete_callback_status = status;
     delete_callback_context = context;
 }
 
+void test_ns_nvm_helper_sync_callback(int status, void *context)
+{
+    sync_callback_status = status;
+    sync_callback_context = context;
+}
+
 bool test_ns_nvm_helper_write()
 {
     int ret_val;
 
+    // keys are created on every write, key index is tested separately
+    ns_nvm_key_index_set(0);
+
     write_callback_status = -1;
     write_callback_context = 0;
 
@@ -284,9 +325,9 @@ bool test_ns_nvm_helper_concurrent_requests()
         return false;
     }
 
-    // delete ok
+    // delete ok, different key so that the delete does not replace the queued write
     nsdynmemlib_stub.returnCounter = 1;
-    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, "ns_nvm_test_key2", (void *)TEST_NS_NVM_HELPER_CONTEXT3);
     if (ret_val != NS_NVM_OK) {
         return false;
     }
@@ -440,3 +481,929 @@ bool test_ns_nvm_helper_platform_error_in_write()
 
     return true;
 }
+
+bool test_ns_nvm_helper_write_back()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    uint8_t data[4] = {1, 2, 3, 4};
+    uint16_t data_len = sizeof(data);
+    uint8_t read_buf[8];
+    uint16_t read_len = sizeof(read_buf);
+
+    ns_nvm_write_back_set(10, 1);
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+
+    // write is cached and completed immediately
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT1) {
+        return false;
+    }
+
+    // rewrite with same length is coalesced without allocations
+    data[0] = 5;
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 0;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK || write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // read is served from cache
+    read_callback_status = -1;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK || read_callback_status != NS_NVM_OK || read_len != sizeof(data) || memcmp(read_buf, data, sizeof(data)) != 0) {
+        return false;
+    }
+
+    // delay not expired, nothing written
+    nsdynmemlib_stub.returnCounter = 1;
+    ns_nvm_write_back_timer(5);
+    if (nsdynmemlib_stub.returnCounter != 1) {
+        return false;
+    }
+
+    // delay expired, write to NVM is started
+    ns_nvm_write_back_timer(5);
+    if (nsdynmemlib_stub.returnCounter != 0) {
+        return false;
+    }
+
+    // new data while writing is cached and read from cache
+    data[0] = 6;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    read_len = sizeof(read_buf);
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK || read_buf[0] != 6) {
+        return false;
+    }
+
+    // make create, write and flush callbacks
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+
+    // sync writes the latest data
+    sync_callback_status = -1;
+    sync_callback_context = NULL;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_sync(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK || sync_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (sync_callback_status != NS_NVM_OK || sync_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // failed write is retried by next sync
+    nsdynmemlib_stub.returnCounter = 4;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    sync_callback_status = -1;
+    ret_val = ns_nvm_sync(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_ERROR);
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    if (sync_callback_status != NS_NVM_ERROR) {
+        return false;
+    }
+    sync_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_sync(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (sync_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // delete drops cached data
+    nsdynmemlib_stub.returnCounter = 3;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    delete_callback_status = -1;
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (delete_callback_status != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 0) {
+        return false;
+    }
+
+    // cache full, second key is written directly
+    nsdynmemlib_stub.returnCounter = 3;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    write_callback_status = -1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key2, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK || write_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // cache disabled, write supersedes cached data and is written directly
+    ns_nvm_write_back_set(0, 0);
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || write_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // nothing cached, sync completes immediately
+    sync_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_sync(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK || sync_callback_status != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 0) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_read_cache()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    const char *key3 = "ns_nvm_test_key3";
+    uint8_t read_buf[16];
+    uint16_t read_len;
+    ns_nvm_read_cache_statistics_t stats;
+
+    ns_nvm_read_cache_set(2);
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+
+    // miss, data is read from NVM and stored to cache
+    memset(read_buf, 0xaa, sizeof(read_buf));
+    read_len = 8;
+    read_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || read_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    if (read_callback_status != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 0) {
+        return false;
+    }
+
+    // hit, completed without platform NVM
+    memset(read_buf, 0, sizeof(read_buf));
+    read_len = 4;
+    read_callback_status = -1;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK || read_callback_status != NS_NVM_OK || read_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+    if (read_len != 4 || read_buf[0] != 0xaa || read_buf[3] != 0xaa || read_buf[4] != 0) {
+        return false;
+    }
+
+    // cached data might be limited by earlier buffer length, larger read is a miss
+    read_len = 16;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+
+    ns_nvm_read_cache_statistics_get(&stats);
+    if (stats.hits != 1 || stats.misses != 2) {
+        return false;
+    }
+
+    // write removes the key from cache
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    read_len = 8;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+
+    // least recently used key is removed when cache is full
+    nsdynmemlib_stub.returnCounter = 2;
+    ns_nvm_data_read(test_ns_nvm_helper_read_callback, key2, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    test_platform_nvm_api_callback();
+    nsdynmemlib_stub.returnCounter = 2;
+    ns_nvm_data_read(test_ns_nvm_helper_read_callback, key3, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    test_platform_nvm_api_callback();
+    nsdynmemlib_stub.returnCounter = 0;
+    read_callback_status = -1;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key2, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK || read_callback_status != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_MEMORY) {
+        return false;
+    }
+
+    // data read before a delete of the key is not cached
+    nsdynmemlib_stub.returnCounter = 3;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, read_buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (nsdynmemlib_stub.returnCounter != 1) {
+        return false;
+    }
+
+    ns_nvm_read_cache_statistics_get(&stats);
+    if (stats.hits != 2 || stats.misses != 7) {
+        return false;
+    }
+
+    ns_nvm_read_cache_set(0);
+
+    return true;
+}
+
+bool test_ns_nvm_helper_batch()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    const char *key3 = "ns_nvm_test_key3";
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+
+    // commit without batch
+    if (ns_nvm_batch_commit(test_ns_nvm_helper_sync_callback, NULL) != NS_NVM_ERROR) {
+        return false;
+    }
+
+    if (ns_nvm_batch_begin() != NS_NVM_OK || ns_nvm_batch_begin() != NS_NVM_ERROR) {
+        return false;
+    }
+
+    write_callback_status = -1;
+    delete_callback_status = -1;
+    sync_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 4;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // member callback is optional
+    ret_val = ns_nvm_data_write(NULL, key2, buf, &buf_len, NULL);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key3, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_batch_commit(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+
+    // make create and write callbacks for both writes and delete callback, no flushes in between
+    for (int i = 0; i < 5; i++) {
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != -1 || delete_callback_status != -1 || sync_callback_status != -1) {
+        return false;
+    }
+
+    // make commit flush callback
+    test_platform_nvm_api_callback();
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT1) {
+        return false;
+    }
+    if (delete_callback_status != NS_NVM_OK || delete_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT3) {
+        return false;
+    }
+    if (sync_callback_status != NS_NVM_OK || sync_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // failed member is reported in member and commit callbacks
+    write_callback_status = -1;
+    sync_callback_status = -1;
+    ns_nvm_batch_begin();
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_batch_commit(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create callback with error, note also commit flush fails as it is triggered with same error
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_ERROR);
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    if (write_callback_status != NS_NVM_ERROR || sync_callback_status != NS_NVM_ERROR) {
+        return false;
+    }
+
+    // flush failure is reported for all members
+    write_callback_status = -1;
+    sync_callback_status = -1;
+    ns_nvm_batch_begin();
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_batch_commit(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make delete callback
+    test_platform_nvm_api_callback();
+    // make flush callback with error
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_ERROR);
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    if (delete_callback_status != NS_NVM_ERROR || sync_callback_status != NS_NVM_ERROR) {
+        return false;
+    }
+
+    // empty batch is committed immediately
+    sync_callback_status = -1;
+    ns_nvm_batch_begin();
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_batch_commit(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK || sync_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_in_flight_depth()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    test_platform_nvm_api_outstanding_clear();
+    ns_nvm_in_flight_depth_set(3);
+
+    write_callback_status = -1;
+    read_callback_status = -1;
+    delete_callback_status = -1;
+    sync_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 3;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // different key is started while write is in progress
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key2, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // same key waits for the write
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    if (test_platform_nvm_api_outstanding_count() != 2 || test_platform_nvm_api_outstanding_key(0) != key1 || test_platform_nvm_api_outstanding_key(1) != key2) {
+        return false;
+    }
+
+    // read completes before write
+    test_platform_nvm_api_outstanding_callback(1);
+    if (read_callback_status != NS_NVM_OK || read_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        if (test_platform_nvm_api_outstanding_count() != 1 || delete_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT1) {
+        return false;
+    }
+
+    // delete was started after write
+    if (test_platform_nvm_api_outstanding_count() != 1 || test_platform_nvm_api_outstanding_key(0) != key1) {
+        return false;
+    }
+
+    // sync waits for the delete and following read waits for the sync
+    read_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_sync(test_ns_nvm_helper_sync_callback, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key2, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    if (test_platform_nvm_api_outstanding_count() != 1 || sync_callback_status != -1) {
+        return false;
+    }
+
+    // make delete and flush callbacks, sync completes and read is started
+    test_platform_nvm_api_outstanding_callback(0);
+    if (test_platform_nvm_api_outstanding_count() != 1 || delete_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_outstanding_callback(0);
+    if (delete_callback_status != NS_NVM_OK || delete_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT3) {
+        return false;
+    }
+    if (sync_callback_status != NS_NVM_OK || read_callback_status != -1) {
+        return false;
+    }
+    if (test_platform_nvm_api_outstanding_count() != 1 || test_platform_nvm_api_outstanding_key(0) != key2) {
+        return false;
+    }
+    test_platform_nvm_api_outstanding_callback(0);
+    if (read_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    ns_nvm_in_flight_depth_set(1);
+
+    return true;
+}
+
+bool test_ns_nvm_helper_key_index()
+{
+    int ret_val;
+    uint8_t data[4] = {1, 2, 3, 4};
+    uint16_t data_len = sizeof(data);
+
+    ns_nvm_key_index_set(2);
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+
+    // first write creates the key
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 0) {
+        return false;
+    }
+
+    // write with same length is made without create
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make write and flush callbacks
+    test_platform_nvm_api_callback();
+    if (write_callback_status != -1) {
+        return false;
+    }
+    test_platform_nvm_api_callback();
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // write with different length creates the key again
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // key removed outside of helper, write fails and key is created
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    test_platform_nvm_api_callback_with_status(PLATFORM_NVM_KEY_NOT_FOUND);
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // deleted key is created on next write
+    delete_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make delete and flush callbacks
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (delete_callback_status != NS_NVM_OK) {
+        return false;
+    }
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // delete queued while the key is created, next write creates the key again
+    write_callback_status = -1;
+    delete_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    ret_val |= ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create, write and flush callbacks, then delete and flush callbacks
+    for (int i = 0; i < 5; i++) {
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || delete_callback_status != NS_NVM_OK) {
+        return false;
+    }
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // write to indexed key fails synchronously, key is created
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 1;
+    test_platform_nvm_api_fail_writes(1);
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT1) {
+        return false;
+    }
+
+    // disabling index forgets created keys
+    ns_nvm_key_index_set(0);
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 2;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, data, &data_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        if (write_callback_status != -1) {
+            return false;
+        }
+        test_platform_nvm_api_callback();
+    }
+    if (write_callback_status != NS_NVM_OK || nsdynmemlib_stub.returnCounter != 1) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_request_pool()
+{
+    int ret_val;
+    uint16_t read_len = BUF_LEN;
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+
+    // pool allocation fails
+    nsdynmemlib_stub.returnCounter = 0;
+    if (ns_nvm_request_pool_init(2) != NS_NVM_MEMORY) {
+        return false;
+    }
+    nsdynmemlib_stub.returnCounter = 1;
+    if (ns_nvm_request_pool_init(2) != NS_NVM_OK || ns_nvm_request_pool_init(2) != NS_NVM_ERROR) {
+        return false;
+    }
+
+    // write is made without allocations
+    write_callback_status = -1;
+    nsdynmemlib_stub.returnCounter = 0;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // make create, write and flush callbacks
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // pool exhausted, heap is used
+    read_callback_status = -1;
+    delete_callback_status = -1;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_MEMORY) {
+        return false;
+    }
+
+    // pool can't be released while requests are in use
+    if (ns_nvm_request_pool_init(0) != NS_NVM_ERROR) {
+        return false;
+    }
+
+    // make read, delete and flush callbacks
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    test_platform_nvm_api_callback();
+    if (read_callback_status != NS_NVM_OK || delete_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    if (ns_nvm_request_pool_init(0) != NS_NVM_OK) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_priority()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    const char *key3 = "ns_nvm_test_key3";
+    uint16_t read_len = BUF_LEN;
+    int high_reads_before_write = 0;
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    test_platform_nvm_api_outstanding_clear();
+
+    nsdynmemlib_stub.returnCounter = 12;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    // low priority write is queued before high priority reads
+    write_callback_status = -1;
+    ret_val = ns_nvm_data_write_prio(test_ns_nvm_helper_write_callback, key2, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2, NS_NVM_PRIORITY_LOW);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    for (int i = 0; i < 10; i++) {
+        ret_val = ns_nvm_data_read_prio(test_ns_nvm_helper_read_callback, key3, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT3, NS_NVM_PRIORITY_HIGH);
+        if (ret_val != NS_NVM_OK) {
+            return false;
+        }
+    }
+
+    // complete first read, high priority reads are started before the write
+    test_platform_nvm_api_outstanding_callback(0);
+    while (test_platform_nvm_api_outstanding_count() == 1 && test_platform_nvm_api_outstanding_key(0) == key3) {
+        high_reads_before_write++;
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (test_platform_nvm_api_outstanding_count() != 1 || test_platform_nvm_api_outstanding_key(0) != key2) {
+        return false;
+    }
+
+    // write is not starved by the high priority reads
+    if (high_reads_before_write == 0 || high_reads_before_write >= 10) {
+        return false;
+    }
+
+    // make create, write and flush callbacks, then the remaining reads
+    for (int i = 0; i < 3 + 10 - high_reads_before_write; i++) {
+        if (test_platform_nvm_api_outstanding_count() != 1) {
+            return false;
+        }
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (test_platform_nvm_api_outstanding_count() != 0 || write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_coalesce()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    uint16_t read_len = BUF_LEN;
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    test_platform_nvm_api_outstanding_clear();
+
+    nsdynmemlib_stub.returnCounter = 10;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_read_callback, key2, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+
+    // writes and delete are queued, delete replaces the writes
+    write_callback_count = 0;
+    delete_callback_status = -1;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    ret_val |= ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    ret_val |= ns_nvm_key_delete(test_ns_nvm_helper_delete_callback, key1, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    // read of the key prevents replacing the delete
+    ret_val |= ns_nvm_data_read(test_ns_nvm_helper_read_callback, key1, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    ret_val |= ns_nvm_data_write(test_ns_nvm_helper_write_callback, key1, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT3);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+
+    // complete first read, delete is started
+    test_platform_nvm_api_outstanding_callback(0);
+    if (test_platform_nvm_api_outstanding_count() != 1 || test_platform_nvm_api_outstanding_key(0) != key1) {
+        return false;
+    }
+
+    // make delete and flush callbacks, replaced writes are completed before the delete
+    test_platform_nvm_api_outstanding_callback(0);
+    test_platform_nvm_api_outstanding_callback(0);
+    if (delete_callback_status != NS_NVM_OK || delete_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT3) {
+        return false;
+    }
+    if (write_callback_count != 2 || write_callback_status != NS_NVM_OK || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // make read callback
+    test_platform_nvm_api_outstanding_callback(0);
+    if (read_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT2) {
+        return false;
+    }
+
+    // make create, write and flush callbacks of the last write
+    for (int i = 0; i < 3; i++) {
+        if (test_platform_nvm_api_outstanding_count() != 1) {
+            return false;
+        }
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (test_platform_nvm_api_outstanding_count() != 0) {
+        return false;
+    }
+    if (write_callback_count != 3 || write_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT3) {
+        return false;
+    }
+
+    return true;
+}
+
+bool test_ns_nvm_helper_callback_request()
+{
+    int ret_val;
+    const char *key2 = "ns_nvm_test_key2";
+    uint16_t read_len = BUF_LEN;
+
+    test_platform_nvm_api_set_retval(PLATFORM_NVM_OK);
+    test_platform_nvm_api_outstanding_clear();
+
+    nsdynmemlib_stub.returnCounter = 10;
+    chain_read_count = 0;
+    ret_val = ns_nvm_data_read(test_ns_nvm_helper_chain_read_callback, key1, buf, &read_len, (void *)TEST_NS_NVM_HELPER_CONTEXT1);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+    write_callback_count = 0;
+    ret_val = ns_nvm_data_write(test_ns_nvm_helper_write_callback, key2, buf, &buf_len, (void *)TEST_NS_NVM_HELPER_CONTEXT2);
+    if (ret_val != NS_NVM_OK) {
+        return false;
+    }
+
+    // complete first read, queued write is started before the read requested from the callback
+    test_platform_nvm_api_outstanding_callback(0);
+    if (chain_read_count != 1) {
+        return false;
+    }
+    if (test_platform_nvm_api_outstanding_count() != 1 || test_platform_nvm_api_outstanding_key(0) != key2) {
+        return false;
+    }
+
+    // make create, write and flush callbacks
+    for (int i = 0; i < 3; i++) {
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (write_callback_count != 1 || write_callback_status != NS_NVM_OK) {
+        return false;
+    }
+
+    // make callbacks of the chained reads
+    while (test_platform_nvm_api_outstanding_count() == 1) {
+        if (strcmp(test_platform_nvm_api_outstanding_key(0), "ns_nvm_test_key3") != 0) {
+            return false;
+        }
+        test_platform_nvm_api_outstanding_callback(0);
+    }
+    if (test_platform_nvm_api_outstanding_count() != 0 || chain_read_count != 3) {
+        return false;
+    }
+    if (read_callback_context != (void *)TEST_NS_NVM_HELPER_CONTEXT3) {
+        return false;
+    }
+
+    return true;
+}
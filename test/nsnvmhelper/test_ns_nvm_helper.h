@@ -29,6 +29,15 @@ bool test_ns_nvm_helper_delete();
 bool test_ns_nvm_helper_concurrent_requests();
 bool test_ns_nvm_helper_platform_error();
 bool test_ns_nvm_helper_platform_error_in_write();
+bool test_ns_nvm_helper_write_back();
+bool test_ns_nvm_helper_read_cache();
+bool test_ns_nvm_helper_batch();
+bool test_ns_nvm_helper_in_flight_depth();
+bool test_ns_nvm_helper_key_index();
+bool test_ns_nvm_helper_request_pool();
+bool test_ns_nvm_helper_priority();
+bool test_ns_nvm_helper_coalesce();
+bool test_ns_nvm_helper_callback_request();
 
 #ifdef __cplusplus
 }
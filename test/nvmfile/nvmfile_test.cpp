@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2021, Pelion and affiliates.
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "gtest/gtest.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "platform/arm_hal_nvm.h"
+#include "platform/arm_hal_nvm_file.h"
+
+#define CALLBACK_NOT_CALLED ((platform_nvm_status) -1)
+
+static platform_nvm_status callback_status;
+static void *callback_context;
+static int callback_count;
+static int notify_count;
+
+static void test_callback(platform_nvm_status status, void *context)
+{
+    callback_status = status;
+    callback_context = context;
+    callback_count++;
+}
+
+static void test_notify(void)
+{
+    __atomic_add_fetch(&notify_count, 1, __ATOMIC_RELAXED);
+}
+
+// Waits until the requested operation has been completed and returns its status
+static platform_nvm_status complete(platform_nvm_status ret)
+{
+    if (ret != PLATFORM_NVM_OK) {
+        return ret;
+    }
+    int count = callback_count;
+    while (callback_count == count) {
+        platform_nvm_file_wait();
+        platform_nvm_file_dispatch();
+    }
+    return callback_status;
+}
+
+class nvmfile_test : public testing::Test {
+protected:
+    char dir[64];
+
+    void SetUp()
+    {
+        strcpy(dir, "/tmp/nvmfile_test_XXXXXX");
+        ASSERT_TRUE(mkdtemp(dir) != NULL);
+        callback_status = CALLBACK_NOT_CALLED;
+        callback_context = NULL;
+        ASSERT_EQ(PLATFORM_NVM_OK, platform_nvm_file_configure(dir, test_notify));
+        ASSERT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_init(test_callback, NULL)));
+        callback_status = CALLBACK_NOT_CALLED;
+    }
+
+    void TearDown()
+    {
+        complete(platform_nvm_finalize(test_callback, NULL));
+        DIR *d = opendir(dir);
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            unlinkat(dirfd(d), entry->d_name, 0);
+        }
+        closedir(d);
+        rmdir(dir);
+    }
+
+    int file_count()
+    {
+        int count = 0;
+        DIR *d = opendir(dir);
+        struct dirent *entry;
+        while ((entry = readdir(d)) != NULL) {
+            if (entry->d_name[0] != '.') {
+                count++;
+            }
+        }
+        closedir(d);
+        return count;
+    }
+};
+
+TEST_F(nvmfile_test, test_init)
+{
+    // already initialized
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_init(test_callback, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_file_configure(dir, NULL));
+    // notification is made by the worker after completion is available for dispatch
+    for (int i = 0; i < 1000 && __atomic_load_n(&notify_count, __ATOMIC_RELAXED) == 0; i++) {
+        usleep(1000);
+    }
+    EXPECT_GT(__atomic_load_n(&notify_count, __ATOMIC_RELAXED), 0);
+}
+
+TEST_F(nvmfile_test, test_key_not_found)
+{
+    uint8_t buf[8];
+    uint16_t len = sizeof(buf);
+
+    EXPECT_EQ(PLATFORM_NVM_KEY_NOT_FOUND, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_KEY_NOT_FOUND, complete(platform_nvm_write(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_KEY_NOT_FOUND, complete(platform_nvm_key_delete(test_callback, "key", NULL)));
+}
+
+TEST_F(nvmfile_test, test_invalid_parameters)
+{
+    uint8_t buf[8];
+    uint16_t len = sizeof(buf);
+    char long_key[512];
+
+    memset(long_key, 'a', sizeof(long_key) - 1);
+    long_key[sizeof(long_key) - 1] = '\0';
+
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_key_create(NULL, "key", 8, 0, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_key_create(test_callback, NULL, 8, 0, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_key_create(test_callback, "", 8, 0, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_key_create(test_callback, long_key, 8, 0, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_read(test_callback, "key", NULL, &len, NULL));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_write(test_callback, "key", buf, NULL, NULL));
+    EXPECT_EQ(CALLBACK_NOT_CALLED, callback_status);
+}
+
+TEST_F(nvmfile_test, test_create_write_read)
+{
+    uint8_t data[12] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    uint8_t buf[16];
+    uint16_t len;
+
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_key_create(test_callback, "key", 8, 0, (void *) 1)));
+    EXPECT_EQ((void *) 1, callback_context);
+
+    // created key is empty
+    len = sizeof(buf);
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(0, len);
+
+    len = 4;
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_write(test_callback, "key", data, &len, NULL)));
+    EXPECT_EQ(4, len);
+    len = sizeof(buf);
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(4, len);
+    EXPECT_EQ(0, memcmp(buf, data, 4));
+
+    // write is truncated to the created length
+    len = sizeof(data);
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_write(test_callback, "key", data, &len, NULL)));
+    EXPECT_EQ(8, len);
+
+    // read is limited to the buffer length
+    len = 6;
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(6, len);
+    EXPECT_EQ(0, memcmp(buf, data, 6));
+
+    // re-create discards data
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_key_create(test_callback, "key", 16, 0, NULL)));
+    len = sizeof(buf);
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(0, len);
+
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_flush(test_callback, NULL)));
+
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_key_delete(test_callback, "key", NULL)));
+    len = sizeof(buf);
+    EXPECT_EQ(PLATFORM_NVM_KEY_NOT_FOUND, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(0, file_count());
+}
+
+TEST_F(nvmfile_test, test_key_names)
+{
+    const char *keys[] = {"com.arm.key", "a/b", "a%2Fb", ".hidden", "key with spaces"};
+    const int key_count = sizeof(keys) / sizeof(keys[0]);
+    uint8_t buf[4];
+    uint16_t len;
+
+    for (int i = 0; i < key_count; i++) {
+        uint8_t value = i;
+        len = 1;
+        EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_key_create(test_callback, keys[i], 1, 0, NULL)));
+        EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_write(test_callback, keys[i], &value, &len, NULL)));
+    }
+    EXPECT_EQ(key_count, file_count());
+    for (int i = 0; i < key_count; i++) {
+        len = sizeof(buf);
+        EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, keys[i], buf, &len, NULL)));
+        EXPECT_EQ(1, len);
+        EXPECT_EQ(i, buf[0]);
+    }
+}
+
+TEST_F(nvmfile_test, test_pipelined_operations)
+{
+    static platform_nvm_status statuses[4];
+    static int order[4];
+    static int completed;
+    uint8_t data[4] = {1, 2, 3, 4};
+    uint8_t buf[4];
+    uint16_t write_len = sizeof(data);
+    uint16_t read_len = sizeof(buf);
+
+    struct local {
+        static void callback(platform_nvm_status status, void *context)
+        {
+            intptr_t index = (intptr_t) context;
+            statuses[index] = status;
+            order[completed++] = index;
+        }
+    };
+
+    completed = 0;
+    ASSERT_EQ(PLATFORM_NVM_OK, platform_nvm_key_create(local::callback, "key", sizeof(data), 0, (void *) 0));
+    ASSERT_EQ(PLATFORM_NVM_OK, platform_nvm_write(local::callback, "key", data, &write_len, (void *) 1));
+    ASSERT_EQ(PLATFORM_NVM_OK, platform_nvm_flush(local::callback, (void *) 2));
+    ASSERT_EQ(PLATFORM_NVM_OK, platform_nvm_read(local::callback, "key", buf, &read_len, (void *) 3));
+    while (completed < 4) {
+        platform_nvm_file_wait();
+        platform_nvm_file_dispatch();
+    }
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(i, order[i]);
+        EXPECT_EQ(PLATFORM_NVM_OK, statuses[i]);
+    }
+    EXPECT_EQ(0, memcmp(buf, data, sizeof(data)));
+}
+
+TEST_F(nvmfile_test, test_persistence)
+{
+    uint8_t data[4] = {1, 2, 3, 4};
+    uint8_t buf[4];
+    uint16_t len = sizeof(data);
+
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_key_create(test_callback, "key", sizeof(data), 0, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_write(test_callback, "key", data, &len, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_flush(test_callback, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_finalize(test_callback, NULL)));
+
+    // operations are rejected after finalize
+    EXPECT_EQ(PLATFORM_NVM_ERROR, platform_nvm_read(test_callback, "key", buf, &len, NULL));
+
+    // interrupted write is cleaned up on init
+    char path[128];
+    snprintf(path, sizeof(path), "%s/key.tmp", dir);
+    int fd = open(path, O_WRONLY | O_CREAT, 0600);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    EXPECT_EQ(2, file_count());
+
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_init(test_callback, NULL)));
+    EXPECT_EQ(1, file_count());
+    len = sizeof(buf);
+    EXPECT_EQ(PLATFORM_NVM_OK, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(sizeof(data), len);
+    EXPECT_EQ(0, memcmp(buf, data, sizeof(data)));
+}
+
+TEST_F(nvmfile_test, test_corrupted_file)
+{
+    uint8_t buf[4];
+    uint16_t len = sizeof(buf);
+    char path[128];
+
+    snprintf(path, sizeof(path), "%s/key.key", dir);
+    int fd = open(path, O_WRONLY | O_CREAT, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(3, write(fd, "bad", 3));
+    close(fd);
+
+    EXPECT_EQ(PLATFORM_NVM_ERROR, complete(platform_nvm_read(test_callback, "key", buf, &len, NULL)));
+    EXPECT_EQ(PLATFORM_NVM_ERROR, complete(platform_nvm_write(test_callback, "key", buf, &len, NULL)));
+}
@@ -15,32 +15,94 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include "ns_types.h"
 #include "platform/arm_hal_nvm.h"
 
+#define TEST_PLATFORM_NVM_OUTSTANDING_MAX 8
+
+typedef struct {
+    nvm_callback *callback;
+    void *context;
+    const char *key_name;
+} test_platform_nvm_api_operation;
+
 typedef struct {
     platform_nvm_status status;
     nvm_callback *saved_callback;
     void *saved_context;
+    test_platform_nvm_api_operation outstanding[TEST_PLATFORM_NVM_OUTSTANDING_MAX];
+    int outstanding_count;
+    int write_fail_count;
 } test_platform_nvm_api_data;
 
 test_platform_nvm_api_data test_data = {0, NULL, NULL};
 
+static void test_platform_nvm_api_save(nvm_callback *callback, const char *key_name, void *context)
+{
+    test_data.saved_callback = callback;
+    test_data.saved_context = context;
+    if (test_data.outstanding_count == TEST_PLATFORM_NVM_OUTSTANDING_MAX) {
+        // drop oldest operation
+        memmove(&test_data.outstanding[0], &test_data.outstanding[1], (TEST_PLATFORM_NVM_OUTSTANDING_MAX - 1) * sizeof(test_platform_nvm_api_operation));
+        test_data.outstanding_count--;
+    }
+    test_data.outstanding[test_data.outstanding_count].callback = callback;
+    test_data.outstanding[test_data.outstanding_count].context = context;
+    test_data.outstanding[test_data.outstanding_count].key_name = key_name;
+    test_data.outstanding_count++;
+}
+
 
 void test_platform_nvm_api_set_retval(platform_nvm_status return_value)
 {
     test_data.status = return_value;
 }
 
+/* Fail next writes synchronously with PLATFORM_NVM_ERROR */
+void test_platform_nvm_api_fail_writes(int count)
+{
+    test_data.write_fail_count = count;
+}
+
 void test_platform_nvm_api_callback()
 {
     test_data.saved_callback(test_data.status, test_data.saved_context);
 }
 
+void test_platform_nvm_api_callback_with_status(platform_nvm_status status)
+{
+    test_data.saved_callback(status, test_data.saved_context);
+}
+
+void test_platform_nvm_api_outstanding_clear(void)
+{
+    test_data.outstanding_count = 0;
+}
+
+int test_platform_nvm_api_outstanding_count(void)
+{
+    return test_data.outstanding_count;
+}
+
+const char *test_platform_nvm_api_outstanding_key(int index)
+{
+    return test_data.outstanding[index].key_name;
+}
+
+/* Complete outstanding operation, operations are indexed in the order they were started */
+void test_platform_nvm_api_outstanding_callback(int index)
+{
+    test_platform_nvm_api_operation operation = test_data.outstanding[index];
+
+    test_data.outstanding_count--;
+    memmove(&test_data.outstanding[index], &test_data.outstanding[index + 1], (test_data.outstanding_count - index) * sizeof(test_platform_nvm_api_operation));
+    operation.callback(test_data.status, operation.context);
+}
+
 platform_nvm_status platform_nvm_init(nvm_callback *callback, void *context)
 {
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    test_platform_nvm_api_save(callback, NULL, context);
     return test_data.status;
 }
 
@@ -53,50 +115,41 @@ platform_nvm_status platform_nvm_finalize(nvm_callback *callback, void *context)
 
 platform_nvm_status platform_nvm_key_create(nvm_callback *callback, const char *key_name, uint16_t value_len, uint32_t flags, void *context)
 {
-    (void) key_name;
     (void) value_len;
     (void) flags;
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    test_platform_nvm_api_save(callback, key_name, context);
     return test_data.status;
 }
 
 platform_nvm_status platform_nvm_key_delete(nvm_callback *callback, const char *key_name, void *context)
 {
-    (void) callback;
-    (void) key_name;
-    (void) context;
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    test_platform_nvm_api_save(callback, key_name, context);
     return test_data.status;
 }
 
 platform_nvm_status platform_nvm_write(nvm_callback *callback, const char *key_name, const void *data, uint16_t *data_len, void *context)
 {
-    (void) key_name;
     (void) data;
     (void) data_len;
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    if (test_data.write_fail_count > 0) {
+        test_data.write_fail_count--;
+        return PLATFORM_NVM_ERROR;
+    }
+    test_platform_nvm_api_save(callback, key_name, context);
     return test_data.status;
 }
 
 platform_nvm_status platform_nvm_read(nvm_callback *callback, const char *key_name, void *buf, uint16_t *buf_len, void *context)
 {
-    (void) key_name;
     (void) buf;
     (void) buf_len;
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    test_platform_nvm_api_save(callback, key_name, context);
     return test_data.status;
 }
 
 platform_nvm_status platform_nvm_flush(nvm_callback *callback, void *context)
 {
-    (void) callback;
-    (void) context;
-    test_data.saved_callback = callback;
-    test_data.saved_context = context;
+    test_platform_nvm_api_save(callback, NULL, context);
     return test_data.status;
 }
 